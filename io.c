@@ -1,3 +1,10 @@
+#include "ycfat_config.h"
+#ifdef __linux__
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 unsigned int systick = 0;
 void YC_FAT_GetTime()
 {
@@ -12,4 +19,46 @@ unsigned int systime_now(void)
 unsigned int sysdata_now(void)
 {
     return 0;
-}
\ No newline at end of file
+}
+
+/* 锁等待时让出CPU，YC_LOCK_BLOCK模式下由用户对接操作系统（如osDelay(1)、sched_yield()） */
+void YC_OS_Yield(void)
+{
+
+}
+
+/* 单调时钟（纳秒），用于跟踪时间戳、延迟直方图及超时检测（YC_TIMEOUT_SWITCH），由用户对接硬件定时器（如DWT周期计数器、SysTick） */
+/* 非Linux平台未对接时返回0：跟踪时间戳全为0，目录遍历超时永远不会触发 */
+unsigned long long YC_OS_ClockNs(void)
+{
+#ifdef __linux__
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (unsigned long long)ts.tv_sec*1000000000ull + ts.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+#if YC_TRACE_ON && defined(__linux__)
+extern int YC_FAT_TraceDump(int (*out)(void *ctx,const char *s,unsigned int len),void *ctx);
+
+/* 库自身定义了fread/fclose等同名接口，这里用系统调用写文件 */
+static int YC_OS_TraceOut(void *ctx,const char *s,unsigned int len)
+{
+    return (write(*(int *)ctx,s,len) == (ssize_t)len) ? 0 : -1;
+}
+
+/* 将跟踪事件导出为Chrome trace JSON文件，返回0成功 */
+int YC_OS_TraceExport(const char *path)
+{
+    int ret;
+    int fd = open(path,O_WRONLY | O_CREAT | O_TRUNC,0644);
+    if(fd < 0)
+        return -1;
+    ret = YC_FAT_TraceDump(YC_OS_TraceOut,&fd);
+    if(close(fd))
+        ret = -1;
+    return ret;
+}
+#endif
@@ -15,6 +15,8 @@
 #include "mheap.h"
 #include <stddef.h>
 #include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
 
 /* 对齐方式 */
 #if tBYTE_ALIGNMENT == 32
@@ -31,25 +33,46 @@
 #define tBYTE_ALIGNMENT_MASK    ( 0x0000 )
 #endif
 
-typedef struct stBLOCKBLINK
+/* 块头，低2位及最高位为标志：bit0本块已分配，bit1前一块已分配，bit31本块可被碎片整理移动 */
+/* 空闲块在块头之后存放空闲链表指针，在块尾存放块大小（边界标记），已分配块只有块头 */
+typedef struct stBLOCKHEAD
 {
-    /* 指向下一个对象block首地址 */
-    struct stBLOCKBLINK* pNextBlockLinkStruct;
-    /* 对象空间大小 */
-    unsigned int AllocSize;
-}BlockLink_t, * pBlockLink;
+    /* 块总大小（含块头），按tBYTE_ALIGNMENT对齐 */
+    unsigned int SizeFlag;
+    /* 以下两项只在空闲块中有效，与用户数据空间重叠 */
+    struct stBLOCKHEAD* pPrevFree;
+    struct stBLOCKHEAD* pNextFree;
+}BlockHead_t, * pBlockHead;
 
-/* 校验是否以规定字节对齐 */
-#define BlkAssertAligned(size) if(0 != (size&tBYTE_ALIGNMENT_MASK)) { return NULL; }
+#define BLK_USED        0x1u
+#define BLK_PREV_USED   0x2u
+#define BLK_MOVABLE     0x80000000u
+#define BLK_FLAG_MASK   (0x3u | BLK_MOVABLE)
 
-/* 头尾Block节点AllocSize值为0 */
-BlockLink_t* ObjStartBlock, * ObjEndBlock;
+#define BLK_SIZE(b)     ((b)->SizeFlag & ~BLK_FLAG_MASK)
+#define BLK_IS_USED(b)  ((b)->SizeFlag & BLK_USED)
+#define BLK_NEXT(b)     ((pBlockHead)((unsigned char*)(b) + BLK_SIZE(b)))
+/* 空闲块尾部的边界标记 */
+#define BLK_FOOTER(b)   (*(unsigned int*)((unsigned char*)(b) + BLK_SIZE(b) - sizeof(unsigned int)))
 
-/* 剩余近似最大内存，由于堆不同于栈的特殊性，碎片化严重，不能时刻计算出一个准确的使用率 */
-static int maxRemainingSize = 0;
+/* 向上作字节对齐 */
+#define ALIGN_UP(n)     (((n) + tBYTE_ALIGNMENT_MASK) & ~((unsigned int)tBYTE_ALIGNMENT_MASK))
 
-/* 已分配对象句柄数目 */
-static int ObjAllocated = 0;
+/* 已分配块块头大小，用户数据紧随其后 */
+#define BLK_HDR_SIZE    ALIGN_UP(sizeof(unsigned int))
+/* 最小块大小，需容纳空闲链表指针及边界标记 */
+#define BLK_MIN_SIZE    ALIGN_UP(sizeof(BlockHead_t) + sizeof(unsigned int))
+
+/* 可移动块在用户数据前存放登记的引用地址，碎片整理移动块后据此修正引用 */
+#define MOV_SLOT_SIZE   ALIGN_UP(sizeof(void**))
+#define BLK_MOV_REF(b)  (*(void***)((unsigned char*)(b) + BLK_HDR_SIZE))
+
+/* 剩余空闲内存减少后更新峰值 */
+#define MEM_PEAK_UPDATE(ar) \
+    do { \
+        unsigned int used_ = (unsigned int)((unsigned char*)(ar)->pEnd - (unsigned char*)(ar)->pStart) - (ar)->maxRemainingSize; \
+        if (used_ > (ar)->Stats.PeakBytes) (ar)->Stats.PeakBytes = used_; \
+    } while (0)
 
 /* 定义全局静态堆 */
 #if tBYTE_ALIGNMENT == 32
@@ -66,70 +89,109 @@ static unsigned char theap[tMEM_SIZETOALLOC] __attribute__((aligned(2)));
 static unsigned char theap[tMEM_SIZETOALLOC] __attribute__((aligned(1)));
 #endif
 
-/* BlockLink结构体所需要分配的堆大小（向上作字节对齐） */
-static const unsigned int BlockLinkStructSize = (sizeof(BlockLink_t) + ((unsigned int)(tBYTE_ALIGNMENT - 1))) & ~((unsigned int)tBYTE_ALIGNMENT_MASK);
+/* 公共分区，管理全局静态堆，所有线程共用，访问时加锁 */
+static tArena_t GlobalArena = { .pMem = theap, .MemSize = tMEM_SIZETOALLOC };
+
+/* 已注册分区链表，只在表头插入，从不删除，遍历无需加锁 */
+static tArena_t * volatile ArenaList = &GlobalArena;
+
+/* 当前线程绑定的私有分区，未绑定时使用公共分区 */
+static tMEM_THREAD_LOCAL tArena_t *CurArena = NULL;
+
+/* 对象是否分配在分区中 */
+#define IN_ARENA(ar, p) (((unsigned char*)(p) >= (ar)->pMem) && ((unsigned char*)(p) < (ar)->pMem + (ar)->MemSize))
 
 /* 堆使用率,单位百分比 */
 unsigned char memUsgRt;  
 
-void **p_relloc;
+static void tFreeHeap(tArena_t *ar, void* tObj);
+#if tMEM_DFGMENTATION
+static void tDefrag(tArena_t *ar);
+#endif
+
+/**********************************************************************
+ * 函数名称： tSizeClass
+ * 功能描述： 计算块大小所在的空闲链表级别（向下取整的2的对数）
+ * 输入参数： size 块大小
+ * 输出参数： 无
+ * 返 回 值： 级别
+ ***********************************************************************/
+static unsigned int tSizeClass(unsigned int size)
+{
+    return 31 - __builtin_clz(size);
+}
+
+/**********************************************************************
+ * 函数名称： tInsertFree / tRemoveFree
+ * 功能描述： 将空闲块插入对应级别的空闲链表头部 / 从空闲链表中移除
+ * 输入参数： ar 分区 blk 空闲块
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+static void tInsertFree(tArena_t *ar, pBlockHead blk)
+{
+    unsigned int c = tSizeClass(BLK_SIZE(blk));
+
+    blk->pPrevFree = NULL;
+    blk->pNextFree = ar->FreeList[c];
+    if (ar->FreeList[c])
+        ar->FreeList[c]->pPrevFree = blk;
+    ar->FreeList[c] = blk;
+    ar->FreeMap |= (1u << c);
+
+    /* 写入边界标记 */
+    BLK_FOOTER(blk) = BLK_SIZE(blk);
+}
+
+static void tRemoveFree(tArena_t *ar, pBlockHead blk)
+{
+    unsigned int c = tSizeClass(BLK_SIZE(blk));
+
+    if (blk->pPrevFree)
+        blk->pPrevFree->pNextFree = blk->pNextFree;
+    else
+        ar->FreeList[c] = blk->pNextFree;
+    if (blk->pNextFree)
+        blk->pNextFree->pPrevFree = blk->pPrevFree;
+    if (NULL == ar->FreeList[c])
+        ar->FreeMap &= ~(1u << c);
+}
 
 /**********************************************************************
  * 函数名称： tInitializeHeap
- * 功能描述： 初始化静态堆
- * 输入参数： 无
+ * 功能描述： 初始化分区内存，整个分区作为一个空闲块，尾部放置哨兵块
+ * 输入参数： ar 分区
  * 输出参数： 无
  * 返 回 值： 堆内存首地址
  * 修改日期        版本号     修改人	      修改内容
  * -----------------------------------------------
  * 2023/08/14	    V1.0	  jinyicheng	      创建
  ***********************************************************************/
-static void* tInitializeHeap(void)
+static void* tInitializeHeap(tArena_t *ar)
 {
     unsigned char* heapInv;
     unsigned int heapSizeLeft;
-    unsigned int pTemp;
-
-    /* 保存堆内存首地址 */
-    unsigned int t_HeapBottom = (unsigned int)theap;
-
-    /* 向上作字节对齐 */
-    if (t_HeapBottom & tBYTE_ALIGNMENT_MASK)
-        t_HeapBottom = t_HeapBottom - (t_HeapBottom & tBYTE_ALIGNMENT_MASK) + tBYTE_ALIGNMENT;
-
-    /* 保存字节对齐后的地址，作为堆的首地址 */
-    heapInv = (unsigned char*)t_HeapBottom;
-
-    /* 计算Heap剩余空间 */
-    heapSizeLeft = tMEM_SIZETOALLOC - (t_HeapBottom - (unsigned int)theap);
-
-    /* 在堆内存尾部插入BlockLink节点*/
-    /* 1.先对该节点所在地址作字节对齐 */
-    pTemp = (unsigned int)(heapInv + heapSizeLeft - BlockLinkStructSize);
-    pTemp &= ~((unsigned int)tBYTE_ALIGNMENT_MASK);//向下作字节对齐
-
-    /* 2.对首位链表地址之差进行字节对齐校验 */
-    BlkAssertAligned((pTemp - (unsigned int)heapInv));
 
-    /* 3.填充堆内存尾部的BlockBlink节点 */
-    ObjEndBlock = (pBlockLink)pTemp;
-    ObjEndBlock->AllocSize = 0;
-    ObjStartBlock = NULL;
+    /* 向上作字节对齐，作为堆的首地址 */
+    heapInv = ar->pMem + ((tBYTE_ALIGNMENT - ((uintptr_t)ar->pMem & tBYTE_ALIGNMENT_MASK)) & tBYTE_ALIGNMENT_MASK);
 
-    /* 在堆内存首部插入BlockLink节点 */
-    ObjStartBlock = (pBlockLink)heapInv;
-    ObjStartBlock->pNextBlockLinkStruct = ObjEndBlock;
-    ObjStartBlock->AllocSize = 0;
+    /* 计算Heap剩余空间，尾部留出哨兵块块头 */
+    if (ar->MemSize < (unsigned int)(heapInv - ar->pMem) + BLK_HDR_SIZE + BLK_MIN_SIZE)
+        return NULL;
+    heapSizeLeft = (ar->MemSize - (heapInv - ar->pMem) - BLK_HDR_SIZE) & ~((unsigned int)tBYTE_ALIGNMENT_MASK);
+    if (heapSizeLeft < BLK_MIN_SIZE)
+        return NULL;
 
-    /* 将首结点下一个成员赋值为尾节点，形成单向循环链表 */
-    ObjEndBlock->pNextBlockLinkStruct = ObjStartBlock;
+    /* 尾部哨兵块，释放时不会与之合并 */
+    ar->pEnd = (pBlockHead)(heapInv + heapSizeLeft);
+    ar->pEnd->SizeFlag = BLK_USED;
 
-    /* 计算剩余近似最大内存 */
-    maxRemainingSize = pTemp - (unsigned int)heapInv;
-    maxRemainingSize = maxRemainingSize - BlockLinkStructSize;
+    /* 整个堆作为一个空闲块，前一块视为已分配 */
+    ar->pStart = (pBlockHead)heapInv;
+    ar->pStart->SizeFlag = heapSizeLeft | BLK_PREV_USED;
+    tInsertFree(ar, ar->pStart);
 
-    /* 剩余空间是否能N字节对齐 */
-    BlkAssertAligned(maxRemainingSize);
+    ar->maxRemainingSize = heapSizeLeft;
 
     /* 返回可用堆内存首地址 */
     return (void*)heapInv;
@@ -137,234 +199,475 @@ static void* tInitializeHeap(void)
 
 /**********************************************************************
  * 函数名称： tAllocHeap
- * 功能描述： 从静态内存为用户对象动态分配空间
- * 输入参数： 无
+ * 功能描述： 从分区为用户对象动态分配空间，调用者保证对分区的独占访问
+ *            从不小于所需大小的最低非空级别中取链表头部的块，级别查找借助位图为常数时间
+ *            这些级别都没有空闲块时，在所需大小所在的级别中首次适配
+ * 输入参数： ar 分区 sizeToAlloc 对象大小
  * 输出参数： 无
  * 返 回 值： 返回用户对象句柄
  * 修改日期        版本号     修改人	      修改内容
  * -----------------------------------------------
  * 2023/08/14	    V1.0	  jinyicheng	      创建
  ***********************************************************************/
-static void* tAllocHeap(unsigned int sizeToAlloc)
+static void* tAllocHeap(tArena_t *ar, unsigned int sizeToAlloc)
 {
-    BlockLink_t * pObjBlock = NULL, * pObjBlkInd = ObjStartBlock, * pToInsert = NULL;
-    unsigned int BlockRemaining = 0;
-    unsigned int MinimumSize = 0;
-    int block_diff;
-    bool MinFound = false;
-    BlockLink_t * pToInsertLastBlk = NULL;
+    pBlockHead blk = NULL, rest;
+    unsigned int c, map, size;
 
     /* 检查堆是否已被初始化 */
-    if (ObjEndBlock == NULL) {
-        if (NULL == tInitializeHeap()) {
+    if (ar->pEnd == NULL) {
+        if (NULL == tInitializeHeap(ar)) {
             return NULL;
         }
     }
 
-    /* 传参校验，计算所需堆大小 */
-    if (sizeToAlloc > 0)
-    {
-        /* 总分配空间大小等于用户所需空间加BlockLink结构体所需要分配的堆大小，BlockLink需单独作字节对齐 */
-        sizeToAlloc = sizeToAlloc + BlockLinkStructSize;
+    /* 传参校验，总分配空间大小等于用户所需空间加块头大小，向上作对齐 */
+    if ((0 == sizeToAlloc) || (sizeToAlloc > ar->MemSize))
+        return NULL;
+    size = ALIGN_UP(sizeToAlloc + BLK_HDR_SIZE);
+    if (size < BLK_MIN_SIZE)
+        size = BLK_MIN_SIZE;
 
-        /* 将分配到的总空间继续向上作对齐 */
-        if (0x00 != (sizeToAlloc & tBYTE_ALIGNMENT_MASK))
+    /* 所需大小不是2的幂时，从上一级开始取，保证链表头部的块一定足够大 */
+    c = tSizeClass(size);
+    if (size & (size - 1))
+        c ++;
+    map = (c < tMEM_CLASS_NUM) ? (ar->FreeMap & (~0u << c)) : 0;
+    if (map)
+    {
+        blk = ar->FreeList[__builtin_ctz(map)];
+    }
+    else
+    {
+        /* 在所需大小所在的级别中首次适配 */
+        for (blk = ar->FreeList[tSizeClass(size)]; blk && (BLK_SIZE(blk) < size); blk = blk->pNextFree);
+        if (NULL == blk)
         {
-            if (sizeToAlloc + (sizeToAlloc - (sizeToAlloc & tBYTE_ALIGNMENT_MASK) + tBYTE_ALIGNMENT)
-                > sizeToAlloc)
-            {
-                sizeToAlloc = sizeToAlloc - (sizeToAlloc & tBYTE_ALIGNMENT_MASK) + tBYTE_ALIGNMENT;
-                BlkAssertAligned(sizeToAlloc);
-            }
-            else
-            {
-                sizeToAlloc = 0;
-            }
+            ar->Stats.FailCnt ++;
+            return NULL;
         }
     }
-    else {
-        return NULL;
+    tRemoveFree(ar, blk);
+
+    /* 剩余部分足够大时分裂为新的空闲块 */
+    if (BLK_SIZE(blk) - size >= BLK_MIN_SIZE)
+    {
+        rest = (pBlockHead)((unsigned char*)blk + size);
+        rest->SizeFlag = (BLK_SIZE(blk) - size) | BLK_PREV_USED;
+        tInsertFree(ar, rest);
+        blk->SizeFlag = size | (blk->SizeFlag & BLK_PREV_USED);
     }
+    else
+    {
+        BLK_NEXT(blk)->SizeFlag |= BLK_PREV_USED;
+    }
+    blk->SizeFlag |= BLK_USED;
 
-    if (sizeToAlloc) {
-        /* 在堆中初始化BlockLink，并插入到列表中 */
-        /* 1.添加第一个对象 */
-        if (
-            (ObjAllocated == 0) && \
-            (sizeToAlloc <= (((unsigned int)ObjStartBlock->pNextBlockLinkStruct)-((unsigned int)ObjStartBlock)-BlockLinkStructSize))
-            )
-        {
-            pObjBlock = (unsigned int)ObjStartBlock + BlockLinkStructSize;
-            (BlockLink_t *)pObjBlock;
-            pObjBlock->AllocSize = sizeToAlloc - BlockLinkStructSize;
+    ar->ObjAllocated ++;
+    ar->maxRemainingSize -= BLK_SIZE(blk);
+    ar->Stats.AllocCnt ++;
+    ar->Stats.ClassAlloc[tSizeClass(BLK_SIZE(blk))] ++;
+    MEM_PEAK_UPDATE(ar);
 
-            /* 将该Block节点插入链表 */
-            ObjStartBlock->pNextBlockLinkStruct = (BlockLink_t *)pObjBlock;
-            pObjBlock->pNextBlockLinkStruct = ObjEndBlock;
+    /* 返回对象句柄 */
+    return (void *)((unsigned char*)blk + BLK_HDR_SIZE);
+}
 
-            ObjAllocated ++;
+/**********************************************************************
+ * 函数名称： tArenaOf
+ * 功能描述： 查找对象所在的分区
+ * 输入参数： tObj 对象句柄
+ * 输出参数： 无
+ * 返 回 值： 分区，对象不在任何分区中（由系统分配）返回NULL
+ ***********************************************************************/
+static tArena_t *tArenaOf(void *tObj)
+{
+    tArena_t *ar;
 
-            /* 计算剩余近似最大内存 */
-            maxRemainingSize = maxRemainingSize - sizeToAlloc;
+    for (ar = __atomic_load_n(&ArenaList, __ATOMIC_ACQUIRE); ar; ar = ar->pNext)
+    {
+        if (IN_ARENA(ar, tObj))
+            return ar;
+    }
+    return NULL;
+}
 
-            /* 返回对象句柄 */
-            return (void *)((unsigned int)ObjStartBlock + BlockLinkStructSize + BlockLinkStructSize);
-        }
+/**********************************************************************
+ * 函数名称： tArenaLock / tArenaUnlock
+ * 功能描述： 公共分区加锁 / 解锁，私有分区只由所属线程访问，无需加锁
+ * 输入参数： ar 分区
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+static void tArenaLock(tArena_t *ar)
+{
+    if (ar != &GlobalArena)
+        return;
+    while (__atomic_exchange_n(&ar->Lock, 1, __ATOMIC_ACQUIRE))
+    {
+        while (__atomic_load_n(&ar->Lock, __ATOMIC_RELAXED));
+    }
+}
 
-        /* 2.添加第n(n != 1)对象 */
-        MinimumSize = (unsigned int)pObjBlkInd->pNextBlockLinkStruct - (unsigned int)pObjBlkInd\
-            - BlockLinkStructSize - pObjBlkInd->AllocSize;
+static void tArenaUnlock(tArena_t *ar)
+{
+    if (ar == &GlobalArena)
+        __atomic_store_n(&ar->Lock, 0, __ATOMIC_RELEASE);
+}
 
-        /* 遍历链表，选择适合插入的位置 */
-        for (pObjBlkInd = ObjStartBlock; pObjBlkInd < ObjEndBlock; pObjBlkInd = pObjBlkInd->pNextBlockLinkStruct)
-        {
-            block_diff = (unsigned int)pObjBlkInd->pNextBlockLinkStruct - (unsigned int)pObjBlkInd\
-                - BlockLinkStructSize - pObjBlkInd->AllocSize;
-            if (block_diff > 0) {
-                MinimumSize = block_diff; MinFound = true;
-            }
-            /* 找出最小适合插入对象的堆空间 */
-            if (true == MinFound) {
-                if ((block_diff <= MinimumSize) && (block_diff > 0)\
-                    && (block_diff >= sizeToAlloc)) {
-                    MinimumSize = block_diff;
-
-                    /* 记录适合插入该节点所在位置的上一节点 */
-                    pToInsertLastBlk = pObjBlkInd;
-
-                    /* 找出适合插入节点的地址 */
-                    pToInsert = (pBlockLink)(((unsigned int)pObjBlkInd->pNextBlockLinkStruct) - MinimumSize);
-                }
-            }
-        }
-        if (MinimumSize < sizeToAlloc) return NULL;
-        
-        BlkAssertAligned((unsigned int)pToInsert);
+/**********************************************************************
+ * 函数名称： tRemoteFree
+ * 功能描述： 释放其他线程私有分区中的对象，压入该分区的无锁释放栈，由所属线程下次分配时回收
+ *            对象首字用于串联，只有所属线程整体取走释放栈，不存在ABA问题
+ * 输入参数： ar 对象所在分区 tObj 对象句柄
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+static void tRemoteFree(tArena_t *ar, void *tObj)
+{
+    void *head = __atomic_load_n(&ar->pRemoteFree, __ATOMIC_RELAXED);
 
-        /* 赋值该节点对象所占空间大小 */
-        pToInsert->AllocSize = sizeToAlloc - BlockLinkStructSize;
+    do
+    {
+        *(void **)tObj = head;
+    } while (!__atomic_compare_exchange_n(&ar->pRemoteFree, &head, tObj, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
 
-        /* 将该Block节点插入链表 */
-        pToInsert->pNextBlockLinkStruct = pToInsertLastBlk->pNextBlockLinkStruct;
-        pToInsertLastBlk->pNextBlockLinkStruct = pToInsert;
+/**********************************************************************
+ * 函数名称： tRemoteDrain
+ * 功能描述： 由所属线程回收其他线程释放到本分区的对象
+ * 输入参数： ar 分区
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+static void tRemoteDrain(tArena_t *ar)
+{
+    void *obj, *next;
 
-        ObjAllocated += 1;
+    if (NULL == __atomic_load_n(&ar->pRemoteFree, __ATOMIC_RELAXED))
+        return;
+    for (obj = __atomic_exchange_n(&ar->pRemoteFree, NULL, __ATOMIC_ACQUIRE); obj; obj = next)
+    {
+        next = *(void **)obj;
+        tFreeHeap(ar, obj);
+    }
+}
 
-        /* 计算剩余近似最大内存 */
-        maxRemainingSize = maxRemainingSize - sizeToAlloc;
+/**********************************************************************
+ * 函数名称： tArenaAlloc
+ * 功能描述： 从分区分配，支持碎片整理时整理后重试一次，调用者保证对分区的独占访问
+ * 输入参数： ar 分区 sizeToAlloc 大小
+ * 输出参数： 无
+ * 返 回 值： 对象句柄
+ ***********************************************************************/
+static void *tArenaAlloc(tArena_t *ar, unsigned int sizeToAlloc)
+{
+    void *p = tAllocHeap(ar, sizeToAlloc);
 
-        /* 返回对象句柄 */
-        return (void *)((unsigned int)pToInsert + BlockLinkStructSize);
+#if tMEM_DFGMENTATION
+    if (NULL == p)
+    {
+        tDefrag(ar);
+        p = tAllocHeap(ar, sizeToAlloc);
     }
+#endif
+    return p;
+}
 
-    return NULL;
+/**********************************************************************
+ * 函数名称： tArenaInit
+ * 功能描述： 以静态内存区域初始化私有分区并注册，注册后的分区不能注销
+ * 输入参数： ar 分区 mem 内存区域 size 区域大小
+ * 输出参数： 无
+ * 返 回 值： 0成功，-1区域过小
+ ***********************************************************************/
+int tArenaInit(tArena_t *ar, void *mem, unsigned int size)
+{
+    memset(ar, 0, sizeof(tArena_t));
+    ar->pMem = (unsigned char *)mem;
+    ar->MemSize = size;
+    if (NULL == tInitializeHeap(ar))
+        return -1;
+
+    /* 插入已注册分区链表表头 */
+    ar->pNext = __atomic_load_n(&ArenaList, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&ArenaList, &ar->pNext, ar, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    return 0;
 }
 
 /**********************************************************************
- * 函数名称： tRealloc
- * 功能描述： 为用户对象重新分配内存
- * 输入参数： tObj size
+ * 函数名称： tArenaBind
+ * 功能描述： 将私有分区绑定到当前线程，此后本线程优先从该分区分配，无需加锁
+ *            一个私有分区只能绑定到一个线程，传入NULL解除绑定
+ *            换绑或解除绑定时先回收原分区释放栈中的对象，线程退出前应解除绑定；
+ *            解除后其他线程释放的对象仍压入释放栈，分区再次绑定后首次分配时回收
+ * 输入参数： ar 分区
  * 输出参数： 无
- * 返 回 值： 对象句柄
+ * 返 回 值： 无
+ ***********************************************************************/
+void tArenaBind(tArena_t *ar)
+{
+    if ((NULL != CurArena) && (ar != CurArena))
+        tRemoteDrain(CurArena);
+    CurArena = ar;
+}
+
+/**********************************************************************
+ * 函数名称： tShrinkBlock
+ * 功能描述： 将已分配块截为size大小，剩余部分足够大时成为空闲块并与后一空闲块合并
+ * 输入参数： ar 分区 blk 已分配块 size 新的块大小（已对齐，不大于原块大小）
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+static void tShrinkBlock(tArena_t *ar, pBlockHead blk, unsigned int size)
+{
+    pBlockHead rest, next;
+    unsigned int restSize = BLK_SIZE(blk) - size;
+
+    /* 剩余部分不足一个空闲块，保留在本块中 */
+    if (restSize < BLK_MIN_SIZE)
+    {
+        BLK_NEXT(blk)->SizeFlag |= BLK_PREV_USED;
+        return;
+    }
+
+    blk->SizeFlag = size | (blk->SizeFlag & BLK_FLAG_MASK);
+    ar->maxRemainingSize += restSize;
+
+    rest = BLK_NEXT(blk);
+    next = (pBlockHead)((unsigned char*)rest + restSize);
+    if (!BLK_IS_USED(next))
+    {
+        tRemoveFree(ar, next);
+        restSize += BLK_SIZE(next);
+    }
+    rest->SizeFlag = restSize | BLK_PREV_USED;
+    tInsertFree(ar, rest);
+    BLK_NEXT(rest)->SizeFlag &= ~BLK_PREV_USED;
+}
+
+/**********************************************************************
+ * 函数名称： tResizeBlock
+ * 功能描述： 原地调整已分配块大小，收缩时释放尾部空间，增长时与后一空闲块合并
+ * 输入参数： ar 分区 blk 已分配块 need 新的块大小（已对齐）
+ * 输出参数： 无
+ * 返 回 值： 0成功，-1无法原地调整
+ ***********************************************************************/
+static int tResizeBlock(tArena_t *ar, pBlockHead blk, unsigned int need)
+{
+    pBlockHead next;
+
+    /* 收缩 */
+    if (need <= BLK_SIZE(blk))
+    {
+        tShrinkBlock(ar, blk, need);
+        return 0;
+    }
+
+    /* 与后一空闲块合并后足够大 */
+    next = BLK_NEXT(blk);
+    if (!BLK_IS_USED(next) && (BLK_SIZE(blk) + BLK_SIZE(next) >= need))
+    {
+        tRemoveFree(ar, next);
+        ar->maxRemainingSize -= BLK_SIZE(next);
+        blk->SizeFlag += BLK_SIZE(next);
+        tShrinkBlock(ar, blk, need);
+        MEM_PEAK_UPDATE(ar);
+        return 0;
+    }
+    return -1;
+}
+
+/**********************************************************************
+ * 函数名称： tMergePrev
+ * 功能描述： 已分配块与前一空闲块（及后一空闲块）合并后足够大时，数据以一次memmove前移
+ * 输入参数： ar 分区 blk 已分配块 need 新的块大小（已对齐）
+ * 输出参数： 无
+ * 返 回 值： 新的对象句柄，无法合并返回NULL
+ ***********************************************************************/
+static void *tMergePrev(tArena_t *ar, pBlockHead blk, unsigned int need)
+{
+    pBlockHead next, prev;
+    unsigned int avail;
+
+    if (blk->SizeFlag & BLK_PREV_USED)
+        return NULL;
+
+    prev = (pBlockHead)((unsigned char*)blk - *((unsigned int*)blk - 1));
+    next = BLK_NEXT(blk);
+    avail = BLK_SIZE(prev) + BLK_SIZE(blk) + (BLK_IS_USED(next) ? 0 : BLK_SIZE(next));
+    if (avail < need)
+        return NULL;
+
+    tRemoveFree(ar, prev);
+    ar->maxRemainingSize -= BLK_SIZE(prev);
+    if (!BLK_IS_USED(next))
+    {
+        tRemoveFree(ar, next);
+        ar->maxRemainingSize -= BLK_SIZE(next);
+    }
+    /* 空闲块之前必为已分配块 */
+    memmove((unsigned char*)prev + BLK_HDR_SIZE, (unsigned char*)blk + BLK_HDR_SIZE, BLK_SIZE(blk) - BLK_HDR_SIZE);
+    prev->SizeFlag = avail | BLK_USED | BLK_PREV_USED;
+    tShrinkBlock(ar, prev, need);
+    MEM_PEAK_UPDATE(ar);
+    return (void *)((unsigned char*)prev + BLK_HDR_SIZE);
+}
+
+/**********************************************************************
+ * 函数名称： tReallocInPlace
+ * 功能描述： 原地调整用户对象大小，不移动对象
+ *            收缩时释放尾部空间，增长时与后一空闲块合并
+ *            只能调整本线程私有分区或公共分区中的对象，不适用于tAllocMovable分配的对象
+ * 输入参数： tObj 对象句柄 size 新大小
+ * 输出参数： 无
+ * 返 回 值： 0成功，-1无法原地调整（对象保持不变）
  * 修改日期        版本号     修改人	      修改内容
  * -----------------------------------------------
  * 2023/11/09	    V1.0	  jinyicheng	      创建
  ***********************************************************************/
-void *tRealloc(void *tObj, size_t size)
+int tReallocInPlace(void *tObj, size_t size)
 {
-    /* 若对象被分配在bss段 */
-    if(
-        ( (unsigned int)tObj >= (unsigned int)theap ) || \
-        ( (unsigned int)tObj <= ((unsigned int)theap+tMEM_SIZETOALLOC) )
-    )
-    {
-        /* 获得对象句柄所在Block节点首地址 */
-        pBlockLink pBlockToFree = (pBlockLink)((unsigned int)tObj - BlockLinkStructSize);
-        if(size <= pBlockToFree->AllocSize){
-            pBlockToFree->AllocSize = size;
-            return (void *)tObj;
-        }
-        if(((unsigned int)pBlockToFree->pNextBlockLinkStruct-(unsigned int)pBlockToFree-BlockLinkStructSize-pBlockToFree->AllocSize) >= (size-pBlockToFree->AllocSize))
-        {
-            pBlockToFree->AllocSize = size;
-            return (void *)tObj;
-        }
-        else
-        {
-            /* 重定位节点对象，原节点置空 */
-            tFreeHeap(tObj);
-            return tAllocHeap(size);
-        }
-    }
-    return NULL;
+    tArena_t *ar = tArenaOf(tObj);
+    unsigned int need;
+    int ret;
+
+    /* 传参校验 */
+    if ((NULL == ar) || ((ar != CurArena) && (ar != &GlobalArena)) || (0 == size) || (size > ar->MemSize))
+        return -1;
+
+    need = ALIGN_UP((unsigned int)size + BLK_HDR_SIZE);
+    if (need < BLK_MIN_SIZE)
+        need = BLK_MIN_SIZE;
+
+    tArenaLock(ar);
+    ret = tResizeBlock(ar, (pBlockHead)((unsigned char*)tObj - BLK_HDR_SIZE), need);
+    tArenaUnlock(ar);
+    return ret;
 }
 
 /**********************************************************************
- * 函数名称： tTakeBlockPos
- * 功能描述： 从单向循环链表中寻找此节点所在的位置
- * 输入参数： Block 此节点
+ * 函数名称： tRealloc
+ * 功能描述： 为用户对象重新分配内存，内容保持不变
+ *            依次尝试：原地收缩或与后一空闲块合并；与前一空闲块（及后一空闲块）合并，
+ *            数据以一次memmove前移；另行分配并复制，原块释放
+ *            其他线程私有分区中的对象总是另行分配
+ *            不适用于tAllocMovable分配的对象
+ * 输入参数： tObj 对象句柄 size 新大小
  * 输出参数： 无
- * 返 回 值： 上一节点句柄
+ * 返 回 值： 对象句柄，失败返回NULL（原对象保持不变）
  * 修改日期        版本号     修改人	      修改内容
  * -----------------------------------------------
- * 2023/08/15	    V1.0	  jinyicheng	      创建
+ * 2023/11/09	    V1.0	  jinyicheng	      创建
  ***********************************************************************/
-static void* tTakeBlockPos(BlockLink_t * Block)
+void *tRealloc(void *tObj, size_t size)
 {
-    pBlockLink pObjBlkInd, pObjToFree;
+    tArena_t *ar;
+    pBlockHead blk;
+    unsigned int need, old;
+    void *p = NULL;
 
-    pObjToFree = Block;
-    pObjBlkInd = ObjStartBlock;
+    if (NULL == tObj)
+        return tAllocHeapforeach((unsigned int)size);
 
-    /* 遍历链表中的Block节点 */
-    for (;pObjBlkInd <= ObjEndBlock;pObjBlkInd = pObjBlkInd->pNextBlockLinkStruct)
+    /* 由系统分配的对象 */
+    ar = tArenaOf(tObj);
+    if (NULL == ar)
     {
-        /* 若此节点的下一个节点是传入的Block，则返回当前节点 */
-        if (pObjBlkInd->pNextBlockLinkStruct == Block)
-        {
-            return pObjBlkInd;
-        }
+#if tMEM_MALLOC_FALLBACK
+        return realloc(tObj, size);
+#else
+        return NULL;
+#endif
     }
-    return NULL;
+    if ((0 == size) || (size > ar->MemSize))
+        return NULL;
+
+    blk = (pBlockHead)((unsigned char*)tObj - BLK_HDR_SIZE);
+    need = ALIGN_UP((unsigned int)size + BLK_HDR_SIZE);
+    if (need < BLK_MIN_SIZE)
+        need = BLK_MIN_SIZE;
+
+    /* 原地调整或与前一空闲块合并 */
+    if ((ar == CurArena) || (ar == &GlobalArena))
+    {
+        tArenaLock(ar);
+        if (0 == tResizeBlock(ar, blk, need))
+            p = tObj;
+        else
+            p = tMergePrev(ar, blk, need);
+        tArenaUnlock(ar);
+        if (NULL != p)
+            return p;
+    }
+
+    /* 重定位对象，原块释放 */
+    p = tAllocHeapforeach((unsigned int)size);
+    if (NULL == p)
+        return NULL;
+    old = BLK_SIZE(blk) - BLK_HDR_SIZE;
+    memcpy(p, tObj, (old < size) ? old : size);
+    tFreeHeapforeach(tObj);
+    return p;
 }
 
 /**********************************************************************
  * 函数名称： tFreeHeap
- * 功能描述： 从堆内存释放用户对象
- * 输入参数： tObj 对象句柄
+ * 功能描述： 从分区释放用户对象，调用者保证对分区的独占访问
+ *            借助块头标志及前一空闲块的边界标记，与相邻空闲块合并均为常数时间
+ * 输入参数： ar 分区 tObj 对象句柄
  * 输出参数： 无
  * 返 回 值： 无
  * 修改日期        版本号     修改人	      修改内容
  * -----------------------------------------------
  * 2023/08/15	    V1.0	  jinyicheng	      创建
  ***********************************************************************/
-static void tFreeHeap(void* tObj)
+static void tFreeHeap(tArena_t *ar, void* tObj)
 {
-    pBlockLink pBlockToFree = NULL;
-    pBlockLink pBlockToFreeLast = NULL;
+    pBlockHead blk, next, prev;
+    unsigned int size;
 
     /* 传参校验 */
     if (NULL == tObj)
         return;
 
-    /* 获得对象句柄所在Block节点首地址 */
-    pBlockToFree = (pBlockLink)((unsigned int)tObj - BlockLinkStructSize);
+    /* 获得对象句柄所在块首地址 */
+    blk = (pBlockHead)((unsigned char*)tObj - BLK_HDR_SIZE);
+    if (!BLK_IS_USED(blk))
+        return;
+    size = BLK_SIZE(blk);
+
+    ar->ObjAllocated -= 1;
+    ar->maxRemainingSize += size;
+    ar->Stats.FreeCnt ++;
 
-    /* 将该Block节点从链表移除 */
-    /* 1.先找出此节点的上一个节点 */
-    pBlockToFreeLast = (pBlockLink)tTakeBlockPos(pBlockToFree);
-    /* 2.将此节点的上一个节点指向此节点的下一个节点 */
-    pBlockToFreeLast->pNextBlockLinkStruct = pBlockToFree->pNextBlockLinkStruct;
+    /* 与后一空闲块合并 */
+    next = BLK_NEXT(blk);
+    if (!BLK_IS_USED(next))
+    {
+        tRemoveFree(ar, next);
+        size += BLK_SIZE(next);
+    }
+    /* 与前一空闲块合并，前一块大小由其边界标记得到 */
+    if (!(blk->SizeFlag & BLK_PREV_USED))
+    {
+        prev = (pBlockHead)((unsigned char*)blk - *((unsigned int*)blk - 1));
+        tRemoveFree(ar, prev);
+        size += BLK_SIZE(prev);
+        blk = prev;
+    }
 
-    ObjAllocated -= 1;
+    blk->SizeFlag = size | BLK_PREV_USED;
+    tInsertFree(ar, blk);
 
-    /* 计算剩余近似最大内存 */
-    maxRemainingSize = maxRemainingSize + pBlockToFree->AllocSize + BlockLinkStructSize;
+    /* 通知后一块：前一块已空闲 */
+    BLK_NEXT(blk)->SizeFlag &= ~BLK_PREV_USED;
 }
 
 /**********************************************************************
- * 函数名称： tFreeHeap
+ * 函数名称： tAllocHeapforeach
  * 功能描述： 从堆内存开辟空间
+ *            优先从本线程私有分区分配，不足时从公共分区分配，仍不足时由系统分配
  * 输入参数： 大小
  * 输出参数： 无
  * 返 回 值： 无
@@ -375,17 +678,46 @@ static void tFreeHeap(void* tObj)
 void * tAllocHeapforeach(unsigned int sizeToAlloc)
 {
     void * firstaddr = NULL;
+    tArena_t *ar = CurArena;
+    unsigned int t0, dt;
 
     if( (0 > sizeToAlloc) || (0 == sizeToAlloc) )
         return NULL;
 
-    /* 由系统为对象分配空间 */
-    firstaddr = tAllocHeap(sizeToAlloc);
-    
+    t0 = tMEM_TICK();
+
+    /* 私有分区，先回收其他线程释放的对象 */
+    if (NULL != ar)
+    {
+        tRemoteDrain(ar);
+        firstaddr = tArenaAlloc(ar, sizeToAlloc);
+    }
+
+    /* 公共分区 */
+    if (NULL == firstaddr)
+    {
+        ar = &GlobalArena;
+        tArenaLock(ar);
+        firstaddr = tArenaAlloc(ar, sizeToAlloc);
+#if tMEM_MALLOC_FALLBACK
+        if (NULL == firstaddr)
+            ar->Stats.MallocFallback ++;
+#endif
+    }
+
+    /* 统计静态堆分配耗时 */
+    dt = tMEM_TICK() - t0;
+    ar->Stats.AllocTicksTotal += dt;
+    if (dt > ar->Stats.AllocTicksMax)
+        ar->Stats.AllocTicksMax = dt;
+    tArenaUnlock(ar);
+
     /* 重新分配 */
     if(NULL == firstaddr)
     {
+#if tMEM_MALLOC_FALLBACK
         firstaddr = malloc(sizeToAlloc);
+#endif
         return firstaddr;
     }
     else
@@ -396,7 +728,7 @@ void * tAllocHeapforeach(unsigned int sizeToAlloc)
 
 /**********************************************************************
  * 函数名称： tFreeHeapforeach
- * 功能描述： 从堆内存回收空间
+ * 功能描述： 从堆内存回收空间，可释放其他线程分配的对象
  * 输入参数： tObj 对象句柄
  * 输出参数： 无
  * 返 回 值： 无
@@ -406,45 +738,287 @@ void * tAllocHeapforeach(unsigned int sizeToAlloc)
  ***********************************************************************/
 void tFreeHeapforeach(void* tObj)
 {
+    tArena_t *ar;
+
     /* 传参校验 */
     if (NULL == tObj)
         return;
 
-    /* 若对象被分配在bss段 */
-    if(
-        ( (unsigned int)tObj >= (unsigned int)theap ) || \
-        ( (unsigned int)tObj <= ((unsigned int)theap+tMEM_SIZETOALLOC) )
-        )
+    ar = tArenaOf(tObj);
+    /* 若对象由系统分配；未开启系统分配回退时不属于任何分区的指针不是本堆分配的，忽略 */
+    if (NULL == ar)
     {
-        tFreeHeap(tObj);
-        return;
+#if tMEM_MALLOC_FALLBACK
+        free(tObj);
+#endif
     }
-    /* 若对象由系统分配 */
+    /* 本线程私有分区或公共分区 */
+    else if ((ar == CurArena) || (ar == &GlobalArena))
+    {
+        tArenaLock(ar);
+        tFreeHeap(ar, tObj);
+        tArenaUnlock(ar);
+    }
+    /* 其他线程的私有分区 */
     else
     {
-        free(tObj);
+        tRemoteFree(ar, tObj);
     }
 }
 
 /**********************************************************************
  * 函数名称： CalcMemUsgRtLikely
- * 功能描述： 近似计算堆内存使用率
+ * 功能描述： 计算公共分区使用率
  * 输入参数： 无
  * 输出参数： 无
- * 返 回 值： 无
+ * 返 回 值： 使用率，单位百分比
  * 修改日期        版本号     修改人	      修改内容
  * -----------------------------------------------
  * 2023/09/16	    V1.0	  jinyicheng	      创建
  ***********************************************************************/
 unsigned char CalcMemUsgRtLikely(void *mem)
 {
-    memUsgRt = (sizeof(theap)-maxRemainingSize)*100/sizeof(theap);
+    tArena_t *ar = &GlobalArena;
+    unsigned int heapSize;
+
+    if (ar->pEnd == NULL)
+        return 0;
+    heapSize = (unsigned int)((unsigned char*)ar->pEnd - (unsigned char*)ar->pStart);
+    memUsgRt = (heapSize - ar->maxRemainingSize) * 100 / heapSize;
     return memUsgRt;
 }
 
+/**********************************************************************
+ * 函数名称： tArenaGetStats
+ * 功能描述： 获取分区统计信息，空闲块相关的统计遍历空闲链表得到
+ *            私有分区应由所属线程获取
+ * 输入参数： ar 分区
+ * 输出参数： st 统计信息
+ * 返 回 值： 无
+ ***********************************************************************/
+void tArenaGetStats(tArena_t *ar, tMemStats_t *st)
+{
+    pBlockHead blk;
+    unsigned int c;
+
+    tArenaLock(ar);
+    *st = ar->Stats;
+    if (ar->pEnd == NULL)
+    {
+        tArenaUnlock(ar);
+        return;
+    }
+
+    st->HeapSize = (unsigned int)((unsigned char*)ar->pEnd - (unsigned char*)ar->pStart);
+    st->FreeBytes = ar->maxRemainingSize;
+    st->LiveBytes = st->HeapSize - ar->maxRemainingSize;
+    st->LiveObjs = ar->ObjAllocated;
+    st->FreeBlocks = 0;
+    st->LargestFree = 0;
+    for (c = 0; c < tMEM_CLASS_NUM; c++)
+    {
+        st->ClassFree[c] = 0;
+        for (blk = ar->FreeList[c]; blk; blk = blk->pNextFree)
+        {
+            st->ClassFree[c] ++;
+            if (BLK_SIZE(blk) > st->LargestFree)
+                st->LargestFree = BLK_SIZE(blk);
+        }
+        st->FreeBlocks += st->ClassFree[c];
+    }
+    st->FragPercent = st->FreeBytes ? (100 - st->LargestFree * 100 / st->FreeBytes) : 0;
+    /* 可一次分配的最大空间 */
+    if (st->LargestFree >= BLK_HDR_SIZE)
+        st->LargestFree -= BLK_HDR_SIZE;
+    tArenaUnlock(ar);
+}
+
+/**********************************************************************
+ * 函数名称： tMemGetStats
+ * 功能描述： 获取公共分区统计信息
+ * 输入参数： 无
+ * 输出参数： st 统计信息
+ * 返 回 值： 无
+ ***********************************************************************/
+void tMemGetStats(tMemStats_t *st)
+{
+    tArenaGetStats(&GlobalArena, st);
+}
+
+/**********************************************************************
+ * 函数名称： tMemDumpStats
+ * 功能描述： 打印各分区统计信息，用于确定产品所需的tMEM_SIZETOALLOC及私有分区大小
+ * 输入参数： 无
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+void tMemDumpStats(void)
+{
+    tMemStats_t st;
+    tArena_t *ar;
+    unsigned int c;
+
+    for (ar = __atomic_load_n(&ArenaList, __ATOMIC_ACQUIRE); ar; ar = ar->pNext)
+    {
+        tArenaGetStats(ar, &st);
+        printf("%s %p\n", (ar == &GlobalArena) ? "global arena" : "arena", (void *)ar);
+        printf("heap %u live %u/%u objs peak %u free %u in %u blks largest %u frag %u%%\n",
+               st.HeapSize, st.LiveBytes, st.LiveObjs, st.PeakBytes, st.FreeBytes, st.FreeBlocks, st.LargestFree, st.FragPercent);
+        printf("alloc %u free %u fail %u malloc %u ticks max %u total %u\n",
+               st.AllocCnt, st.FreeCnt, st.FailCnt, st.MallocFallback, st.AllocTicksMax, st.AllocTicksTotal);
+        for (c = 0; c < tMEM_CLASS_NUM; c++)
+        {
+            if (st.ClassAlloc[c] || st.ClassFree[c])
+                printf("  class %2u [%u,%u) alloc %u free blks %u\n", c, 1u << c, (c < 31) ? (1u << (c + 1)) : 0u, st.ClassAlloc[c], st.ClassFree[c]);
+        }
+    }
+}
+
+#if tMEM_DFGMENTATION
+/**********************************************************************
+ * 函数名称： tAllocMovable
+ * 功能描述： 分配可被碎片整理移动的对象，并登记保存对象地址的引用
+ *            碎片整理移动对象后会更新*ref，引用本身须位于不会被移动的内存中，
+ *            使用者不得在碎片整理前后保留对象地址的其他副本
+ *            对象从本线程私有分区（未绑定时为公共分区）分配，只应由分配线程访问
+ * 输入参数： ref 保存对象地址的引用 sizeToAlloc 对象大小
+ * 输出参数： *ref 对象句柄
+ * 返 回 值： 对象句柄，空间不足返回NULL
+ * 修改日期        版本号     修改人	      修改内容
+ * -----------------------------------------------
+ * 2023/11/09	    V1.0	  jinyicheng	      创建
+ ***********************************************************************/
+void * tAllocMovable(void **ref, unsigned int sizeToAlloc)
+{
+    tArena_t *ar = CurArena ? CurArena : &GlobalArena;
+    unsigned char *p;
+
+    /* 传参校验 */
+    if ((NULL == ref) || (0 == sizeToAlloc))
+        return NULL;
+
+    tArenaLock(ar);
+    if (ar != &GlobalArena)
+        tRemoteDrain(ar);
+    /* 空间不足时整理碎片后重试 */
+    p = (unsigned char*)tAllocHeap(ar, sizeToAlloc + MOV_SLOT_SIZE);
+    if (NULL == p)
+    {
+        tDefrag(ar);
+        p = (unsigned char*)tAllocHeap(ar, sizeToAlloc + MOV_SLOT_SIZE);
+    }
+    if (NULL == p)
+    {
+        tArenaUnlock(ar);
+        *ref = NULL;
+        return NULL;
+    }
+
+    /* 标记为可移动并登记引用 */
+    ((pBlockHead)(p - BLK_HDR_SIZE))->SizeFlag |= BLK_MOVABLE;
+    *(void***)p = ref;
+    *ref = (void*)(p + MOV_SLOT_SIZE);
+    tArenaUnlock(ar);
+    return *ref;
+}
+
+/**********************************************************************
+ * 函数名称： tFreeMovable
+ * 功能描述： 释放由tAllocMovable分配的对象，并将引用置空
+ * 输入参数： ref 登记的引用
+ * 输出参数： 无
+ * 返 回 值： 无
+ * 修改日期        版本号     修改人	      修改内容
+ * -----------------------------------------------
+ * 2023/11/09	    V1.0	  jinyicheng	      创建
+ ***********************************************************************/
+void tFreeMovable(void **ref)
+{
+    /* 传参校验 */
+    if ((NULL == ref) || (NULL == tArenaOf(*ref)))
+        return;
+
+    tFreeHeapforeach((unsigned char*)*ref - MOV_SLOT_SIZE);
+    *ref = NULL;
+}
+
+/**********************************************************************
+ * 函数名称： tDefrag
+ * 功能描述： 分区碎片整理，调用者保证对分区的独占访问
+ *            从分区首向后遍历，将可移动块依次滑动到前方空闲空间并修正其登记的引用，
+ *            不可移动块保持原位，其前方剩余的空闲空间成为一个空闲块，最后重建空闲链表
+ * 输入参数： ar 分区
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+static void tDefrag(tArena_t *ar)
+{
+    pBlockHead blk, next, dst;
+    unsigned int size, c;
+
+    /* 检查堆是否已被初始化 */
+    if (ar->pEnd == NULL)
+        return;
+
+    /* 清空空闲链表，整理过程中重建 */
+    for (c = 0; c < tMEM_CLASS_NUM; c++)
+        ar->FreeList[c] = NULL;
+    ar->FreeMap = 0;
+
+    /* dst为下一个已分配块应放置的位置，dst与blk之间均为空闲空间 */
+    for (blk = dst = ar->pStart; blk != ar->pEnd; blk = next)
+    {
+        size = BLK_SIZE(blk);
+        next = BLK_NEXT(blk);
+
+        /* 空闲块并入前方空闲空间 */
+        if (!BLK_IS_USED(blk))
+            continue;
+
+        if (blk->SizeFlag & BLK_MOVABLE)
+        {
+            /* 滑动到空闲空间起始处并修正引用，前一块必为已分配块 */
+            if (dst != blk)
+            {
+                memmove(dst, blk, size);
+                *BLK_MOV_REF(dst) = (unsigned char*)dst + BLK_HDR_SIZE + MOV_SLOT_SIZE;
+            }
+            dst->SizeFlag |= BLK_PREV_USED;
+        }
+        else
+        {
+            /* 不可移动块前方的空闲空间成为一个空闲块 */
+            if (dst != blk)
+            {
+                dst->SizeFlag = (unsigned int)((unsigned char*)blk - (unsigned char*)dst) | BLK_PREV_USED;
+                tInsertFree(ar, dst);
+                blk->SizeFlag &= ~BLK_PREV_USED;
+            }
+            else
+            {
+                blk->SizeFlag |= BLK_PREV_USED;
+            }
+            dst = blk;
+        }
+        dst = (pBlockHead)((unsigned char*)dst + size);
+    }
+
+    /* 堆尾剩余的空闲空间 */
+    if (dst != ar->pEnd)
+    {
+        dst->SizeFlag = (unsigned int)((unsigned char*)ar->pEnd - (unsigned char*)dst) | BLK_PREV_USED;
+        tInsertFree(ar, dst);
+        ar->pEnd->SizeFlag &= ~BLK_PREV_USED;
+    }
+    else
+    {
+        ar->pEnd->SizeFlag |= BLK_PREV_USED;
+    }
+}
+
 /**********************************************************************
  * 函数名称： defragMemory
- * 功能描述： 内存碎片整理
+ * 功能描述： 内存碎片整理，整理本线程私有分区，未绑定时整理公共分区
  * 输入参数： 无
  * 输出参数： 无
  * 返 回 值： 无
@@ -454,5 +1028,74 @@ unsigned char CalcMemUsgRtLikely(void *mem)
  ***********************************************************************/
 void defragMemory(void)
 {
+    tArena_t *ar = CurArena ? CurArena : &GlobalArena;
+
+    tArenaLock(ar);
+    tDefrag(ar);
+    tArenaUnlock(ar);
+}
+#endif
+
+/**********************************************************************
+ * 函数名称： tPoolInit
+ * 功能描述： 初始化定长对象池，将所有对象串联到空闲链表
+ * 输入参数： pool 对象池 mem 对象空间（由tPOOL_MEM_DEFINE定义）
+ *            objSize 对象大小 num 对象数目
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+void tPoolInit(tPool_t *pool, void *mem, unsigned int objSize, unsigned int num)
+{
+    unsigned char *p;
+
+    pool->pBase = (unsigned char *)mem;
+    pool->ObjSize = tPOOL_OBJ_SIZE(objSize);
+    pool->Capacity = num;
+    pool->Used = 0;
+    pool->pFree = NULL;
 
-}
\ No newline at end of file
+    /* 逆序串联，使分配按地址递增进行 */
+    for (p = pool->pBase + (num * pool->ObjSize); p > pool->pBase; )
+    {
+        p -= pool->ObjSize;
+        *(void **)p = pool->pFree;
+        pool->pFree = p;
+    }
+}
+
+/**********************************************************************
+ * 函数名称： tPoolAlloc
+ * 功能描述： 从对象池分配一个对象，对象池耗尽时返回NULL，不会退化为malloc
+ * 输入参数： pool 对象池
+ * 输出参数： 无
+ * 返 回 值： 对象句柄
+ ***********************************************************************/
+void * tPoolAlloc(tPool_t *pool)
+{
+    void *obj = pool->pFree;
+
+    if (NULL == obj)
+        return NULL;
+    pool->pFree = *(void **)obj;
+    pool->Used ++;
+    return obj;
+}
+
+/**********************************************************************
+ * 函数名称： tPoolFree
+ * 功能描述： 将对象归还对象池，不属于该对象池的句柄直接忽略
+ * 输入参数： pool 对象池 obj 对象句柄
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+void tPoolFree(tPool_t *pool, void *obj)
+{
+    unsigned char *p = (unsigned char *)obj;
+
+    if ((NULL == p) || (p < pool->pBase) || (p >= pool->pBase + pool->Capacity * pool->ObjSize) ||
+        (0 != (unsigned int)(p - pool->pBase) % pool->ObjSize))
+        return;
+    *(void **)p = pool->pFree;
+    pool->pFree = p;
+    pool->Used --;
+}
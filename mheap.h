@@ -10,10 +10,93 @@
 /* 全局静态堆大小 */
 #define tMEM_SIZETOALLOC (1024)
 
-/* 支持内存碎片整理 */
+/* 支持内存碎片整理，对象须以tAllocMovable分配并登记引用才可被移动 */
 #define tMEM_DFGMENTATION 0
 
+/* 静态堆不足时由系统malloc分配，实时系统中应关闭以保证分配耗时确定 */
+#define tMEM_MALLOC_FALLBACK 1
+
+/* 分配耗时统计所用的计时源，如DWT->CYCCNT，定义为0时不统计耗时 */
+#define tMEM_TICK() 0
+
+/* 空闲链表分级数目，第n级中的块大小在[2^n, 2^(n+1))之间 */
+#define tMEM_CLASS_NUM 32
+
+/* 堆统计信息 */
+typedef struct
+{
+    unsigned int HeapSize;                      /* 可用堆大小 */
+    unsigned int LiveBytes;                     /* 已分配块占用字节数（含块头） */
+    unsigned int LiveObjs;                      /* 已分配对象数 */
+    unsigned int PeakBytes;                     /* 已分配字节数峰值 */
+    unsigned int FreeBytes;                     /* 空闲字节数 */
+    unsigned int FreeBlocks;                    /* 空闲块数目 */
+    unsigned int LargestFree;                   /* 最大空闲块大小，不含块头即为可一次分配的最大空间 */
+    unsigned int FragPercent;                   /* 碎片率，1 - 最大空闲块/空闲字节数，百分比 */
+    unsigned int AllocCnt;                      /* 静态堆分配成功次数 */
+    unsigned int FreeCnt;                       /* 静态堆释放次数 */
+    unsigned int FailCnt;                       /* 静态堆分配失败次数 */
+    unsigned int MallocFallback;                /* 退化为malloc分配的次数 */
+    unsigned int AllocTicksMax;                 /* 单次分配最大耗时 */
+    unsigned int AllocTicksTotal;               /* 分配累计耗时 */
+    unsigned int ClassAlloc[tMEM_CLASS_NUM];    /* 各级别分配次数 */
+    unsigned int ClassFree[tMEM_CLASS_NUM];     /* 各级别当前空闲块数目 */
+}tMemStats_t;
+
+/* 线程局部存储修饰符，用于记录线程绑定的私有分区，不支持线程局部存储的单线程系统可定义为空 */
+#define tMEM_THREAD_LOCAL __thread
+
+/* 堆分区，全局静态堆为所有线程共用的公共分区，访问时加锁；
+ * 线程可用静态内存区域建立私有分区并绑定，分配无需加锁，其他线程释放的对象经无锁释放栈归还 */
+typedef struct stARENA
+{
+    struct stBLOCKHEAD *FreeList[tMEM_CLASS_NUM];   /* 各级空闲链表 */
+    unsigned int FreeMap;                           /* 非空链表位图 */
+    struct stBLOCKHEAD *pStart;                     /* 首块 */
+    struct stBLOCKHEAD *pEnd;                       /* 尾部哨兵块（大小为0，标记为已分配） */
+    unsigned char *pMem;                            /* 分区内存区域 */
+    unsigned int MemSize;                           /* 分区内存区域大小 */
+    int maxRemainingSize;                           /* 空闲字节数（含空闲块块头） */
+    int ObjAllocated;                               /* 已分配对象数 */
+    void *pRemoteFree;                              /* 其他线程释放的对象，无锁栈 */
+    volatile int Lock;                              /* 公共分区锁 */
+    tMemStats_t Stats;                              /* 运行统计 */
+    struct stARENA *pNext;                          /* 已注册分区链表 */
+}tArena_t;
+
+/* 定长对象池，对象空间由调用者在编译期静态提供，空闲对象以侵入式单链表串联，分配释放均为常数时间 */
+typedef struct
+{
+    void *pFree;                /* 空闲对象链表头，空闲对象首字存放下一空闲对象地址 */
+    unsigned char *pBase;       /* 对象空间首地址 */
+    unsigned int ObjSize;       /* 对象大小（已对齐） */
+    unsigned int Capacity;      /* 对象总数 */
+    unsigned int Used;          /* 已分配对象数 */
+}tPool_t;
+
+/* 对象池中单个对象占用的空间，至少能存放一个指针并按指针大小对齐 */
+#define tPOOL_OBJ_SIZE(size) ((((size) < sizeof(void *) ? sizeof(void *) : (size)) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+/* 定义对象池的静态对象空间 */
+#define tPOOL_MEM_DEFINE(name, type, num) \
+    static unsigned char name[(num) * tPOOL_OBJ_SIZE(sizeof(type))] __attribute__((aligned(sizeof(void *))))
+
 extern void * tAllocHeapforeach(unsigned int sizeToAlloc);
 extern void tFreeHeapforeach(void* tObj);
+extern void * tRealloc(void *tObj, size_t size);
+extern int tReallocInPlace(void *tObj, size_t size);
 extern unsigned char CalcMemUsgRtLikely(void *mem);
+extern void tMemGetStats(tMemStats_t *st);
+extern void tMemDumpStats(void);
+extern int tArenaInit(tArena_t *ar, void *mem, unsigned int size);
+extern void tArenaBind(tArena_t *ar);
+extern void tArenaGetStats(tArena_t *ar, tMemStats_t *st);
+extern void tPoolInit(tPool_t *pool, void *mem, unsigned int objSize, unsigned int num);
+extern void * tPoolAlloc(tPool_t *pool);
+extern void tPoolFree(tPool_t *pool, void *obj);
+#if tMEM_DFGMENTATION
+extern void * tAllocMovable(void **ref, unsigned int sizeToAlloc);
+extern void tFreeMovable(void **ref);
+extern void defragMemory(void);
+#endif
 #endif
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "ycfat_config.h"
 #include "mheap.h"
 #include "list.h"
+#include <string.h>
 
 typedef unsigned char   J_UINT8;
 typedef unsigned short  J_UINT16;
@@ -24,9 +25,6 @@ typedef enum
 
 static unsigned int emp_clu = 0;
 
-/* 定义首目录簇开始扇区 */
-static unsigned int FirstDirSector = 0;
-
 /* 定义FAT32扇区大小，固定为512Byte */
 #define PER_SECSIZE 512
 
@@ -34,16 +32,22 @@ static unsigned int FirstDirSector = 0;
 #define ROOT_CLUS   2
 
 /* FAT32中文件目录项DFT（文件属性）中起始簇偏移+2 */
-#define START_SECTOR_OF_FILE(clu) (((clu-2)*32)+FirstDirSector)
+#define START_SECTOR_OF_FILE(v,clu) ((((clu)-2)*(v)->dbr.secPerClus)+(v)->args.FirstDirSector)
 
 /* 检查文件信息中的文件属性字段 */
 #define CHECK_FDI_ATTR(x) x->attribute
 
-/* 是否为文件末尾 */
-#define IS_EOF(clu) (clu == 0x0fffffff)
+/* 是否为文件末尾，FAT32簇号高4位保留，0x0ffffff8及以上均为结束标记 */
+#define IS_EOF(clu) (((clu) & 0x0fffffff) >= 0x0ffffff8)
 
 #define ARGVS_ERROR -99
 
+/* 簇链结束标记 */
+#define CLU_EOC 0x0fffffff
+
+/* 长文件名别名数字尾最大值，如NAME~999 */
+#define YC_ALIAS_TAIL_MAX 999
+
 /* 文件名不允许的字符：
 反斜杠 ()：在FAT32中，反斜杠用作目录分隔符，因此不能在文件名中使用。
 正斜杠 (/)：与反斜杠一样，正斜杠也被用作目录分隔符，不能在文件名中使用。
@@ -56,20 +60,28 @@ static unsigned int FirstDirSector = 0;
 分号 (;)：分号也不允许在文件名中使用。
 逗号 (,)：逗号也被禁止在文件名中。*/
 /* 对于其他特殊字符，某些操作系统或应用程序可能对这些字符有特殊处理，请谨慎使用 */
+/* 长文件名中允许使用空格、分号和逗号 */
+#if YC_LFN_ON
+#define IS_FN_EXTRA_ILLEGAL(c) 0
+#else
+#define IS_FN_EXTRA_ILLEGAL(c) (((c) == ';') || ((c) == ',') || ((c) == ' '))
+#endif
+
 /* 文件名是否合规 */
 #define IS_FILENAME_ILLEGAL(fn) \
 ({ \
     J_UINT8 isIllegal = 1; \
-    while (*fn) \
+    const char *p_fn = (const char *)(fn); \
+    while (*p_fn) \
     { \
-        if ((*fn == '\\') || (*fn == '/') || (*fn == ':') || (*fn == '*') || \
-            (*fn == '?') || (*fn == '"') || (*fn == '<') || (*fn == '>') || \
-            (*fn == '|') || (*fn == ';') || (*fn == ',') || (*fn == ' ')) \
+        if ((*p_fn == '\\') || (*p_fn == '/') || (*p_fn == ':') || (*p_fn == '*') || \
+            (*p_fn == '?') || (*p_fn == '"') || (*p_fn == '<') || (*p_fn == '>') || \
+            (*p_fn == '|') || IS_FN_EXTRA_ILLEGAL(*p_fn)) \
         { \
             isIllegal = 0; \
             break; \
         } \
-        fn++; \
+        p_fn++; \
     } \
     isIllegal; \
 })
@@ -82,11 +94,11 @@ struct FatInitArgs {
    
     unsigned int FreeClusNum;     /* 剩余空簇数目 */
     unsigned int NextFreeClu;     /* 下一个空簇 */
+    unsigned int ClusEnd;         /* 数据区簇号上界（不含），FAT表尾部的填充项不对应实际的簇 */
 };
-struct FatInitArgs FatInitArgs_a[4];
 
 /* 由簇号锚定其所在FAT表扇区 */
-#define CLU_TO_FATSEC(clu) ((clu * FAT_SIZE / PER_SECSIZE) + FatInitArgs_a[0].FAT1Sec)
+#define CLU_TO_FATSEC(v,clu) (((clu) * FAT_SIZE / PER_SECSIZE) + (v)->args.FAT1Sec)
 
 /* 定义分区属性，16Byte */
 typedef struct DiskPartitionTable
@@ -198,48 +210,330 @@ typedef struct FileDirectoryItem
     J_UINT8 fileSize[4];        /* 文件大小（字节） */
 }FDI_t;
 
+/* 长文件名目录项，与FDI_t同为32Byte，位于对应短文件名目录项之前且逆序存放 */
+typedef struct LongFileNameItem
+{
+    J_UINT8 ord;            /* 序号，最后一项（最先存放）与0x40相或 */
+    J_UINT8 name1[10];      /* 第1-5个UTF-16字符 */
+    J_UINT8 attribute;      /* 属性，固定为0x0F */
+    J_UINT8 type;           /* 类型，固定为0 */
+    J_UINT8 chksum;         /* 短文件名校验和 */
+    J_UINT8 name2[12];      /* 第6-11个UTF-16字符 */
+    J_UINT8 fstClus[2];     /* 固定为0 */
+    J_UINT8 name3[4];       /* 第12-13个UTF-16字符 */
+}LFN_t;
+
+/* 每个长文件名目录项存放的字符数 */
+#define LFN_CHARS_PER_ITEM 13
+#define LFN_LAST_ORD 0x40
+#define LFN_ORD_MASK 0x3F
+
 /* 一个扇区内的FDI */
 typedef struct FDIInOneSec
 {
     FDI_t fdi[PER_SECSIZE/sizeof(FDI_t)];
 }FDIs_t;
 
-/* 全局MBR DBR */
-MBR_t g_mbr;DBR_t g_dbr[4];
-static unsigned char g_dbr_n = 0;
+/* 块设备操作，由用户按存储介质（SD卡、镜像文件等）实现，ctx为设备私有数据，SecNum为扇区数（不是字节数） */
+typedef struct BlockDevice
+{
+    void *ctx;
+    void (*read)(void *ctx,void *buffer,unsigned int SecIndex,unsigned int SecNum);
+    void (*write)(void *ctx,void *buffer,unsigned int SecIndex,unsigned int SecNum);
+    /* 可选：连续扇区清零（如擦除或TRIM后读出为零的介质），为NULL时以零扇区写入代替 */
+    void (*zero)(void *ctx,unsigned int SecIndex,unsigned int SecNum);
+}blk_dev_t;
+
+/* ------------------------------------------ */
+/*                   locks                    */
+/* ------------------------------------------ */
+
+/* 锁模式由YC_LOCK_MODE在编译期选择，YC_LOCK_TRY模式下加锁失败返回该错误码 */
+#define YC_LOCK_BUSY -20
+
+/* 互斥锁，0空闲 1占用 */
+typedef struct
+{
+    volatile int v;
+}yc_lock_t;
+
+/* 读写锁，低位为读者数目，YC_RW_WRITER为写者占用，YC_RW_WAIT为有写者等待 */
+/* 写者优先：有写者等待时新读者不再进入，持续的读者不会使写者饿死 */
+typedef struct
+{
+    volatile int v;
+}yc_rwlock_t;
+
+#define YC_RW_WRITER 0x40000000
+#define YC_RW_WAIT   0x20000000
+
+/* 锁等待期间让出CPU，由用户对接操作系统 */
+extern void YC_OS_Yield(void);
+
+#if (YC_LOCK_MODE == YC_LOCK_BLOCK)
+#define YC_LOCK_WAIT() YC_OS_Yield()
+#else
+#define YC_LOCK_WAIT()
+#endif
+
+/* 加锁，仅YC_LOCK_TRY模式下可能失败返回0 */
+static J_UINT8 YC_Lock(yc_lock_t *l)
+{
+#if (YC_LOCK_MODE != YC_LOCK_NONE)
+    while(__atomic_exchange_n(&l->v,1,__ATOMIC_ACQUIRE))
+    {
+#if (YC_LOCK_MODE == YC_LOCK_TRY)
+        return 0;
+#endif
+        YC_LOCK_WAIT();
+    }
+#else
+    (void)l;
+#endif
+    return 1;
+}
+
+/* 加锁，不受YC_LOCK_TRY模式影响，用于临界区很短或无法返回错误的场合 */
+static void YC_LockWait(yc_lock_t *l)
+{
+#if (YC_LOCK_MODE != YC_LOCK_NONE)
+    while(__atomic_exchange_n(&l->v,1,__ATOMIC_ACQUIRE))
+        YC_LOCK_WAIT();
+#else
+    (void)l;
+#endif
+}
+
+static void YC_Unlock(yc_lock_t *l)
+{
+#if (YC_LOCK_MODE != YC_LOCK_NONE)
+    __atomic_store_n(&l->v,0,__ATOMIC_RELEASE);
+#else
+    (void)l;
+#endif
+}
+
+/* 加读锁，多个读者可同时持有，写者占用或等待时不进入 */
+static J_UINT8 YC_ReadLock(yc_rwlock_t *l)
+{
+#if (YC_LOCK_MODE != YC_LOCK_NONE)
+    int v;
+    for( ; ; )
+    {
+        v = __atomic_load_n(&l->v,__ATOMIC_RELAXED);
+        if(!(v & (YC_RW_WRITER | YC_RW_WAIT)) && __atomic_compare_exchange_n(&l->v,&v,v + 1,0,__ATOMIC_ACQUIRE,__ATOMIC_RELAXED))
+            break;
+#if (YC_LOCK_MODE == YC_LOCK_TRY)
+        /* 与其他读者竞争失败时重试，写者占用或等待时返回 */
+        if(v & (YC_RW_WRITER | YC_RW_WAIT)) return 0;
+#else
+        YC_LOCK_WAIT();
+#endif
+    }
+#else
+    (void)l;
+#endif
+    return 1;
+}
+
+/* 加读锁，不受YC_LOCK_TRY模式影响 */
+static void YC_ReadLockWait(yc_rwlock_t *l)
+{
+#if (YC_LOCK_MODE != YC_LOCK_NONE)
+    int v;
+    for( ; ; )
+    {
+        v = __atomic_load_n(&l->v,__ATOMIC_RELAXED);
+        if(!(v & (YC_RW_WRITER | YC_RW_WAIT)) && __atomic_compare_exchange_n(&l->v,&v,v + 1,0,__ATOMIC_ACQUIRE,__ATOMIC_RELAXED))
+            break;
+        YC_LOCK_WAIT();
+    }
+#else
+    (void)l;
+#endif
+}
+
+static void YC_ReadUnlock(yc_rwlock_t *l)
+{
+#if (YC_LOCK_MODE != YC_LOCK_NONE)
+    __atomic_fetch_sub(&l->v,1,__ATOMIC_RELEASE);
+#else
+    (void)l;
+#endif
+}
+
+#if (YC_LOCK_MODE != YC_LOCK_NONE)
+/* 等待读者及写者全部退出后占用，等待期间置YC_RW_WAIT阻止新读者进入 */
+/* 多个写者等待时由最先得到锁的写者清除YC_RW_WAIT，其余写者下次循环重新置位 */
+static void YC_WriteLockSlow(yc_rwlock_t *l)
+{
+    int v;
+    for( ; ; )
+    {
+        v = __atomic_load_n(&l->v,__ATOMIC_RELAXED);
+        if(!(v & ~YC_RW_WAIT))
+        {
+            if(__atomic_compare_exchange_n(&l->v,&v,YC_RW_WRITER,0,__ATOMIC_ACQUIRE,__ATOMIC_RELAXED))
+                return;
+            continue;
+        }
+        if(!(v & YC_RW_WAIT))
+            __atomic_fetch_or(&l->v,YC_RW_WAIT,__ATOMIC_RELAXED);
+        YC_LOCK_WAIT();
+    }
+}
+#endif
+
+/* 加写锁，与所有读者及其他写者互斥 */
+/* YC_LOCK_TRY模式下只尝试一次，不置等待标志，以免放弃后阻塞读者 */
+static J_UINT8 YC_WriteLock(yc_rwlock_t *l)
+{
+#if (YC_LOCK_MODE == YC_LOCK_TRY)
+    int v = __atomic_load_n(&l->v,__ATOMIC_RELAXED);
+    if((v & ~YC_RW_WAIT) || !__atomic_compare_exchange_n(&l->v,&v,YC_RW_WRITER | (v & YC_RW_WAIT),0,__ATOMIC_ACQUIRE,__ATOMIC_RELAXED))
+        return 0;
+#elif (YC_LOCK_MODE != YC_LOCK_NONE)
+    YC_WriteLockSlow(l);
+#else
+    (void)l;
+#endif
+    return 1;
+}
+
+/* 加写锁，不受YC_LOCK_TRY模式影响 */
+static void YC_WriteLockWait(yc_rwlock_t *l)
+{
+#if (YC_LOCK_MODE != YC_LOCK_NONE)
+    YC_WriteLockSlow(l);
+#else
+    (void)l;
+#endif
+}
+
+/* 释放写锁，保留其他写者置的等待标志 */
+static void YC_WriteUnlock(yc_rwlock_t *l)
+{
+#if (YC_LOCK_MODE != YC_LOCK_NONE)
+    __atomic_fetch_and(&l->v,~YC_RW_WRITER,__ATOMIC_RELEASE);
+#else
+    (void)l;
+#endif
+}
+
+/* 加锁顺序：复制缓冲锁 -> 文件锁 -> 节点追加锁 -> 卷读写锁 -> 目录提示锁/FAT缓存分片锁/堆锁，反序加锁会导致死锁 */
+
+/* 目录项位置，簇内扇区偏移及扇区内目录项偏移 */
+typedef struct
+{
+    unsigned int clu;       /* 目录项所在簇 */
+    J_UINT8 sec;            /* 簇内扇区偏移 */
+    J_UINT8 idx;            /* 扇区内目录项偏移 */
+}fdi_loc_t;
+
+struct Volume;
 
 typedef enum{
     FILE_CLOSE,
     FILE_OPEN
 }FILE_STATE;
 
-/* 文件句柄 */
+/* 连续簇段 */
+typedef struct
+{
+    unsigned int s_clu;    /* 头簇 */
+    unsigned int e_clu;    /* 尾簇 */
+}yc_run_t;
+
+/* 打开文件共享节点，同一文件的所有句柄共用一个节点，以目录项位置为键 */
+/* 文件大小、簇链及预留簇只在节点中维护，追加写持有节点追加锁并在卷写锁下修改，所有句柄看到一致的文件大小 */
+typedef struct fileNode
+{
+    /* 文件所在卷，为NULL表示节点空闲 */
+    struct Volume *vol;
+    fdi_loc_t dir_loc;              /* 文件目录项位置，追加写时回写文件大小 */
+    unsigned int FirstClu;
+    /* 文件大小 */
+    unsigned int fl_sz;
+    /* 文件末簇 */
+    unsigned int EndClu;
+    /* 文件末簇未写大小 */
+    unsigned int EndCluLeftSize;
+    /* 打开此文件的句柄数 */
+    unsigned int ref;
+    yc_run_t RsvRun[YC_RSV_RUN_NUM];/* 内联预留簇段，优先使用 */
+    unsigned char RsvRunHead;       /* 下一个可取的内联簇段 */
+    unsigned char RsvRunNum;        /* 内联簇段数目 */
+    struct list_head WRCluChainList;/* 内联簇段用完后溢出的预留簇链缓冲头节点，不携带实际数据 */
+    struct list_head RsvNode;       /* 持有预留簇时挂在卷的预留文件链表上 */
+    yc_lock_t wr_lock;              /* 追加写锁，同一文件各句柄的追加、扩展及复制互斥 */
+}yc_fnode_t;
+
+/* 用户态缓冲模式，由setvbuf设置 */
+#define YC_IOFBF 0      /* 全缓冲：缓冲满时读写设备 */
+#define YC_IOLBF 1      /* 行缓冲：写入数据含换行符时写出 */
+#define YC_IONBF 2      /* 无缓冲 */
+
+/* 打开标志，由YC_FAT_fopenEx传入 */
+#define YC_O_DIRECT 0x01    /* 直接I/O：数据在用户缓冲与设备之间直接传输，不经用户态缓冲及扇区缓冲，读写位置及长度须扇区对齐 */
+
+/* 文件句柄，只记录本句柄的读位置，文件信息在共享节点中 */
 typedef struct fileHandler
 {
-     /* 文件描述符 */
+     /* 文件描述符，由打开文件表分配 */
     unsigned int fd;
     unsigned int FirstClu;
     /* 数据锚定（读） */
     unsigned int CurClus;   /* 当前簇 */
     short CurOffSec;    /* 当前簇内偏移扇区 */
     unsigned short CurOffByte;  /* 当前扇区内偏移字节 */
-    /* 文件大小 */
+    /* 文件大小，读取前由共享节点同步 */
     unsigned int fl_sz;
     /* 剩余大小 */
     unsigned int left_sz;
     /* 文件状态 */
     FILE_STATE file_state;
+    /* 打开标志 */
+    J_UINT8 flags;
 #if YC_FILE2MEM
-    int (*load2memory)(FILE *,void *mem_base,int);/* 文件是否加载至内存操作 */
-    int (*Writeback)(FILE *,void *mem_base,int);/* 文件回写 */
+    int (*load2memory)(struct fileHandler *,void *mem_base,unsigned int off,unsigned int len);/* 将文件窗口加载至内存 */
+    int (*Writeback)(struct fileHandler *);/* 回写窗口中的脏扇区 */
+    unsigned char *pMem;    /* 文件窗口内存，为NULL表示未加载 */
+    unsigned int MemOff;    /* 窗口在文件中的偏移，扇区对齐 */
+    unsigned int MemLen;    /* 窗口长度 */
+    J_UINT32 *pDirty;       /* 脏扇区位图，每位对应窗口中的一个扇区 */
+    J_UINT8 MemOwn;         /* 窗口内存由库分配，卸载时释放 */
 #endif
-    struct list_head WRCluChainList;/* 簇链缓冲头节点，不携带实际数据 */
-    /* 文件末簇 */
-    unsigned int EndClu;
-    /* 文件末簇未写大小 */
-    unsigned int EndCluLeftSize;
+    /* 用户态缓冲，同一时刻只用于读或写 */
+    unsigned char *pBuf;    /* 缓冲区 */
+    unsigned int BufSize;   /* 缓冲区大小 */
+    unsigned int BufPos;    /* 读：下一个未读字节；写：已积累的字节数 */
+    unsigned int BufLen;    /* 读：缓冲中的有效数据长度 */
+    J_UINT8 BufMode;        /* YC_IOFBF/YC_IOLBF/YC_IONBF */
+    J_UINT8 BufWr;          /* 缓冲当前用于积累写数据 */
+    /* 共享节点 */
+    yc_fnode_t *node;
+    /* 文件所在卷 */
+    struct Volume *vol;
+    /* 句柄锁，保护读写位置等句柄状态 */
+    yc_lock_t lock;
 }FILE;
 
+/* 分散/聚集读写的数据段 */
+typedef struct
+{
+    void *iov_base;
+    unsigned int iov_len;
+}yc_iovec_t;
+
+/* 打开文件表：共享节点及描述符位图，由oft_lock保护 */
+static yc_fnode_t yc_fnodes[YC_OPEN_FILE_NUM];
+static J_UINT32 yc_fd_map[(YC_OPEN_FILE_NUM + 31)/32];
+static FILE *yc_fd_tab[YC_OPEN_FILE_NUM];
+static yc_lock_t oft_lock;
+
+/* setvbuf未指定缓冲区时各描述符使用的静态缓冲，不依赖堆 */
+static unsigned char yc_fd_buf[YC_OPEN_FILE_NUM][YC_FILE_BUF_SIZE];
+
 typedef struct WRCluChainBuffer
 {
     struct list_head WRCluChainNode;
@@ -247,976 +541,2988 @@ typedef struct WRCluChainBuffer
     unsigned int w_e_clu;    /* 尾簇 */
 }w_buffer_t; 
 
-// bit map for FAT table
-/* 只定义一个位图，不支持多磁盘分区 */
-/* FAT进行位图映射时，直接将FAT值和0做逻辑或运算 */
-uint8_t clusterBitmap[(PER_SECSIZE/FAT_SIZE)/8];//16Bytes
-static unsigned int cur_fat_sec;
+/* 目录项时间戳 */
+typedef struct
+{
+    J_UINT16 yy;J_UINT8 mm;J_UINT8 dd;
+    J_UINT8 hour;J_UINT8 min;J_UINT8 sec;
+}fl_time_t;
 
-/* 当前所在目录 */
-char pwd[4][50] = {0};
-pwd[0][0] = pwd[1][0] = pwd[2][0] = pwd[3][0] = '/'; 
-static unsigned int work_clu[4] = {2,2,2,2};
+#if YC_LFN_ON
+/* 长文件名收集状态，目录项按顺序逐项送入，可跨扇区、跨簇 */
+typedef struct
+{
+    J_UINT16 name[YC_LFN_MAXLEN + 1];   /* UTF-16长文件名 */
+    J_UINT16 len;           /* 长文件名长度 */
+    J_UINT16 want_len;      /* 只收集该长度的长文件名，0表示全部收集 */
+    J_UINT8 chksum;         /* 长文件名目录项中记录的短文件名校验和 */
+    J_UINT8 next_ord;       /* 期望的下一个序号，0表示已收集完整 */
+    J_UINT8 active;         /* 正在收集 */
+    J_UINT8 skip;           /* 长度不匹配，只校验序号不拷贝字符 */
+}lfn_state_t;
+#endif
 
-void usr_read(void * buffer,unsigned int SecIndex,unsigned int SecNum){}
-void usr_write(void * buffer,unsigned int SecIndex,unsigned int SecNum){}
-/* 将Byte转化为数值 */
-unsigned int Byte2Value(unsigned char *data,unsigned char len)
+/* 解码后的目录项信息 */
+typedef struct DirEntryInfo
 {
-    if(len > 4) return 0;
+    char name[YC_NAME_MAXLEN + 1];  /* 文件名，有长文件名时为UTF-8长文件名，否则为8*3文件名 */
+    char sname[13];         /* 8*3文件名，最后一字节为'\0' */
+    J_UINT8 attribute;      /* 属性 */
+    unsigned int fl_sz;     /* 文件大小（字节） */
+    unsigned int FirstClu;  /* 起始簇 */
+    fl_time_t crt;          /* 创建日期时间 */
+    fl_time_t mod;          /* 最近修改日期时间 */
+    fl_time_t acs;          /* 最近访问日期 */
+}dirent_t;
+
+/* 通配符最大长度 */
+#define GLOB_PAT_MAXLEN 32
+
+/* 编译后的通配符，匹配前预先完成大写转换及前缀/扩展名提取 */
+typedef struct GlobPattern
+{
+    char pat[GLOB_PAT_MAXLEN];  /* 大写后的通配符，以'\0'结尾 */
+    J_UINT8 pre_len;            /* 文件名固定前缀长度 */
+    J_UINT8 pre[8];             /* 文件名固定前缀（或完整8字节文件名） */
+    J_UINT8 ext_fixed;          /* 扩展名是否固定 */
+    J_UINT8 ext[3];             /* 固定扩展名，空格补齐 */
+    J_UINT8 match_all;          /* *或*.*，匹配所有目录项 */
+    J_UINT8 never;              /* 通配符不可能匹配8*3文件名 */
+}glob_pat_t;
+
+/* 目录句柄，按扇区顺序流式读取目录项 */
+typedef struct dirHandler
+{
+    unsigned int FirstClu;  /* 目录首簇 */
+    unsigned int CurClus;   /* 当前簇 */
+    short CurOffSec;        /* 当前簇内偏移扇区 */
+    short CurOffFdi;        /* 当前扇区内目录项偏移 */
+    J_UINT8 SecLoaded;      /* 当前扇区是否已读入缓冲 */
+    J_UINT8 eod;            /* 是否已读到目录末尾 */
+    FILE_STATE dir_state;   /* 目录状态 */
+    struct Volume *vol;     /* 目录所在卷 */
+    FDIs_t fdis;            /* 当前扇区缓冲，每个目录扇区只读一次 */
+#if YC_LFN_ON
+    J_UINT8 lfn_ok;         /* 最近返回的目录项带有完整长文件名 */
+    lfn_state_t lfn;        /* 长文件名收集状态 */
+#endif
+}DIR;
 
-    unsigned int temp = 0;
-    if(len >= 1) temp|=((unsigned char)data[0]);
-    if(len >= 2) temp|=((unsigned char)data[1])<<8;
-    if(len >= 3) temp|=((unsigned char)data[2])<<16;
-    if(len >= 4) temp|=((unsigned char)data[3])<<24;
+/* 文件名哈希集合，开放寻址，只保存哈希值（0表示空槽），命中后由调用者精确确认 */
+typedef struct
+{
+    J_UINT32 *slot;         /* 哈希槽，数目为2的幂 */
+    unsigned int size;      /* 哈希槽数目 */
+    unsigned int cnt;       /* 已占用哈希槽数目 */
+    J_UINT8 full;           /* 超过装载上限且无法扩容，查询结果不再可信 */
+    J_UINT8 own;            /* 哈希槽为扩容时由堆分配，用完须释放 */
+}name_set_t;
+
+/* 目录扫描上下文，一次遍历同时完成查找、空闲目录项统计及别名序号收集 */
+typedef struct
+{
+    /* 输入 */
+    char *name;             /* 待查找的文件名，NULL表示不查找 */
+    name_set_t *set;        /* 收集目录中所有文件名的哈希，NULL表示不收集 */
+#if YC_LFN_ON
+    J_UINT8 *alias;         /* 别名基名（8*3格式11字节），NULL表示不收集 */
+    J_UINT8 alias_len;      /* 别名基名有效长度 */
+    J_UINT8 lfn_all;        /* 收集所有长文件名，不按长度过滤 */
+#endif
+    /* 输出 */
+    FDI_t fdi;              /* 匹配到的短文件名目录项 */
+    fdi_loc_t loc;          /* 匹配到的短文件名目录项位置 */
+    unsigned int tail_clu;  /* 目录末簇 */
+#if YC_LFN_ON
+    J_UINT8 lfn_ok;         /* 匹配到的目录项带有完整长文件名，保存在lfn中 */
+    J_UINT16 u16[YC_LFN_MAXLEN + 1];    /* 待查找文件名的UTF-16形式 */
+    J_UINT16 u16_len;
+    lfn_state_t lfn;
+    J_UINT8 tails[(YC_ALIAS_TAIL_MAX + 8)/8]; /* 已占用的别名序号位图 */
+#endif
+}dirscan_t;
 
-    return temp;
-}
+/* 目录空闲目录项提示，按目录首簇索引，插入目录项时增量更新 */
+typedef struct
+{
+    unsigned int dir_clu;   /* 目录首簇，0表示未使用 */
+    unsigned int tail_clu;  /* 目录末簇 */
+    fdi_loc_t end;          /* 第一个0x00目录项（目录结束标记）位置 */
+    J_UINT8 end_valid;      /* 目录末簇已写满（无0x00目录项）时为0 */
+    J_UINT8 e5_known;       /* first_e5是否有效 */
+    fdi_loc_t first_e5;     /* 第一个可复用的已删除目录项位置 */
+    unsigned int e5_cnt;    /* 可复用的已删除目录项数目 */
+    unsigned int age;       /* 最近使用时刻，用于替换 */
+}dir_hint_t;
+
+#if YC_FAT_CACHE_SHARDS
+/* FAT扇区缓存项 */
+typedef struct
+{
+    unsigned int sec;       /* FAT绝对扇区号，0表示空 */
+    unsigned int age;       /* 最近使用时刻，用于替换 */
+    J_UINT32 fat[PER_SECSIZE/FAT_SIZE];
+}fat_cache_ent_t;
 
-void YC_FAT_ReadDBR(DBR_t * dbr_n);
+/* FAT扇区缓存分片，扇区按扇区号取模分片，查找不同分片的读者互不阻塞 */
+typedef struct
+{
+    yc_lock_t lock;
+    unsigned int age;
+    fat_cache_ent_t ent[YC_FAT_CACHE_WAYS];
+}fat_cache_shard_t;
+#endif
 
-/* 解析绝对0扇区的MBR或DBR */
-void YC_FAT_AnalyseSec0(void)
+/* ------------------------------------------ */
+/*                  I/O统计                     */
+/* ------------------------------------------ */
+/* 统计的公共接口，嵌套调用（如复制文件时打开文件、glob时打开目录）的调用次数及I/O只计入最外层接口 */
+/* closedir、rewinddir、MemDirty只修改内存中的状态，不访问设备，不计入统计 */
+typedef enum
+{
+    YC_OP_MOUNT = 0,    /* 挂载、卸载 */
+    YC_OP_FOPEN,
+    YC_OP_FCLOSE,
+    YC_OP_FREAD,    /* fread、readv */
+    YC_OP_FWRITE,   /* YC_FAT_fwrite、writev、YC_WriteDataNoCheck、fflush、setvbuf */
+    YC_OP_CD,
+    YC_OP_DIR,      /* opendir、readdir、readdir_glob、stat、glob */
+    YC_OP_CREATE,   /* 创建文件、批量创建文件 */
+    YC_OP_MKDIR,
+    YC_OP_COPY,
+    YC_OP_EXTEND,
+    YC_OP_MAP,      /* load2memory、Writeback */
+    YC_OP_NUM,
+    YC_OP_NONE = YC_OP_NUM
+}yc_op_t;
+
+/* 统计项 */
+typedef enum
 {
-    MBR_t * mbr = (MBR_t *)&g_mbr;
+    YC_ST_CALLS = 0,    /* 调用次数 */
+    YC_ST_SEC_RD,       /* 读扇区数 */
+    YC_ST_SEC_WR,       /* 写扇区数（含设备清零） */
+    YC_ST_DEV_CMD,      /* 设备命令数 */
+    YC_ST_CACHE_HIT,    /* FAT扇区缓存命中 */
+    YC_ST_CACHE_MISS,   /* FAT扇区缓存未命中 */
+    YC_ST_FAT_SEC,      /* 读写的FAT扇区数 */
+    YC_ST_DIR_SEC,      /* 扫描的目录扇区数 */
+    YC_ST_BYTES_RD,     /* 读出的文件数据字节数 */
+    YC_ST_BYTES_WR,     /* 写入的文件数据字节数 */
+    YC_ST_NUM
+}yc_stat_id_t;
+
+typedef struct
+{
+    unsigned long long v[YC_ST_NUM];
+}yc_io_stat_t;
 
-    unsigned char buffer[PER_SECSIZE];
+/* 卷（已挂载的FAT32分区），持有分区几何参数、空闲簇状态、目录提示及当前目录 */
+/* 每个分区或镜像对应一个卷对象，由调用者提供，卷之间互不影响 */
+typedef struct Volume
+{
+    blk_dev_t dev;          /* 块设备 */
+    J_UINT8 mounted;        /* 是否已挂载 */
+    J_UINT8 part;           /* 分区号（0~3），无MBR时为0 */
+    unsigned int partStartSec;  /* 分区起始扇区（DBR所在扇区） */
+    unsigned int FSInfoSec; /* FSINFO扇区 */
+    DBR_t dbr;              /* 分区DBR */
+    struct FatInitArgs args;/* FAT表、首目录扇区及空闲簇参数 */
+
+    // bit map for FAT table
+    /* FAT进行位图映射时，直接将FAT值和0做逻辑或运算 */
+    uint8_t clusterBitmap[(PER_SECSIZE/FAT_SIZE)/8];//16Bytes
+    unsigned int cur_fat_sec;
+
+    /* 当前所在目录 */
+    char pwd[YC_PATH_MAXLEN];
+    unsigned int work_clu;
+
+    /* 目录提示表 */
+    dir_hint_t dir_hints[YC_DIR_HINT_NUM];
+    unsigned int dir_hint_age;
+
+    /* 持有预留簇的文件，其他文件及目录分配簇时跳过这些簇 */
+    struct list_head rsv_list;
+    unsigned int RsvClusNum;    /* 已预留未使用的簇数目 */
+
+    /* 卷读写锁：查找、读文件加读锁，分配簇、修改FAT表及目录加写锁 */
+    yc_rwlock_t rw;
+    /* 目录提示锁，读者遍历目录时也会刷新目录提示 */
+    yc_lock_t hint_lock;
+#if YC_FAT_CACHE_SHARDS
+    /* FAT扇区缓存 */
+    fat_cache_shard_t fat_cache[YC_FAT_CACHE_SHARDS];
+#endif
+#if YC_STATS_ON
+    /* 本卷的I/O统计，各线程共同累加 */
+    yc_io_stat_t stat;
+#endif
+}VOL_t;
 
-    /* 读取绝对0扇区 */
-    usr_read(&buffer,0,PER_SECSIZE);
+/* 卷中可分配的空簇数目（不含其他文件已预留的簇） */
+#define VOL_FREE_CLU(v) ((v)->args.FreeClusNum - (v)->RsvClusNum)
 
-    /* 判断绝对0扇区是不是为MBR扇区 */
-    if((*buffer == 0xEB)&&(*(buffer+1) == 0x58)&&(*(buffer+2) == 0x90))
-    {
-        g_dbr_n = 0;
-    }
+/* ------------------------------------------ */
+/*                   跟踪                       */
+/* ------------------------------------------ */
+/* 单调时钟（纳秒），由用户在io.c中对接 */
+extern unsigned long long YC_OS_ClockNs(void);
 
-    /* 解析分区开始扇区和分区所占总扇区数 */
-    for(unsigned char i = 0;i < 4 ; i++)
-    {
-        if( 0 == (unsigned char *)(buffer+446+16*i+8) )
-            continue;
-        mbr->dpt[i].partStartSec = Byte2Value((unsigned char *)(buffer+446+16*i+8),4);
-        g_dbr_n ++;
-    }
+#if YC_TRACE_ON
+/* 跟踪事件 */
+typedef struct
+{
+    unsigned long long ts;  /* 时间戳（纳秒） */
+    const char *name;       /* 接口名或设备命令名 */
+    J_UINT32 seq;           /* 事件序号+1，写完后最后写入，导出时据此丢弃未写完或已被覆盖的事件 */
+    J_UINT32 arg0;          /* 设备命令：起始扇区 */
+    J_UINT32 arg1;          /* 设备命令：扇区数 */
+    J_UINT16 tid;           /* 线程号，从1开始 */
+    char ph;                /* 'B'开始 'E'结束 */
+}yc_trace_evt_t;
+
+/* 跟踪环形缓冲，写者以原子递增领取位置，满后覆盖最旧的事件，写入不加锁 */
+static yc_trace_evt_t yc_trace_buf[YC_TRACE_BUF_NUM];
+static J_UINT32 yc_trace_head;
+static J_UINT16 yc_trace_tids;
+static YC_THREAD_LOCAL J_UINT16 yc_trace_tid;
+static volatile J_UINT8 yc_trace_on = 1;
+static unsigned long long (*yc_trace_clock)(void) = YC_OS_ClockNs;
+
+/* 记录一个跟踪事件 */
+static void YC_TraceEvt(char ph,const char *name,unsigned int arg0,unsigned int arg1)
+{
+    yc_trace_evt_t *e;
+    J_UINT32 idx;
 
-    /* DBR初始化 */
-    if(!g_dbr_n)
-    {
-        YC_FAT_ReadDBR((DBR_t *)&g_dbr[0]);
-        /* 初始化系统参数 */
-        FatInitArgs_a[0].FAT1Sec = g_dbr[0].rsvdSecCnt; /* FAT1起始扇区等于保留扇区数 */
-        FatInitArgs_a[0].FirstDirSector = FatInitArgs_a[0].FAT1Sec\
-                            + (g_dbr[0].numFATs * g_dbr[0].FATSz32);
-    }else{
-        for(unsigned char i = 0;i<g_dbr_n;i++)
-        {
-            YC_FAT_ReadDBR((DBR_t *)&g_dbr[i]);
-            /* 初始化系统参数 */
-            FatInitArgs_a[i].FAT1Sec = g_mbr.dpt[i].partStartSec\
-                            + g_dbr[i].rsvdSecCnt;/* FAT1起始扇区等于DBR起始扇区保留扇区数 */
-            FatInitArgs_a[i].FirstDirSector = FatInitArgs_a[i].FAT1Sec\
-                             + (g_dbr[i].numFATs * g_dbr[i].FATSz32);
-        }
-    }
+    if(!yc_trace_on)
+        return;
+    if(0 == yc_trace_tid)
+        yc_trace_tid = __atomic_add_fetch(&yc_trace_tids,1,__ATOMIC_RELAXED);
+    idx = __atomic_fetch_add(&yc_trace_head,1,__ATOMIC_RELAXED);
+    e = &yc_trace_buf[idx % YC_TRACE_BUF_NUM];
+    __atomic_store_n(&e->seq,0,__ATOMIC_RELAXED);
+    e->ts = yc_trace_clock();
+    e->name = name;
+    e->arg0 = arg0;
+    e->arg1 = arg1;
+    e->tid = yc_trace_tid;
+    e->ph = ph;
+    __atomic_store_n(&e->seq,idx + 1,__ATOMIC_RELEASE);
 }
 
-/* 解析DBR */
-void YC_FAT_ReadDBR(DBR_t * dbr_n)
+static const char * YC_TraceEnter(const char *fn)
 {
-    DBR_t * dbr = dbr_n;
+    YC_TraceEvt('B',fn,0,0);
+    return fn;
+}
 
-    unsigned char buffer[PER_SECSIZE];
+static void YC_TraceLeave(const char **fn)
+{
+    YC_TraceEvt('E',*fn,0,0);
+}
 
-    /* 若没有MBR扇区，则读取绝对0扇区 */
-    if(0 == g_dbr_n)
-        usr_read((unsigned char *)buffer,0,PER_SECSIZE);
-    /* 读DBR所在扇区 */
-    else
-        usr_read((unsigned char *)buffer,g_mbr.dpt[0].partStartSec,PER_SECSIZE);
+/* 函数返回时自动记录结束事件 */
+#define YC_TRACE_SCOPE() const char *yc_trace_fn __attribute__((cleanup(YC_TraceLeave))) = YC_TraceEnter(__func__);
+#define YC_TRACE_IO(ph,name,sec,n) YC_TraceEvt((ph),(name),(sec),(n))
 
-    /* 解析buffer数据 */
-    dbr->bytsPerSec = Byte2Value((unsigned char *)(buffer+11),2); /* 每扇区大小，通常为512 */
-    dbr->secPerClus = Byte2Value((unsigned char *)(buffer+13),1); /* 每簇扇区数 */  
-    dbr->rsvdSecCnt = Byte2Value((unsigned char *)(buffer+14),2); /* 保留扇区数（DBR->FAT1）*/
-    dbr->numFATs = Byte2Value((unsigned char *)(buffer+16),1);  /* FAT表数，通常为2 */
-    dbr->totSec32 = Byte2Value((unsigned char *)(buffer+32),4); /* 总扇区数 */
-    dbr->FATSz32 = Byte2Value((unsigned char *)(buffer+36),4); /* 每个FAT的扇区数，FAT32专用 */
+/* 替换跟踪时钟，clk返回单调递增的纳秒数，为NULL时恢复YC_OS_ClockNs */
+void YC_FAT_TraceSetClock(unsigned long long (*clk)(void))
+{
+    yc_trace_clock = clk ? clk : YC_OS_ClockNs;
 }
 
-/* 解析字符串长度 */
-unsigned int YC_StrLen(char *str)
+/* 运行期开关跟踪 */
+void YC_FAT_TraceEnable(J_UINT8 on)
 {
-    char * p_str = str; unsigned int len = 0;
+    yc_trace_on = on;
+}
 
-    /* 当遍历到字符'\0'时停止 */
-    while( '\0' != (*p_str))
-    {
-        len ++; p_str ++;
-    }
-    return len;
+/* 丢弃已记录的事件 */
+void YC_FAT_TraceClear(void)
+{
+    unsigned int i;
+    for(i = 0; i < YC_TRACE_BUF_NUM; i ++)
+        __atomic_store_n(&yc_trace_buf[i].seq,0,__ATOMIC_RELAXED);
 }
 
-/* 文件名匹配，返回文件名长度 */
-unsigned char ycFilenameMatch(char *fileToMatch,char *fileName)
+/* 导出缓冲：拼接字符串及十进制数 */
+typedef struct
 {
-    unsigned char len1 = YC_StrLen(fileName);
-    unsigned char len2 = YC_StrLen(fileToMatch);
+    char s[160];
+    unsigned int len;
+}yc_trace_line_t;
 
-    if(len1 != len2) return 0;
-    unsigned char f_c = 0;
-    while( (*(fileToMatch + f_c) == *(fileName + f_c)) && ( f_c < len1) )
-    {
-        f_c ++;
-    }
-    if(f_c < (len1 - 1)) return 0;
-    return len1;
+static void YC_TraceCat(yc_trace_line_t *l,const char *str)
+{
+    while(*str && (l->len < sizeof(l->s)))
+        l->s[l->len ++] = *str ++;
 }
 
-#define EXTNAME_EMP(x) ((x[8] == ' ')&&(x[9] == ' ')&&(x[10] == ' '))
-
-/* 8*3文件名转化为字符串类型 */
-/* ycfat中规定文件名不含空格 */
-void FDI_FileNameToString(char *from, char *to)
+static void YC_TraceNum(yc_trace_line_t *l,unsigned long long v,unsigned int width)
 {
-    if((from == NULL) || (to == NULL))
-        return;
+    char d[20];
+    unsigned int n = 0;
+    do{
+        d[n ++] = '0' + v % 10;
+        v /= 10;
+    }while(v || (n < width));
+    while(n && (l->len < sizeof(l->s)))
+        l->s[l->len ++] = d[-- n];
+}
 
-    char *fn_fr = from;
-    char *fn_to = to;
-    unsigned char i = 0;
+/* 将环形缓冲中的事件按Chrome trace JSON格式逐段交给out输出（chrome://tracing、Perfetto可直接打开） */
+/* 导出期间写者可继续记录，被覆盖或未写完的事件跳过；out返回非0时中止，返回-1 */
+int YC_FAT_TraceDump(int (*out)(void *ctx,const char *s,unsigned int len),void *ctx)
+{
+    yc_trace_evt_t e;
+    yc_trace_line_t l;
+    J_UINT32 head = __atomic_load_n(&yc_trace_head,__ATOMIC_ACQUIRE);
+    J_UINT32 i = (head > YC_TRACE_BUF_NUM) ? (head - YC_TRACE_BUF_NUM) : 0;
+    J_UINT8 first = 1;
 
-    /* 提取文件名 */
-    while( ' ' != (*fn_fr))
+    if(out(ctx,"{\"traceEvents\":[\n",17))
+        return -1;
+    for( ; i != head; i ++)
     {
-        *(fn_to + i) = (* fn_fr);
-        if( 7 == i) break;
-        fn_fr ++; i ++;
-    }
+        yc_trace_evt_t *p = &yc_trace_buf[i % YC_TRACE_BUF_NUM];
+        if(__atomic_load_n(&p->seq,__ATOMIC_ACQUIRE) != i + 1)
+            continue;
+        e = *p;
+        if(__atomic_load_n(&p->seq,__ATOMIC_ACQUIRE) != i + 1)
+            continue;
 
-    if(EXTNAME_EMP(from))
-    {
-        *(fn_to + (++i) - 1) = '\0';
-        return;
+        l.len = 0;
+        YC_TraceCat(&l,first ? "{\"name\":\"" : ",\n{\"name\":\"");
+        YC_TraceCat(&l,e.name);
+        YC_TraceCat(&l,('B' == e.ph) ? "\",\"ph\":\"B\",\"ts\":" : "\",\"ph\":\"E\",\"ts\":");
+        /* 微秒，保留三位小数 */
+        YC_TraceNum(&l,e.ts/1000,1);
+        YC_TraceCat(&l,".");
+        YC_TraceNum(&l,e.ts%1000,3);
+        YC_TraceCat(&l,",\"pid\":1,\"tid\":");
+        YC_TraceNum(&l,e.tid,1);
+        if(e.arg1)
+        {
+            YC_TraceCat(&l,",\"args\":{\"sec\":");
+            YC_TraceNum(&l,e.arg0,1);
+            YC_TraceCat(&l,",\"n\":");
+            YC_TraceNum(&l,e.arg1,1);
+            YC_TraceCat(&l,"}");
+        }
+        YC_TraceCat(&l,"}");
+        if(out(ctx,l.s,l.len))
+            return -1;
+        first = 0;
     }
-    *(fn_to + (++i) - 1) = '.';
+    return out(ctx,"\n]}\n",4) ? -1 : 0;
+}
+#else
+#define YC_TRACE_SCOPE()
+#define YC_TRACE_IO(ph,name,sec,n) ((void)0)
+#endif
 
-    /* 提取扩展名 */
-    fn_fr = from + 8;
-    unsigned char j = 0;
-    while(' ' != (*fn_fr))
+#if YC_STATS_ON
+/* 各线程的统计槽，线程第一次统计时领取，超出YC_STATS_THREADS的线程共用最后一个槽 */
+static yc_io_stat_t yc_stat_slot[YC_STATS_THREADS][YC_OP_NUM];
+static int yc_stat_slots_used;
+static YC_THREAD_LOCAL int yc_stat_tid = -1;
+/* 本线程当前所在的公共接口 */
+static YC_THREAD_LOCAL J_UINT8 yc_cur_op = YC_OP_NONE;
+
+#if (YC_LOCK_MODE != YC_LOCK_NONE)
+#define YC_STAT_INC(p,n) __atomic_fetch_add((p),(n),__ATOMIC_RELAXED)
+#define YC_STAT_LOAD(p) __atomic_load_n((p),__ATOMIC_RELAXED)
+#define YC_STAT_CLR(p) __atomic_store_n((p),0,__ATOMIC_RELAXED)
+#else
+#define YC_STAT_INC(p,n) (*(p) += (n))
+#define YC_STAT_LOAD(p) (*(p))
+#define YC_STAT_CLR(p) (*(p) = 0)
+#endif
+
+/* 本线程的统计槽 */
+static yc_io_stat_t * YC_StatSlot(void)
+{
+    int id = yc_stat_tid;
+    if(id < 0)
     {
-        *(fn_to + i) = (* fn_fr);
-        if(2 == j) break;
-        fn_fr ++; i ++; j ++;
+        id = __atomic_fetch_add(&yc_stat_slots_used,1,__ATOMIC_RELAXED);
+        if(id >= YC_STATS_THREADS)
+            id = YC_STATS_THREADS - 1;
+        yc_stat_tid = id;
     }
-    *(fn_to + i + 1) = '\0';
+    return yc_stat_slot[id];
 }
 
-/* 日期(年-月-日)掩码 */
-#define DATE_YY_BASE 1980
-#define MASK_DATE_YY 0xFE00
-#define MASK_DATE_MM 0x01E0
-#define MASK_DATE_DD 0x001F
-#define MASK_TIME_HOUR 0xF800
-#define MASK_TIME_MIN  0x07E0
-#define MASK_TIME_SEC  0x001F
+/* 累加统计项，计入本线程当前接口及卷 */
+static void YC_StatAdd(VOL_t *vol,int id,unsigned int n)
+{
+    if(YC_OP_NONE != yc_cur_op)
+        YC_STAT_INC(&YC_StatSlot()[yc_cur_op].v[id],n);
+    if(vol)
+        YC_STAT_INC(&vol->stat.v[id],n);
+}
 
-/* 解析文件信息 */
-void YC_FAT_AnalyseFDI(FDI_t *fdi,FILE *fileInfo)
+/* 设备读写统计，落在FAT区的扇区另计入FAT扇区数 */
+static void YC_StatIo(VOL_t *vol,J_UINT8 wr,unsigned int sec,unsigned int n)
 {
-    FILE * flp = fileInfo;
+    YC_StatAdd(vol,wr ? YC_ST_SEC_WR : YC_ST_SEC_RD,n);
+    YC_StatAdd(vol,YC_ST_DEV_CMD,1);
+    if((sec >= vol->args.FAT1Sec) && (sec < vol->args.FirstDirSector))
+        YC_StatAdd(vol,YC_ST_FAT_SEC,n);
+}
 
-    /* 文件起始簇号 */
-    unsigned int fl_clus = 0;
-    fl_clus =  Byte2Value((unsigned char *)&fdi->startClusLower,2);
-    fl_clus |=  (Byte2Value((unsigned char *)&fdi->startClusUper,2) << 16);
-
-    /* 解析文件创建日期 */
-    typedef struct {J_UINT8 hour;J_UINT8 min;J_UINT8 sec;} fl_crtTime;
-    typedef struct {J_UINT16 yy;J_UINT8 mm;J_UINT8 dd;} fl_crtDate;
-    fl_crtTime time = {0}; fl_crtDate date = {0};
-    unsigned short o_date = (Byte2Value(((unsigned char *)&fdi->crtDate),2));
-    date.yy =  DATE_YY_BASE + ( (MASK_DATE_YY & o_date)>>9 );
-    date.mm =  (MASK_DATE_MM & o_date) >> 5;
-    date.dd = MASK_DATE_DD & o_date;
-
-    /* 解析文件创建时间 */
-    unsigned short o_time = (Byte2Value(((unsigned char *)&fdi->crtTime),2));
-    time.hour =  (MASK_TIME_HOUR & o_time)>>11 ;
-    time.min =  (MASK_TIME_MIN & o_time) >> 5;
-    time.sec = 2 * (MASK_TIME_SEC & o_time);
+/* 进入公共接口，已在其他接口内时不改变当前接口、不计调用次数，返回进入前的接口 */
+static J_UINT8 YC_StatEnter(J_UINT8 op,VOL_t *vol)
+{
+    J_UINT8 prev = yc_cur_op;
+    if(YC_OP_NONE != prev)
+        return prev;
+    yc_cur_op = op;
+    YC_STAT_INC(&YC_StatSlot()[op].v[YC_ST_CALLS],1);
+    if(vol)
+        YC_STAT_INC(&vol->stat.v[YC_ST_CALLS],1);
+    return prev;
+}
 
-    /* 解析文件最近访问日期 */
-    fl_crtDate a_date = {0};
-    unsigned short acd = (Byte2Value(((unsigned char *)&fdi->acsDate),2));
-    a_date.yy =  DATE_YY_BASE + ( (MASK_DATE_YY & acd)>>9 );
-    a_date.mm =  (MASK_DATE_MM & acd) >> 5;
-    a_date.dd = MASK_DATE_DD & acd;
+static void YC_StatLeave(J_UINT8 *prev)
+{
+    yc_cur_op = *prev;
+}
+
+/* 函数返回时自动退出接口 */
+#define YC_STAT_SCOPE(op,vol) J_UINT8 yc_stat_prev __attribute__((cleanup(YC_StatLeave))) = YC_StatEnter((op),(vol));
+#define YC_STAT_ADD(vol,id,n) YC_StatAdd((vol),(id),(n))
+#define YC_STAT_IO(v,wr,sec,n) YC_StatIo((v),(wr),(sec),(n))
+
+/* 取统计快照，op为YC_OP_NUM时汇总所有接口，各线程的计数合计 */
+void YC_FAT_StatGet(int op,yc_io_stat_t *st)
+{
+    int t, o, i;
+    for(i = 0; i < YC_ST_NUM; i ++)
+        st->v[i] = 0;
+    for(t = 0; t < YC_STATS_THREADS; t ++)
+        for(o = 0; o < YC_OP_NUM; o ++)
+        {
+            if((op != YC_OP_NUM) && (op != o))
+                continue;
+            for(i = 0; i < YC_ST_NUM; i ++)
+                st->v[i] += YC_STAT_LOAD(&yc_stat_slot[t][o].v[i]);
+        }
+}
+
+/* 取本线程的统计快照，op为YC_OP_NUM时汇总所有接口 */
+void YC_FAT_StatGetThread(int op,yc_io_stat_t *st)
+{
+    yc_io_stat_t *slot = YC_StatSlot();
+    int o, i;
+    for(i = 0; i < YC_ST_NUM; i ++)
+        st->v[i] = 0;
+    for(o = 0; o < YC_OP_NUM; o ++)
+    {
+        if((op != YC_OP_NUM) && (op != o))
+            continue;
+        for(i = 0; i < YC_ST_NUM; i ++)
+            st->v[i] += YC_STAT_LOAD(&slot[o].v[i]);
+    }
+}
+
+/* 取卷的统计快照 */
+void YC_FAT_StatGetVol(VOL_t *vol,yc_io_stat_t *st)
+{
+    int i;
+    for(i = 0; i < YC_ST_NUM; i ++)
+        st->v[i] = YC_STAT_LOAD(&vol->stat.v[i]);
+}
+
+/* 清零所有线程的接口统计，vol不为NULL时同时清零该卷的统计 */
+void YC_FAT_StatReset(VOL_t *vol)
+{
+    int t, o, i;
+    for(t = 0; t < YC_STATS_THREADS; t ++)
+        for(o = 0; o < YC_OP_NUM; o ++)
+            for(i = 0; i < YC_ST_NUM; i ++)
+                YC_STAT_CLR(&yc_stat_slot[t][o].v[i]);
+    if(vol)
+        for(i = 0; i < YC_ST_NUM; i ++)
+            YC_STAT_CLR(&vol->stat.v[i]);
+}
+#else
+#define YC_STAT_SCOPE(op,vol)
+#define YC_STAT_ADD(vol,id,n)
+#define YC_STAT_IO(v,wr,sec,n) ((void)0)
+#endif
+
+/* ------------------------------------------ */
+/*                 延迟直方图                   */
+/* ------------------------------------------ */
+/* 直方图编号：公共接口类别（yc_op_t）之后为设备命令及FAT空簇查找 */
+#define YC_HIST_DEV_RD (YC_OP_NUM)
+#define YC_HIST_DEV_WR (YC_OP_NUM + 1)
+#define YC_HIST_DEV_ZERO (YC_OP_NUM + 2)
+#define YC_HIST_FAT_SCAN (YC_OP_NUM + 3)    /* YC_FAT_SeekNextFirstEmptyClu */
+#define YC_HIST_NUM (YC_OP_NUM + 4)
+
+#if YC_HIST_ON
+/* 对数分桶：小于2^YC_HIST_SUB_BITS纳秒的值每纳秒一个桶，此后每个2的幂区间等分为2^YC_HIST_SUB_BITS个桶，最大约17秒 */
+#define YC_HIST_SUB (1u << YC_HIST_SUB_BITS)
+#define YC_HIST_MAX_BITS 34
+#define YC_HIST_BUCKETS ((YC_HIST_MAX_BITS - YC_HIST_SUB_BITS + 1) << YC_HIST_SUB_BITS)
+
+static J_UINT32 yc_hist[YC_HIST_NUM][YC_HIST_BUCKETS];
+static unsigned long long yc_hist_max[YC_HIST_NUM];
+/* 设备命令开始时刻，设备命令不嵌套，每个线程一个即可 */
+static YC_THREAD_LOCAL unsigned long long yc_hist_dev_t0;
+/* 本线程所在公共接口的嵌套深度 */
+static YC_THREAD_LOCAL J_UINT8 yc_hist_depth;
+
+#if (YC_LOCK_MODE != YC_LOCK_NONE)
+#define YC_HIST_INC(p) __atomic_fetch_add((p),1,__ATOMIC_RELAXED)
+#else
+#define YC_HIST_INC(p) ((*(p)) ++)
+#endif
+
+/* 延迟所在的桶 */
+static unsigned int YC_HistIdx(unsigned long long v)
+{
+    unsigned int msb, idx;
+    if(v < YC_HIST_SUB)
+        return (unsigned int)v;
+    msb = 63 - __builtin_clzll(v);
+    idx = ((msb - YC_HIST_SUB_BITS + 1) << YC_HIST_SUB_BITS) + ((v >> (msb - YC_HIST_SUB_BITS)) & (YC_HIST_SUB - 1));
+    return MIN(idx, YC_HIST_BUCKETS - 1);
+}
+
+/* 桶的上界（纳秒） */
+static unsigned long long YC_HistUpper(unsigned int idx)
+{
+    unsigned int sh;
+    if(idx < YC_HIST_SUB)
+        return idx;
+    sh = (idx >> YC_HIST_SUB_BITS) - 1;
+    return ((unsigned long long)(YC_HIST_SUB + (idx & (YC_HIST_SUB - 1)) + 1) << sh) - 1;
+}
+
+/* 记录一次延迟，热路径上只有一次查桶及一次计数 */
+static void YC_HistAdd(unsigned int id,unsigned long long ns)
+{
+    unsigned long long m;
+    YC_HIST_INC(&yc_hist[id][YC_HistIdx(ns)]);
+    m = yc_hist_max[id];
+    while(ns > m)
+    {
+#if (YC_LOCK_MODE != YC_LOCK_NONE)
+        if(__atomic_compare_exchange_n(&yc_hist_max[id],&m,ns,0,__ATOMIC_RELAXED,__ATOMIC_RELAXED))
+            break;
+#else
+        yc_hist_max[id] = ns;
+        break;
+#endif
+    }
+}
+
+typedef struct
+{
+    unsigned long long t0;
+    unsigned int id;
+}yc_hist_scope_t;
+
+static yc_hist_scope_t YC_HistEnter(unsigned int id)
+{
+    yc_hist_scope_t h;
+    h.t0 = YC_OS_ClockNs();
+    h.id = id;
+    return h;
+}
+
+static void YC_HistLeave(yc_hist_scope_t *h)
+{
+    YC_HistAdd(h->id,YC_OS_ClockNs() - h->t0);
+}
+
+/* 公共接口只在最外层记录延迟，嵌套调用的接口（如glob内的opendir）不另取样本 */
+static yc_hist_scope_t YC_HistApiEnter(unsigned int id)
+{
+    yc_hist_scope_t h = YC_HistEnter(id);
+    if(yc_hist_depth ++)
+        h.id = YC_HIST_NUM;
+    return h;
+}
+
+static void YC_HistApiLeave(yc_hist_scope_t *h)
+{
+    yc_hist_depth --;
+    if(YC_HIST_NUM != h->id)
+        YC_HistLeave(h);
+}
+
+/* 函数返回时自动记录本次调用的延迟 */
+#define YC_HIST_SCOPE(id) yc_hist_scope_t yc_hist_scope __attribute__((cleanup(YC_HistLeave))) = YC_HistEnter(id);
+#define YC_HIST_API_SCOPE(op) yc_hist_scope_t yc_hist_scope __attribute__((cleanup(YC_HistApiLeave))) = YC_HistApiEnter(op);
+#define YC_HIST_DEV_B() (yc_hist_dev_t0 = YC_OS_ClockNs())
+#define YC_HIST_DEV_E(id) YC_HistAdd((id),YC_OS_ClockNs() - yc_hist_dev_t0)
+
+/* 取延迟直方图的百万分位数（纳秒，取所在桶的上界，不超过最大值），如p50/p99/p999分别取500000/990000/999000 */
+/* 没有样本时返回0 */
+unsigned long long YC_FAT_HistQuantile(unsigned int id,unsigned int ppm)
+{
+    unsigned long long total = 0, rank, cum = 0, up, m;
+    unsigned int i;
+
+    if(id >= YC_HIST_NUM)
+        return 0;
+    for(i = 0; i < YC_HIST_BUCKETS; i ++)
+        total += yc_hist[id][i];
+    if(0 == total)
+        return 0;
+    rank = (total*MIN(ppm, 1000000) + 999999)/1000000;
+    if(0 == rank)
+        rank = 1;
+    m = yc_hist_max[id];
+    for(i = 0; i < YC_HIST_BUCKETS; i ++)
+    {
+        cum += yc_hist[id][i];
+        if(cum >= rank)
+            break;
+    }
+    up = YC_HistUpper(MIN(i, YC_HIST_BUCKETS - 1));
+    return (up > m) ? m : up;
+}
+
+/* 直方图样本数 */
+unsigned long long YC_FAT_HistCount(unsigned int id)
+{
+    unsigned long long total = 0;
+    unsigned int i;
+    if(id >= YC_HIST_NUM)
+        return 0;
+    for(i = 0; i < YC_HIST_BUCKETS; i ++)
+        total += yc_hist[id][i];
+    return total;
+}
+
+/* 最大延迟（纳秒） */
+unsigned long long YC_FAT_HistMax(unsigned int id)
+{
+    return (id < YC_HIST_NUM) ? yc_hist_max[id] : 0;
+}
+
+/* 清空所有直方图 */
+void YC_FAT_HistReset(void)
+{
+    unsigned int id, i;
+    for(id = 0; id < YC_HIST_NUM; id ++)
+    {
+        for(i = 0; i < YC_HIST_BUCKETS; i ++)
+            yc_hist[id][i] = 0;
+        yc_hist_max[id] = 0;
+    }
+}
+#else
+#define YC_HIST_SCOPE(id)
+#define YC_HIST_API_SCOPE(op)
+#define YC_HIST_DEV_B() ((void)0)
+#define YC_HIST_DEV_E(id) ((void)0)
+#endif
+
+/* 放在公共接口开头：统计调用、记录跟踪开始/结束事件及延迟 */
+#define YC_API_ENTER(op,vol) YC_STAT_SCOPE(op,vol) YC_TRACE_SCOPE() YC_HIST_API_SCOPE(op)
+
+/* 卷设备读写，统计、跟踪每次设备命令并记录其延迟 */
+#define YC_DiskRead(v,buf,sec,n) (YC_STAT_IO(v,0,sec,n), YC_TRACE_IO('B',"dev_read",sec,n), YC_HIST_DEV_B(), \
+    (v)->dev.read((v)->dev.ctx,(buf),(sec),(n)), YC_HIST_DEV_E(YC_HIST_DEV_RD), YC_TRACE_IO('E',"dev_read",sec,n))
+#define YC_DiskWrite(v,buf,sec,n) (YC_STAT_IO(v,1,sec,n), YC_TRACE_IO('B',"dev_write",sec,n), YC_HIST_DEV_B(), \
+    (v)->dev.write((v)->dev.ctx,(buf),(sec),(n)), YC_HIST_DEV_E(YC_HIST_DEV_WR), YC_TRACE_IO('E',"dev_write",sec,n))
+
+/* 句柄已打开时所在的卷，用于统计 */
+#define YC_FL_VOL(fl) ((FILE_OPEN == (fl)->file_state) ? (fl)->vol : NULL)
+
+/* 默认块设备读写接口，由用户实现 */
+void usr_read(void *ctx,void * buffer,unsigned int SecIndex,unsigned int SecNum)
+{
+    (void)ctx; (void)buffer; (void)SecIndex; (void)SecNum;
+}
+void usr_write(void *ctx,void * buffer,unsigned int SecIndex,unsigned int SecNum)
+{
+    (void)ctx; (void)buffer; (void)SecIndex; (void)SecNum;
+}
+/* 将Byte转化为数值 */
+unsigned int Byte2Value(unsigned char *data,unsigned char len)
+{
+    if(len > 4) return 0;
+
+    unsigned int temp = 0;
+    if(len >= 1) temp|=((unsigned char)data[0]);
+    if(len >= 2) temp|=((unsigned char)data[1])<<8;
+    if(len >= 3) temp|=((unsigned char)data[2])<<16;
+    if(len >= 4) temp|=((unsigned char)data[3])<<24;
+
+    return temp;
+}
+
+void YC_FAT_ReadDBR(VOL_t *vol,DBR_t * dbr_n);
+unsigned int YC_TakefileNextClu(VOL_t *vol,unsigned int fl_clus);
+
+/* 解析DBR */
+void YC_FAT_ReadDBR(VOL_t *vol,DBR_t * dbr_n)
+{
+    DBR_t * dbr = dbr_n;
+
+    unsigned char buffer[PER_SECSIZE];
+
+    /* 读DBR所在扇区，没有MBR时为绝对0扇区 */
+    YC_DiskRead(vol,(unsigned char *)buffer,vol->partStartSec,1);
+
+    /* 解析buffer数据 */
+    dbr->bytsPerSec = Byte2Value((unsigned char *)(buffer+11),2); /* 每扇区大小，通常为512 */
+    dbr->secPerClus = Byte2Value((unsigned char *)(buffer+13),1); /* 每簇扇区数 */  
+    dbr->rsvdSecCnt = Byte2Value((unsigned char *)(buffer+14),2); /* 保留扇区数（DBR->FAT1）*/
+    dbr->numFATs = Byte2Value((unsigned char *)(buffer+16),1);  /* FAT表数，通常为2 */
+    dbr->totSec32 = Byte2Value((unsigned char *)(buffer+32),4); /* 总扇区数 */
+    dbr->FATSz32 = Byte2Value((unsigned char *)(buffer+36),4); /* 每个FAT的扇区数，FAT32专用 */
+    dbr->rootClusNum = Byte2Value((unsigned char *)(buffer+44),4); /* 根目录簇号 */
+    dbr->FSInfo = Byte2Value((unsigned char *)(buffer+48),2); /* FSINFO扇区偏移 */
+}
+
+/* 解析字符串长度 */
+unsigned int YC_StrLen(char *str)
+{
+    char * p_str = str; unsigned int len = 0;
+
+    /* 当遍历到字符'\0'时停止 */
+    while( '\0' != (*p_str))
+    {
+        len ++; p_str ++;
+    }
+    return len;
+}
+
+/* 文件名匹配，返回文件名长度 */
+unsigned char ycFilenameMatch(char *fileToMatch,char *fileName)
+{
+    unsigned char len1 = YC_StrLen(fileName);
+    unsigned char len2 = YC_StrLen(fileToMatch);
+
+    if(len1 != len2) return 0;
+    unsigned char f_c = 0;
+    while( (*(fileToMatch + f_c) == *(fileName + f_c)) && ( f_c < len1) )
+    {
+        f_c ++;
+    }
+    if(f_c < (len1 - 1)) return 0;
+    return len1;
+}
+
+#define EXTNAME_EMP(x) ((x[8] == ' ')&&(x[9] == ' ')&&(x[10] == ' '))
+
+/* 8*3文件名转化为字符串类型 */
+/* ycfat中规定文件名不含空格 */
+void FDI_FileNameToString(char *from, char *to)
+{
+    if((from == NULL) || (to == NULL))
+        return;
+
+    unsigned char i = 0, j = 0;
+
+    /* 提取文件名，最多8字节 */
+    while((i < 8) && (' ' != from[i]))
+    {
+        to[i] = from[i]; i ++;
+    }
+
+    /* 首字节0x05表示实际字符为0xE5 */
+    if((i > 0) && (0x05 == (unsigned char)to[0]))
+        to[0] = (char)0xE5;
+
+    if(EXTNAME_EMP(from))
+    {
+        to[i] = '\0';
+        return;
+    }
+    to[i ++] = '.';
+
+    /* 提取扩展名，最多3字节 */
+    while((j < 3) && (' ' != from[8 + j]))
+    {
+        to[i ++] = from[8 + j]; j ++;
+    }
+    to[i] = '\0';
+}
+
+/* 日期(年-月-日)掩码 */
+#define DATE_YY_BASE 1980
+#define MASK_DATE_YY 0xFE00
+#define MASK_DATE_MM 0x01E0
+#define MASK_DATE_DD 0x001F
+#define MASK_TIME_HOUR 0xF800
+#define MASK_TIME_MIN  0x07E0
+#define MASK_TIME_SEC  0x001F
+
+void *YC_Memset(void *dest, int set, unsigned len);
+void YC_StrCpy(char *_tar, char *_src);
+
+/* 解析FAT日期 */
+static void YC_FAT_DecodeDate(unsigned short o_date,fl_time_t *t)
+{
+    t->yy =  DATE_YY_BASE + ( (MASK_DATE_YY & o_date)>>9 );
+    t->mm =  (MASK_DATE_MM & o_date) >> 5;
+    t->dd = MASK_DATE_DD & o_date;
+}
+
+/* 解析FAT时间 */
+static void YC_FAT_DecodeTime(unsigned short o_time,fl_time_t *t)
+{
+    t->hour =  (MASK_TIME_HOUR & o_time)>>11 ;
+    t->min =  (MASK_TIME_MIN & o_time) >> 5;
+    t->sec = 2 * (MASK_TIME_SEC & o_time);
+}
+
+/* 解码目录项：文件名、属性、大小、起始簇及时间戳 */
+void YC_FAT_DecodeFDI(FDI_t *fdi,dirent_t *ent)
+{
+    YC_Memset(ent, 0, sizeof(dirent_t));
+
+    /* 文件名及属性，长文件名由调用者另行填充 */
+    FDI_FileNameToString((char *)fdi->fileName, ent->sname);
+    YC_StrCpy(ent->name, ent->sname);
+    ent->attribute = fdi->attribute;
+
+    /* 文件起始簇号 */
+    ent->FirstClu =  Byte2Value((unsigned char *)&fdi->startClusLower,2);
+    ent->FirstClu |=  (Byte2Value((unsigned char *)&fdi->startClusUper,2) << 16);
+
+    /* 解析文件创建日期时间 */
+    YC_FAT_DecodeDate(Byte2Value(((unsigned char *)&fdi->crtDate),2),&ent->crt);
+    YC_FAT_DecodeTime(Byte2Value(((unsigned char *)&fdi->crtTime),2),&ent->crt);
+
+    /* 解析文件最近修改日期时间 */
+    YC_FAT_DecodeDate(Byte2Value(((unsigned char *)&fdi->modDate),2),&ent->mod);
+    YC_FAT_DecodeTime(Byte2Value(((unsigned char *)&fdi->modTime),2),&ent->mod);
+
+    /* 解析文件最近访问日期 */
+    YC_FAT_DecodeDate(Byte2Value(((unsigned char *)&fdi->acsDate),2),&ent->acs);
 
     /* 解析文件大小,精确到字节 */
-    unsigned int f_s = Byte2Value((unsigned char *)&fdi->fileSize,4);
+    ent->fl_sz = Byte2Value((unsigned char *)&fdi->fileSize,4);
+}
+
+/* 解析文件信息 */
+void YC_FAT_AnalyseFDI(FDI_t *fdi,FILE *fileInfo)
+{
+    FILE * flp = fileInfo;
+    dirent_t ent;
+
+    YC_FAT_DecodeFDI(fdi,&ent);
+
+    /* 将读出的文件信息保存 */
+    flp->CurClus = ent.FirstClu;
+    flp->CurOffSec = flp->CurOffByte = 0;
+    flp->fl_sz = flp->left_sz = ent.fl_sz ;
+    flp->FirstClu = ent.FirstClu;
+}
+
+/* 长文件名目录项属性 */
+#define ATTR_LFN 0x0F
+
+/* 每扇区目录项数目 */
+#define FDI_PER_SEC (PER_SECSIZE/sizeof(FDI_t))
+
+/* ASCII小写转大写，其余字符原样返回 */
+#define FOLD_UPPER(c) ((((c) >= 'a') && ((c) <= 'z')) ? ((c) - 0x20) : (c))
+
+/* 8*3文件名字符串比较，不区分大小写 */
+static J_UINT8 YC_FAT_NameEqual(const char *a, const char *b)
+{
+    while(*a && (FOLD_UPPER(*a) == FOLD_UPPER(*b)))
+    {
+        a ++; b ++;
+    }
+    return (*a == *b);
+}
+
+#if YC_LFN_ON
+#define LFN_NONE    0   /* 无长文件名 */
+#define LFN_OK      1   /* 长文件名完整且校验和正确 */
+#define LFN_SKIPPED 2   /* 有长文件名，但长度不匹配未收集 */
+
+/* 长文件名目录项最大数目 */
+#define LFN_MAX_ITEMS ((YC_LFN_MAXLEN + LFN_CHARS_PER_ITEM - 1)/LFN_CHARS_PER_ITEM)
+
+/* 计算短文件名校验和，长文件名目录项以此关联短文件名目录项 */
+J_UINT8 YC_FAT_LFNChkSum(J_UINT8 *sfn)
+{
+    J_UINT8 sum = 0;
+    for(int i = 0; i < 11; i++)
+        sum = ((sum & 1) ? 0x80 : 0) + (sum >> 1) + sfn[i];
+    return sum;
+}
+
+/* UTF-8转UTF-16（仅BMP），返回字符数，非法编码或超长返回-1 */
+static int YC_Utf8ToUtf16(const char *s, J_UINT16 *d, int max)
+{
+    const J_UINT8 *p = (const J_UINT8 *)s;
+    int n = 0;
+    while(*p)
+    {
+        if(n >= max) return -1;
+        if(*p < 0x80){
+            d[n ++] = *p ++;
+        }else if(((*p & 0xE0) == 0xC0) && ((p[1] & 0xC0) == 0x80)){
+            d[n ++] = ((p[0] & 0x1F) << 6) | (p[1] & 0x3F); p += 2;
+        }else if(((*p & 0xF0) == 0xE0) && ((p[1] & 0xC0) == 0x80) && ((p[2] & 0xC0) == 0x80)){
+            d[n ++] = ((p[0] & 0x0F) << 12) | ((p[1] & 0x3F) << 6) | (p[2] & 0x3F); p += 3;
+        }else{
+            return -1;
+        }
+    }
+    return n;
+}
+
+/* UTF-16转UTF-8，超出缓冲部分截断，返回字节数 */
+static int YC_Utf16ToUtf8(const J_UINT16 *s, int len, char *d, int max)
+{
+    int n = 0;
+    for(int i = 0; i < len; i++)
+    {
+        J_UINT16 c = s[i];
+        if(c < 0x80){
+            if(n + 1 > max) break;
+            d[n ++] = c;
+        }else if(c < 0x800){
+            if(n + 2 > max) break;
+            d[n ++] = 0xC0 | (c >> 6); d[n ++] = 0x80 | (c & 0x3F);
+        }else{
+            if(n + 3 > max) break;
+            d[n ++] = 0xE0 | (c >> 12); d[n ++] = 0x80 | ((c >> 6) & 0x3F); d[n ++] = 0x80 | (c & 0x3F);
+        }
+    }
+    d[n] = '\0';
+    return n;
+}
+
+/* 取长文件名目录项中的第k个字符（0~12） */
+static J_UINT16 YC_FAT_LFNGetChar(LFN_t *l, int k)
+{
+    J_UINT8 *p = (k < 5) ? &l->name1[2*k] : (k < 11) ? &l->name2[2*(k-5)] : &l->name3[2*(k-11)];
+    return (J_UINT16)(p[0] | (p[1] << 8));
+}
+
+/* 写长文件名目录项中的第k个字符（0~12） */
+static void YC_FAT_LFNSetChar(LFN_t *l, int k, J_UINT16 c)
+{
+    J_UINT8 *p = (k < 5) ? &l->name1[2*k] : (k < 11) ? &l->name2[2*(k-5)] : &l->name3[2*(k-11)];
+    p[0] = c; p[1] = c >> 8;
+}
+
+/* 长文件名收集复位 */
+static void YC_FAT_LFNReset(lfn_state_t *st)
+{
+    st->active = 0;
+    st->next_ord = 0;
+}
+
+/* 送入一个长文件名目录项，序号或校验和不连续时丢弃整条长文件名 */
+static void YC_FAT_LFNFeed(lfn_state_t *st, LFN_t *l)
+{
+    J_UINT8 ord = l->ord & LFN_ORD_MASK;
+    int k, pos;
+
+    if(l->ord & LFN_LAST_ORD)
+    {
+        /* 长文件名首项（序号最大），由此项即可得出长文件名长度 */
+        if((0 == ord) || (ord > LFN_MAX_ITEMS))
+        {
+            st->active = 0;
+            return;
+        }
+        for(k = 0; k < LFN_CHARS_PER_ITEM; k++)
+            if(0x0000 == YC_FAT_LFNGetChar(l,k)) break;
+        st->len = (ord - 1)*LFN_CHARS_PER_ITEM + k;
+        if((0 == st->len) || (st->len > YC_LFN_MAXLEN))
+        {
+            st->active = 0;
+            return;
+        }
+        st->chksum = l->chksum;
+        st->next_ord = ord;
+        st->active = 1;
+        /* 长度不匹配时不再拷贝字符 */
+        st->skip = (st->want_len && (st->len != st->want_len));
+    }
+    else if((!st->active) || (ord != st->next_ord) || (l->chksum != st->chksum))
+    {
+        st->active = 0;
+        return;
+    }
+
+    if(!st->skip)
+    {
+        for(k = 0; k < LFN_CHARS_PER_ITEM; k++)
+        {
+            pos = (ord - 1)*LFN_CHARS_PER_ITEM + k;
+            if(pos >= st->len) break;
+            st->name[pos] = YC_FAT_LFNGetChar(l,k);
+        }
+    }
+    st->next_ord = ord - 1;
+}
+
+/* 遇到短文件名目录项，校验之前收集的长文件名是否属于该目录项 */
+static J_UINT8 YC_FAT_LFNEnd(lfn_state_t *st, FDI_t *fdi)
+{
+    J_UINT8 ret = LFN_NONE;
+
+    if(st->active && (0 == st->next_ord) && (st->chksum == YC_FAT_LFNChkSum(fdi->fileName)))
+    {
+        ret = st->skip ? LFN_SKIPPED : LFN_OK;
+        if(LFN_OK == ret) st->name[st->len] = 0x0000;
+    }
+    st->active = 0;
+    return ret;
+}
+
+/* UTF-16长文件名比较，ASCII字符不区分大小写 */
+static J_UINT8 YC_FAT_LFNEqual(const J_UINT16 *a, const J_UINT16 *b, int len)
+{
+    for(int i = 0; i < len; i++)
+        if(FOLD_UPPER(a[i]) != FOLD_UPPER(b[i])) return 0;
+    return 1;
+}
+
+/* 别名序号位数 */
+static J_UINT8 YC_AliasTailDigits(unsigned int n)
+{
+    J_UINT8 d = 1;
+    while(n >= 10) { n /= 10; d ++; }
+    return d;
+}
+
+/* 记录目录中与别名基名冲突的数字尾序号 */
+static void YC_FAT_AliasCollect(dirscan_t *sc, FDI_t *fdi)
+{
+    J_UINT8 t, k, pre;
+    unsigned int n = 0;
+
+    /* 查找'~' */
+    for(t = 1; t < 8; t++)
+        if('~' == fdi->fileName[t]) break;
+    if(t >= 7) return;
+
+    /* 解析数字尾 */
+    for(k = t + 1; (k < 8) && (' ' != fdi->fileName[k]); k++)
+    {
+        if((fdi->fileName[k] < '0') || (fdi->fileName[k] > '9')) return;
+        n = n*10 + (fdi->fileName[k] - '0');
+    }
+    if((k == t + 1) || (0 == n) || (n > YC_ALIAS_TAIL_MAX)) return;
+
+    /* 前缀长度需与生成该序号时一致 */
+    pre = MIN(sc->alias_len, 7 - YC_AliasTailDigits(n));
+    if(pre != t) return;
+    for(k = 0; k < t; k++)
+        if(FOLD_UPPER(fdi->fileName[k]) != sc->alias[k]) return;
+    for(k = 0; k < 3; k++)
+        if(FOLD_UPPER(fdi->extName[k]) != sc->alias[8 + k]) return;
+
+    sc->tails[n/8] |= (1 << (n%8));
+}
+#endif
+
+/* 文件名哈希（FNV-1a），ASCII字符不区分大小写 */
+static J_UINT32 YC_FAT_NameHash(const J_UINT16 *s, int len)
+{
+    J_UINT32 h = 2166136261u;
+    J_UINT16 c;
+    for(int i = 0; i < len; i++)
+    {
+        c = FOLD_UPPER(s[i]);
+        h = (h ^ (c & 0xFF)) * 16777619u;
+        h = (h ^ (c >> 8)) * 16777619u;
+    }
+    return h ? h : 1;
+}
+
+/* 单字节字符串（8*3文件名）哈希，与同名长文件名哈希一致 */
+static J_UINT32 YC_FAT_StrHash(const char *s)
+{
+    J_UINT16 u[12];
+    int n = 0;
+    while(s[n] && (n < 12))
+    {
+        u[n] = (J_UINT8)s[n];
+        n ++;
+    }
+    return YC_FAT_NameHash(u, n);
+}
+
+/* 查询哈希值，返回1表示可能存在 */
+static J_UINT8 YC_FAT_SetHas(name_set_t *set, J_UINT32 h)
+{
+    unsigned int i = h & (set->size - 1);
+
+    if(set->full) return 1;
+    while(set->slot[i])
+    {
+        if(set->slot[i] == h) return 1;
+        i = (i + 1) & (set->size - 1);
+    }
+    return 0;
+}
+
+/* 哈希槽数目加倍并重新散列，堆空间不足时返回0 */
+static J_UINT8 YC_FAT_SetGrow(name_set_t *set)
+{
+    unsigned int size = set->size*2, i, j;
+    J_UINT32 *slot = (J_UINT32 *)tAllocHeapforeach(size*sizeof(J_UINT32));
+
+    if(NULL == slot)
+        return 0;
+    YC_Memset(slot, 0, size*sizeof(J_UINT32));
+    for(i = 0; i < set->size; i++)
+    {
+        if(0 == set->slot[i])
+            continue;
+        j = set->slot[i] & (size - 1);
+        while(slot[j])
+            j = (j + 1) & (size - 1);
+        slot[j] = set->slot[i];
+    }
+    if(set->own)
+        tFreeHeapforeach(set->slot);
+    set->slot = slot;
+    set->size = size;
+    set->own = 1;
+    return 1;
+}
+
+/* 保证还能再加入n个哈希值而不超过装载上限（3/4），无法扩容时标记集合已满并返回0 */
+static J_UINT8 YC_FAT_SetReserve(name_set_t *set, unsigned int n)
+{
+    while(!set->full && (4*(set->cnt + n) > 3*set->size))
+    {
+        if(!YC_FAT_SetGrow(set))
+            set->full = 1;
+    }
+    return !set->full;
+}
+
+/* 加入哈希值，超过装载上限时扩容 */
+static void YC_FAT_SetAdd(name_set_t *set, J_UINT32 h)
+{
+    unsigned int i;
+
+    if(!YC_FAT_SetReserve(set,1)) return;
+    i = h & (set->size - 1);
+    while(set->slot[i])
+    {
+        if(set->slot[i] == h) return;
+        i = (i + 1) & (set->size - 1);
+    }
+    set->slot[i] = h;
+    set->cnt ++;
+}
+
+/* 释放扩容时分配的哈希槽 */
+static void YC_FAT_SetFree(name_set_t *set)
+{
+    if(set->own)
+        tFreeHeapforeach(set->slot);
+    set->own = 0;
+}
+
+/* 查找目录提示，未命中返回NULL */
+static dir_hint_t * YC_FAT_HintGet(VOL_t *vol,unsigned int dir_clu)
+{
+    for(int i = 0; i < YC_DIR_HINT_NUM; i++)
+    {
+        if(vol->dir_hints[i].dir_clu == dir_clu)
+        {
+            vol->dir_hints[i].age = ++ vol->dir_hint_age;
+            return &vol->dir_hints[i];
+        }
+    }
+    return NULL;
+}
+
+/* 分配目录提示，表满时替换最久未使用的一项 */
+static dir_hint_t * YC_FAT_HintAlloc(VOL_t *vol,unsigned int dir_clu)
+{
+    dir_hint_t *h = YC_FAT_HintGet(vol,dir_clu);
+    if(NULL != h)
+        return h;
+
+    h = &vol->dir_hints[0];
+    for(int i = 1; i < YC_DIR_HINT_NUM; i++)
+        if(vol->dir_hints[i].age < h->age) h = &vol->dir_hints[i];
+
+    YC_Memset(h, 0, sizeof(dir_hint_t));
+    h->dir_clu = dir_clu;
+    h->age = ++ vol->dir_hint_age;
+    return h;
+}
+
+/* 作废目录提示 */
+void YC_FAT_HintDrop(VOL_t *vol,unsigned int dir_clu)
+{
+    dir_hint_t *h = YC_FAT_HintGet(vol,dir_clu);
+    if(NULL != h)
+        YC_Memset(h, 0, sizeof(dir_hint_t));
+}
+
+/* 遍历目录簇链，一次完成文件名查找（长文件名及8*3文件名）、空闲目录项统计和别名冲突收集，可选收集所有文件名哈希 */
+/* 长文件名查找时先以长度过滤、再以短文件名校验和确认，最后才比较完整文件名 */
+/* 完整遍历整个目录（未找到）时刷新该目录的空闲目录项提示 */
+/* 调用者需持有卷读锁或写锁，读者之间以目录提示锁互斥 */
+SeekFile YC_FAT_ScanDir(VOL_t *vol,unsigned int dir_clu,dirscan_t *sc)
+{
+    FDIs_t fdis; FDI_t *fdi;
+    char fn[13];
+    unsigned int clu = dir_clu;
+    dir_hint_t hint = {0};
+#if YC_LFN_ON
+    J_UINT8 lfn_ret;
+    int l;
+#endif
+
+#if YC_LFN_ON
+    sc->lfn_ok = 0;
+    sc->u16_len = 0;
+    if(sc->name)
+    {
+        l = YC_Utf8ToUtf16(sc->name,sc->u16,YC_LFN_MAXLEN);
+        sc->u16_len = (l < 0) ? 0 : l;
+    }
+    YC_FAT_LFNReset(&sc->lfn);
+    sc->lfn.want_len = sc->lfn_all ? 0 : sc->u16_len;
+    if(sc->alias)
+        YC_Memset(sc->tails, 0, sizeof(sc->tails));
+#endif
+
+    do{
+        sc->tail_clu = clu;
+        for(int i = 0;i < vol->dbr.secPerClus;i++)
+        {
+            YC_DiskRead(vol,(unsigned char *)&fdis,START_SECTOR_OF_FILE(vol,clu)+i,1);
+            YC_STAT_ADD(vol,YC_ST_DIR_SEC,1);
+            for(unsigned int j = 0; j < FDI_PER_SEC; j++)
+            {
+                fdi = &fdis.fdi[j];
+
+                /* 目录项结束，0x00之后的目录项均空闲 */
+                if(0x00 == fdi->fileName[0])
+                {
+                    hint.end.clu = clu; hint.end.sec = i; hint.end.idx = j;
+                    hint.end_valid = 1;
+                    goto scan_end;
+                }
+                /* 可复用的已删除目录项 */
+                if(0xE5 == fdi->fileName[0])
+                {
+                    if(0 == hint.e5_cnt ++)
+                    {
+                        hint.first_e5.clu = clu; hint.first_e5.sec = i; hint.first_e5.idx = j;
+                        hint.e5_known = 1;
+                    }
+#if YC_LFN_ON
+                    YC_FAT_LFNReset(&sc->lfn);
+#endif
+                    continue;
+                }
+
+#if YC_LFN_ON
+                if(ATTR_LFN == CHECK_FDI_ATTR(fdi))
+                {
+                    YC_FAT_LFNFeed(&sc->lfn,(LFN_t *)fdi);
+                    continue;
+                }
+                lfn_ret = YC_FAT_LFNEnd(&sc->lfn,fdi);
+                if(sc->alias)
+                    YC_FAT_AliasCollect(sc,fdi);
+#endif
+                if(VOLUME & CHECK_FDI_ATTR(fdi))
+                    continue;
+
+                /* 收集已有文件名（8*3文件名及长文件名）哈希 */
+                if(sc->set)
+                {
+                    FDI_FileNameToString((char *)fdi->fileName, fn);
+                    YC_FAT_SetAdd(sc->set,YC_FAT_StrHash(fn));
+#if YC_LFN_ON
+                    if(LFN_OK == lfn_ret)
+                        YC_FAT_SetAdd(sc->set,YC_FAT_NameHash(sc->lfn.name,sc->lfn.len));
+#endif
+                }
+                if(NULL == sc->name)
+                    continue;
+
+#if YC_LFN_ON
+                /* 长文件名匹配 */
+                sc->lfn_ok = (LFN_OK == lfn_ret);
+                if(!(sc->lfn_ok && (sc->lfn.len == sc->u16_len) && YC_FAT_LFNEqual(sc->lfn.name,sc->u16,sc->u16_len)))
+#endif
+                {
+                    /* 8*3文件名匹配 */
+                    FDI_FileNameToString((char *)fdi->fileName, fn);
+                    if(!YC_FAT_NameEqual(fn,sc->name))
+                        continue;
+                }
+                sc->fdi = *fdi;
+                sc->loc.clu = clu; sc->loc.sec = i; sc->loc.idx = j;
+                return FOUND;
+            }
+        }
+        clu = YC_TakefileNextClu(vol,clu);
+    }while(!IS_EOF(clu));
+
+scan_end:
+    /* 刷新空闲目录项提示 */
+    hint.tail_clu = sc->tail_clu;
+    YC_LockWait(&vol->hint_lock);
+    {
+        dir_hint_t *h = YC_FAT_HintAlloc(vol,dir_clu);
+        hint.dir_clu = h->dir_clu;
+        hint.age = h->age;
+        *h = hint;
+    }
+    YC_Unlock(&vol->hint_lock);
+    return NOTFOUND;
+}
+
+/* 解析根目录簇文件目录信息 */
+/* 测试用例，通过 */
+SeekFile YC_FAT_ReadFileAttribute(VOL_t *vol,FILE * file,char *filename)
+{
+    char fileToMatch[13]; /* 最后一字节为'\0' */
+
+    /* 获取根目录起始簇（第2簇） */
+    /* FAT32中簇号是从2开始 */
+    /* 首目录簇所在扇区已在挂载时由DBR计算 */
+    unsigned int fdi_clu = ROOT_CLUS;
+
+    /* 读取首目录簇下的所有扇区 */
+    FDIs_t fdis;
+    do{
+        for(int i = 0;i < vol->dbr.secPerClus;i++)
+        {
+            YC_DiskRead(vol,(unsigned char *)&fdis,START_SECTOR_OF_FILE(vol,fdi_clu)+i,1);
+
+            /* 从buffer进行文件名匹配 */
+            FDI_t *fdi = NULL;
+            fdi = (FDI_t *)&fdis.fdi[0];
+
+            /* 先检查文件属性是否为目录 */
+            if( 1 ) /* 不是目录且没有删除 */
+            {
+                /* 从当前扇区地址循环偏移固定字节取文件名 */
+                for( ; (unsigned char *)fdi < ((unsigned char *)&fdis + PER_SECSIZE) ; fdi ++)
+                {   
+                    if( (0x10 != CHECK_FDI_ATTR(fdi)) && (0xE5 != fdi->fileName[0]) )
+                    {
+                        /* 将目录簇中的8*3文件名转化为字符串类型 */
+                        FDI_FileNameToString((char *)fdi->fileName, fileToMatch);
+
+                        /* 匹配到文件名 */
+                        if( ycFilenameMatch(fileToMatch,filename) )
+                        {
+                            YC_FAT_AnalyseFDI(fdi,file);
+                            file->file_state = FILE_OPEN; return FOUND;
+                        }
+                    }
+                }
+            }
+        }
+        fdi_clu = YC_TakefileNextClu(vol,fdi_clu);
+    }while(!IS_EOF(fdi_clu));
+    
+    return NOTFOUND;
+}
+
+/* 从第n簇（目录起始簇）解析目录簇链文件目录信息 */
+/* loc返回文件目录项位置 */
+SeekFile YC_FAT_MatchFile(VOL_t *vol,unsigned int clu,FILE * file,char *filename,fdi_loc_t *loc)
+{
+    dirscan_t sc = {0};
+    if((NULL == file) || (NULL == filename))
+        return NOTFOUND;
+
+    sc.name = filename;
+    if(FOUND != YC_FAT_ScanDir(vol,clu,&sc))
+        return NOTFOUND;
+
+    /* 目录不能作为文件打开 */
+    if(TP_DIR & sc.fdi.attribute)
+        return NOTFOUND;
+
+    YC_FAT_AnalyseFDI(&sc.fdi,file);
+    *loc = sc.loc;
+    file->file_state = FILE_OPEN;
+    return FOUND;
+}
+
+typedef struct FAT_Table
+{
+    J_UINT8 fat[FAT_SIZE];
+}FAT32_t;
+
+typedef struct FAT_TableSector
+{
+    FAT32_t fat_sec[PER_SECSIZE/FAT_SIZE];//128
+}FAT32_Sec_t;
+
+#define READ_OPS
+
+#if YC_FAT_CACHE_SHARDS
+/* 在FAT扇区缓存中查找，未命中时读盘并替换分片内最久未使用的一项，调用者持有分片锁 */
+static fat_cache_ent_t * YC_FAT_CacheGet(VOL_t *vol,fat_cache_shard_t *sh,unsigned int sec)
+{
+    fat_cache_ent_t *e = &sh->ent[0];
+
+    for(int i = 0; i < YC_FAT_CACHE_WAYS; i++)
+    {
+        if(sh->ent[i].sec == sec)
+        {
+            e = &sh->ent[i];
+            YC_STAT_ADD(vol,YC_ST_CACHE_HIT,1);
+            goto hit;
+        }
+        if(sh->ent[i].age < e->age) e = &sh->ent[i];
+    }
+    YC_STAT_ADD(vol,YC_ST_CACHE_MISS,1);
+    YC_DiskRead(vol,(unsigned char *)e->fat,sec,1);
+    e->sec = sec;
+hit:
+    e->age = ++ sh->age;
+    return e;
+}
+#endif
+
+/* 获取文件下一簇簇号 */
+/* FAT扇区经分片缓存读取，多个读者并发查找时只在同一分片上互斥 */
+unsigned int YC_TakefileNextClu(VOL_t *vol,unsigned int fl_clus)
+{
+    /* FAT所在绝对扇区及扇区内偏移（以FAT大小为单位） */
+    unsigned int t_rSec = CLU_TO_FATSEC(vol,fl_clus);
+    unsigned int off_fat = fl_clus % (PER_SECSIZE/FAT_SIZE);
+#if YC_FAT_CACHE_SHARDS
+    fat_cache_shard_t *sh = &vol->fat_cache[t_rSec % YC_FAT_CACHE_SHARDS];
+    unsigned int fat_n;
+
+    YC_LockWait(&sh->lock);
+    fat_n = Byte2Value((unsigned char *)&YC_FAT_CacheGet(vol,sh,t_rSec)->fat[off_fat],FAT_SIZE);
+    YC_Unlock(&sh->lock);
+    return fat_n;
+#else
+    J_UINT32 fat_sec[PER_SECSIZE/FAT_SIZE];
+
+    /* 取当前扇区所有FAT */
+    YC_DiskRead(vol,(unsigned char *)fat_sec,t_rSec,1);
+    /* 返回下一FAT */
+    return Byte2Value((unsigned char *)&fat_sec[off_fat],FAT_SIZE);
+#endif
+}
+
+/* 回写FAT扇区，同时更新缓存中的副本，调用者持有卷写锁 */
+static void YC_FAT_PutFatSec(VOL_t *vol,unsigned int sec,void *buf)
+{
+    YC_DiskWrite(vol,(unsigned char *)buf,sec,1);
+#if YC_FAT_CACHE_SHARDS
+    fat_cache_shard_t *sh = &vol->fat_cache[sec % YC_FAT_CACHE_SHARDS];
+    YC_LockWait(&sh->lock);
+    for(int i = 0; i < YC_FAT_CACHE_WAYS; i++)
+    {
+        if(sh->ent[i].sec == sec)
+        {
+            memcpy(sh->ent[i].fat,buf,PER_SECSIZE);
+            break;
+        }
+    }
+    YC_Unlock(&sh->lock);
+#endif
+}
+
+/************************************************/
+/* 读取文件整条簇链（文件所有数据在所遍历的簇链中） */
+/* 传入参数：文件首簇                            */
+/* 传出参数：文件末簇                            */
+/* 效率较高，有效降低磁盘读写次数                 */
+/* 空文件（首簇为0）返回0                        */
+/***********************************************/
+static int TakeFileClusList_Eftv(VOL_t *vol,unsigned int first_clu)
+{
+    unsigned int clu = first_clu, end_clu = first_clu;
+
+    if(0 == first_clu)
+        return 0;
+    /* 遍历整条簇链 */
+    do 
+    {
+        /* 添加打印信息 */
+        //YC_FAT_Printf("%d\r\n",clu);
+        end_clu = clu;
+        clu = YC_TakefileNextClu(vol,clu);
+    }while(!IS_EOF(clu));
+
+    return end_clu;
+}
+
+/* 由共享节点同步文件大小，其他句柄追加的数据可被读到 */
+static void YC_FAT_SyncSize(FILE *fl)
+{
+    fl->left_sz += fl->node->fl_sz - fl->fl_sz;
+    fl->fl_sz = fl->node->fl_sz;
+    if(0 == fl->FirstClu)
+        fl->FirstClu = fl->CurClus = fl->node->FirstClu;
+}
+
+/* 数据读取函数，读出min(len,剩余大小)字节 */
+/* 读位置锚定在CurClus/CurOffSec/CurOffByte，读到簇尾时不立即前进，下次读取需要数据时再取下一簇，文件被追加后可接着读 */
+/* 对齐的整扇区直接读入用户缓冲，一次读出簇内连续的多个扇区，非对齐部分经栈上扇区缓冲拷贝 */
+/* 调用者持有文件锁及卷读锁，不同文件可并发读取 */
+J_UINT32 YC_ReadDataNoCheck(FILE* fileInfo,unsigned int len,unsigned char * buffer)
+{
+    if(FILE_OPEN != fileInfo->file_state)
+        return 0;
+    YC_FAT_SyncSize(fileInfo);
+    VOL_t *vol = fileInfo->vol;
+    unsigned char app_buf[PER_SECSIZE];
+    unsigned int t_rSize = MIN(len, fileInfo->left_sz);/* 需要读的数据大小 */
+    unsigned int done = 0, n, nsec, sec;
+
+    while(done < t_rSize)
+    {
+        /* 当前簇已读完，前进到下一簇 */
+        if(fileInfo->CurOffSec >= vol->dbr.secPerClus)
+        {
+            fileInfo->CurClus = YC_TakefileNextClu(vol,fileInfo->CurClus);
+            fileInfo->CurOffSec = 0;
+            if(IS_EOF(fileInfo->CurClus) || (fileInfo->CurClus < 2))
+                break;
+        }
+        sec = START_SECTOR_OF_FILE(vol,fileInfo->CurClus) + fileInfo->CurOffSec;
+
+        if((0 == fileInfo->CurOffByte) && (t_rSize - done >= PER_SECSIZE))
+        {
+            /* 整扇区直接读入用户缓冲 */
+            nsec = MIN((t_rSize - done)/PER_SECSIZE, vol->dbr.secPerClus - fileInfo->CurOffSec);
+            YC_DiskRead(vol,buffer + done,sec,nsec);
+            fileInfo->CurOffSec += nsec;
+            done += nsec*PER_SECSIZE;
+        }
+        else
+        {
+            /* 扇区内部分数据 */
+            YC_DiskRead(vol,app_buf,sec,1);
+            n = MIN(PER_SECSIZE - fileInfo->CurOffByte, t_rSize - done);
+            memcpy(buffer + done,app_buf + fileInfo->CurOffByte,n);
+            done += n;
+            fileInfo->CurOffByte += n;
+            if(PER_SECSIZE == fileInfo->CurOffByte)
+            {
+                fileInfo->CurOffByte = 0;
+                fileInfo->CurOffSec ++;
+            }
+        }
+    }
+
+    fileInfo->left_sz -= done;
+    YC_STAT_ADD(vol,YC_ST_BYTES_RD,done);
+    return done;
+}
+
+/* 小写转大写 */
+J_UINT8 Lower2Up(J_UINT8 ch)
+{
+    J_UINT8 Upch = 0xff;
+    if((ch >= 0x61) && (ch <= 0x7a))
+         Upch = *((J_UINT8 *)&ch) - 0x20;
+    return Upch;
+}
+
+/* 大写转小写 */
+J_UINT8 Up2Lower(J_UINT8 ch)
+{
+    J_UINT8 Lowch = 0xff;
+    if((ch >= 0x41) && (ch <= 0x5a))
+         Lowch = *((J_UINT8 *)&ch) + 0x20;
+    return Lowch;
+}
+
+/* 子字符串定位 */
+J_UINT8 FindSubStr(char *str,char *substr,unsigned char pos)
+{
+    J_UINT8 i = pos,j = 0,lens = YC_StrLen(str),lent = YC_StrLen(substr);
+    while((i < lens) && (j < lent))
+    {
+        if((str[i] == substr[j]) || ('?' == substr[j])){
+            i ++; j ++;
+        }
+        else{
+            i = i - j + 1; j = 0;
+        }
+    }
+    if(j == lent) 
+        return (i - lent);
+    else 
+        return 0xff;
+}
 
-    /* 将读出的文件信息保存 */
-    flp->CurClus = fl_clus;
-    flp->CurOffSec = flp->CurOffByte = 0;
-    flp->fl_sz = flp->left_sz = f_s ;
-    flp->FirstClu = fl_clus;
+/* 文件通配 */
+J_UINT8 FileNameMatch(unsigned char *s,unsigned char *t)
+{
+    J_UINT8 i = 0, j = 0, lens = YC_StrLen(s), lent = YC_StrLen(t), flag = 0;
+    J_UINT8 buf[10];
+    J_UINT8 bufp = 0;
+    while((j < lent) && ('*' != t[j]))
+    {
+        buf[bufp] = Lower2Up(t[j]);
+        /* 大小写转化失败 */
+        if(buf[bufp] == 0xff) return 1;
+        bufp ++; j ++;
+    }
+    buf[bufp] = '\0';
+    if(FindSubStr(s, buf, 0) != 0) return 0;
+    i = bufp;
+    while(1)
+    {
+        while((j < lent) && ('*' == t[j])) j ++;
+        if(j == lent) return 1;
+        bufp = 0;
+        while((j < lent) && ('*' != t[j]))
+        {
+            buf[bufp] = Lower2Up(t[j]);
+            /* 大小写转化失败 */
+            if(buf[bufp] == 0xff) return 1;
+            bufp ++; j ++;
+        }
+        buf[bufp] = '\0';
+        if(j == lent)
+        {
+            if(FindSubStr(s, buf, i) != (lens - bufp)) return 0;
+            return 1;
+        }
+        i = FindSubStr(s, buf, i);
+        if(0xff == i) return 0;
+        i += bufp;
+    }
 }
 
-/* 解析根目录簇文件目录信息 */
-/* 测试用例，通过 */
-SeekFile YC_FAT_ReadFileAttribute(FILE * file,char *filename)
+/* 文件路径预处理，剔除无效空格字符 */
+void DelexcSpace(char * s,char * d)
 {
-    char fileToMatch[13]; /* 最后一字节为'\0' */
+    int i = 0,j = 0;
+    int sp_l = 0;
+    char * s1 = s;
+    while(' ' == *s1)
+    {
+        s1 += 1; sp_l++;
+    }
+    for(i = sp_l;i < YC_StrLen(s);i++)
+    {
+        d[j] = s[i];j++;
+    }
+    d[j] = '\0';
+}
 
-    /* 获取根目录起始簇（第2簇） */
-    /* FAT32中簇号是从2开始 */
-    /* 先由DBR计算首目录簇所在扇区，这里默认只有一个DBR */
-    unsigned int fileDirSec;
-    if(!g_dbr_n)
-        fileDirSec = g_dbr[0].rsvdSecCnt + (g_dbr[0].numFATs * g_dbr[0].FATSz32);
-    else
-        fileDirSec = g_mbr.dpt[0].partStartSec + g_dbr[0].rsvdSecCnt + (g_dbr[0].numFATs * g_dbr[0].FATSz32);
+/* 字符串复制1 */
+void YC_StrCpy(char *_tar, char *_src)
+{
+	do
+	{
+		*_tar++ = *_src;
+	}
+	while (*_src++);
+}
 
-    FirstDirSector = fileDirSec;
-    
-    unsigned int fdi_clu = ROOT_CLUS;
+/* 字符串复制2 */
+void YC_StrCpy_l(char *_tar, char *_src, int len)
+{
+	do
+	{
+		*_tar++ = *_src;
+        len = len - 1;
+	}
+	while ((*_src++) && len);
+}
 
-    /* 读取首目录簇下的所有扇区 */
-    FDIs_t fdis;
-    do{
-        for(int i = 0;i < g_dbr[0].secPerClus;i++)
+/* 内存设置 */
+void *YC_Memset(void *dest, int set, unsigned len)
+{
+	if (dest == NULL || len < 0)
+	{
+		return NULL;
+	}
+	char *pdest = (char *)dest;
+	while (len-->0)
+	{
+		*pdest++ = set;
+	}
+	return dest;
+}
+
+/* 字符串自截断 */
+/* start是丢弃前start个字节 */
+/* 传参source不能被const修饰 */
+void YC_SubStr(char *source, int start, int length)
+{
+    int sourceLength = YC_StrLen(source);
+    /* Tip：这里直接定义一个YC_PATH_MAXLEN大小的数组不严谨，建议采用malloc机制 */
+    char bk[YC_PATH_MAXLEN] = {0};
+    if (start < 0 || start >= sourceLength || length <= 0){
+        source[0] = '\0';
+        return;
+    }
+
+    int i, j = 0;
+    for (i = start; i < start + length && i < sourceLength; i++){
+        bk[j++] = source[i];
+    }
+
+    bk[j] = '\0';
+    YC_StrCpy(source, bk);
+}
+
+/* 从文件路径中匹配文件名 */
+char YC_FAT_TakeFN(char * s,char *d)
+{
+    int i = 0;
+    char s_l = YC_StrLen(s);
+    char *s_end = s + s_l-1;
+
+    /* 匹配最后一个'/'所在位置，采用后序遍历 */
+    while(*s_end)
+    {
+        if((*s_end == '/')||(*s_end == '\\'))
         {
-            usr_read((unsigned char *)&fdis,START_SECTOR_OF_FILE(fdi_clu)+i,PER_SECSIZE);
+            if(i == 0)
+                return 0;
+            break;
+        }
+        s_end--;i++;
+    }
+    YC_StrCpy(d, s_end+1);
+    return 1;
+}
 
-            /* 从buffer进行文件名匹配 */
-            FDI_t *fdi = NULL;
-            fdi = (FDI_t *)&fdis.fdi[0];
+/* 从文件路径中匹配目录名 */
+char YC_FAT_TakeFP(char * s,char *d)
+{
+    int i = 0;
+    char s_l = YC_StrLen(s);
+    char *s_end = s + s_l-1;
 
-            /* 先检查文件属性是否为目录 */
-            if( 1 ) /* 不是目录且没有删除 */
-            {
-                /* 从当前扇区地址循环偏移固定字节取文件名 */
-                for( ; (unsigned int)fdi < (((unsigned int)&fdis)+PER_SECSIZE) ; fdi ++)
-                {   
-                    if( (0x10 != CHECK_FDI_ATTR(fdi)) && (0xE5 != fdi->fileName[0]) )
-                    {
-                        /* 将目录簇中的8*3文件名转化为字符串类型 */
-                        FDI_FileNameToString((char *)fdi->fileName, fileToMatch);
+    /* 匹配最后一个'/'所在位置，采用后序遍历 */
+    while(*s_end)
+    {
+        if((*s_end == '/')||(*s_end == '\\'))
+        {
+            if(i == 0)
+                return 0;
+            break;
+        }
+        s_end--;i++;
+    }
+    /* 文件位于根目录 */
+    if(0 == (s_l-i-1))
+    {
+        d[0] = *s; d[1] = '\0';
+        return 1;
+    }
+    YC_StrCpy_l(d, s, s_l-i-1);
+    return 1;
+}
 
-                        /* 匹配到文件名 */
-                        if( ycFilenameMatch(fileToMatch,filename) )
-                        {
-                            YC_FAT_AnalyseFDI(fdi,file);
-                            file->file_state = FILE_OPEN; return FOUND;
-                        }
-                    }
-                }
+/* 函数声明 */
+unsigned int YC_FAT_EnterDir(VOL_t *vol,char *dir);
+
+/* 在打开文件表中查找文件的共享节点，调用者持有oft_lock */
+/* 没有时以*end_clu为末簇占用一个空闲节点，end_clu为NULL时只查找 */
+static yc_fnode_t * YC_FAT_NodeGet(VOL_t *vol,fdi_loc_t *loc,FILE *fl,unsigned int *end_clu)
+{
+    yc_fnode_t *fn, *idle = NULL;
+
+    for(fn = yc_fnodes; fn < yc_fnodes + YC_OPEN_FILE_NUM; fn ++)
+    {
+        if(NULL == fn->vol)
+        {
+            if(NULL == idle)
+                idle = fn;
+            continue;
+        }
+        if((fn->vol == vol) && (fn->dir_loc.clu == loc->clu) &&
+           (fn->dir_loc.sec == loc->sec) && (fn->dir_loc.idx == loc->idx))
+        {
+            fn->ref ++;
+            return fn;
+        }
+    }
+    if((NULL == idle) || (NULL == end_clu))
+        return NULL;
+
+    idle->vol = vol;
+    idle->dir_loc = *loc;
+    idle->FirstClu = fl->FirstClu;
+    idle->fl_sz = fl->fl_sz;
+    idle->EndCluLeftSize = 0;
+    idle->ref = 1;
+    idle->RsvRunHead = idle->RsvRunNum = 0;
+    INIT_LIST_HEAD(&idle->WRCluChainList);
+    INIT_LIST_HEAD(&idle->RsvNode);
+    idle->EndClu = *end_clu;
+    return idle;
+}
+
+/* 从描述符位图分配最小的空闲描述符，调用者持有oft_lock，返回-1表示描述符已用完 */
+static int YC_FAT_FdAlloc(FILE *fl)
+{
+    unsigned int i, fd;
+
+    for(i = 0; i < (YC_OPEN_FILE_NUM + 31)/32; i ++)
+    {
+        if(0xffffffff == yc_fd_map[i])
+            continue;
+        fd = i*32 + __builtin_ctz(~yc_fd_map[i]);
+        if(fd >= YC_OPEN_FILE_NUM)
+            break;
+        yc_fd_map[i] |= 1u << (fd%32);
+        yc_fd_tab[fd] = fl;
+        return fd;
+    }
+    return -1;
+}
+
+/* 由描述符取得文件句柄，描述符未打开时返回NULL */
+FILE * YC_FAT_FileOfFd(unsigned int fd)
+{
+    FILE *fl = NULL;
+    if(fd >= YC_OPEN_FILE_NUM)
+        return NULL;
+    YC_LockWait(&oft_lock);
+    fl = yc_fd_tab[fd];
+    YC_Unlock(&oft_lock);
+    return fl;
+}
+
+#if YC_FILE2MEM
+/* ------------------------------------------ */
+/*              文件窗口映射至内存              */
+/* ------------------------------------------ */
+/* 频繁读改写的小文件（查找表、标定文件）整体或部分加载至内存，直接在内存中读写， */
+/* 修改后调用YC_FAT_MemDirty标记脏区，Writeback或关闭文件时只回写脏扇区 */
+/* 窗口限定在加载时的文件大小之内，不能用来追加数据 */
+
+#define MAP_NOT_ALIGN_ERR -1    /* 窗口偏移不是扇区对齐 */
+#define MAP_NO_MEM_ERR -2       /* 内存不足 */
+#define MAP_RANGE_ERR -3        /* 超出文件或窗口范围 */
+
+/* 由首簇前进到文件偏移off所在的簇 */
+static unsigned int YC_FAT_CluOfOff(VOL_t *vol,unsigned int clu,unsigned int off)
+{
+    unsigned int n = off/(PER_SECSIZE*vol->dbr.secPerClus);
+    while(n-- && (clu >= 2) && !IS_EOF(clu))
+        clu = YC_TakefileNextClu(vol,clu);
+    return clu;
+}
+
+/* 窗口与磁盘之间传输数据，wr为0时读入整个窗口，为1时只写出脏扇区并清除脏标记 */
+/* 扇区号连续（包括簇号连续时跨簇）的扇区合并为一次多扇区读写，末尾不满一扇区的部分经栈上扇区缓冲读改写 */
+static void YC_FAT_MemXfer(FILE *fl,J_UINT8 wr)
+{
+    VOL_t *vol = fl->vol;
+    unsigned char app_buf[PER_SECSIZE];
+    unsigned int spc = vol->dbr.secPerClus;
+    unsigned int nsec = (fl->MemLen + PER_SECSIZE - 1)/PER_SECSIZE;
+    unsigned int full = fl->MemLen/PER_SECSIZE;
+    unsigned int clu = YC_FAT_CluOfOff(vol,fl->node->FirstClu,fl->MemOff);
+    unsigned int cs = (fl->MemOff/PER_SECSIZE)%spc;
+    unsigned int i, sec, run_i = 0, run_sec = 0, run_n = 0;
+    J_UINT8 sel;
+
+    for(i = 0; i < nsec; i ++)
+    {
+        if((clu < 2) || IS_EOF(clu))
+            break;
+        sec = START_SECTOR_OF_FILE(vol,clu) + cs;
+        sel = !wr || (fl->pDirty[i/32] & (1u << (i%32)));
+        /* 当前连续段结束 */
+        if(run_n && (!sel || (i >= full) || (sec != run_sec + run_n)))
+        {
+            if(wr)
+                YC_DiskWrite(vol,fl->pMem + run_i*PER_SECSIZE,run_sec,run_n);
+            else
+                YC_DiskRead(vol,fl->pMem + run_i*PER_SECSIZE,run_sec,run_n);
+            run_n = 0;
+        }
+        if(sel && (i < full))
+        {
+            if(0 == run_n)
+            {
+                run_i = i;
+                run_sec = sec;
             }
+            run_n ++;
         }
-        fdi_clu = YC_TakefileNextClu(fdi_clu);
-    }while(!IS_EOF(fdi_clu));
-    
-    return NOTFOUND;
+        else if(sel)
+        {
+            /* 尾部不满一扇区，读出整个扇区后只改写窗口内的部分 */
+            /* 窗口之后的文件数据及文件末尾之后尚未缝合的追加数据保持不变 */
+            YC_DiskRead(vol,app_buf,sec,1);
+            if(wr)
+            {
+                memcpy(app_buf,fl->pMem + i*PER_SECSIZE,fl->MemLen - i*PER_SECSIZE);
+                YC_DiskWrite(vol,app_buf,sec,1);
+            }
+            else
+                memcpy(fl->pMem + i*PER_SECSIZE,app_buf,fl->MemLen - i*PER_SECSIZE);
+        }
+        /* 前进到下一扇区，最后一个扇区之后不再读FAT表 */
+        if((++ cs >= spc) && (i + 1 < nsec))
+        {
+            clu = YC_TakefileNextClu(vol,clu);
+            cs = 0;
+        }
+    }
+    if(run_n)
+    {
+        if(wr)
+            YC_DiskWrite(vol,fl->pMem + run_i*PER_SECSIZE,run_sec,run_n);
+        else
+            YC_DiskRead(vol,fl->pMem + run_i*PER_SECSIZE,run_sec,run_n);
+    }
+    if(wr)
+        memset(fl->pDirty,0,((nsec + 31)/32)*sizeof(J_UINT32));
+}
+
+/* 回写脏扇区并卸载窗口，调用者持有文件锁及卷写锁 */
+static void YC_FAT_MemUnmapNoLock(FILE *fl)
+{
+    if(NULL == fl->pMem)
+        return;
+    YC_FAT_MemXfer(fl,1);
+    if(fl->MemOwn)
+        tFreeHeapforeach(fl->pMem);
+    tFreeHeapforeach(fl->pDirty);
+    fl->pMem = NULL;
+    fl->pDirty = NULL;
+    fl->MemOff = fl->MemLen = 0;
+    fl->MemOwn = 0;
+}
+
+/* 将文件[off,off+len)加载至内存，len为0或超出文件大小时加载到文件末尾，off须扇区对齐 */
+/* mem_base为NULL时从堆中分配，加载后通过fl->pMem访问；已加载的窗口先回写并卸载 */
+static int YC_FAT_Load2Memory(FILE *fl,void *mem_base,unsigned int off,unsigned int len)
+{
+    unsigned int nsec;
+    VOL_t *vol;
+
+    if(NULL == fl)
+        return ARGVS_ERROR;
+    if(off % PER_SECSIZE)
+        return MAP_NOT_ALIGN_ERR;
+    YC_API_ENTER(YC_OP_MAP,YC_FL_VOL(fl));
+    if(!YC_Lock(&fl->lock))
+        return YC_LOCK_BUSY;
+    vol = fl->vol;
+    if(FILE_OPEN != fl->file_state)
+    {
+        YC_Unlock(&fl->lock);
+        return ARGVS_ERROR;
+    }
+    if(!YC_WriteLock(&vol->rw))
+    {
+        YC_Unlock(&fl->lock);
+        return YC_LOCK_BUSY;
+    }
+    YC_FAT_MemUnmapNoLock(fl);
+    if(off >= fl->node->fl_sz)
+    {
+        YC_WriteUnlock(&vol->rw);
+        YC_Unlock(&fl->lock);
+        return MAP_RANGE_ERR;
+    }
+    if((0 == len) || (len > fl->node->fl_sz - off))
+        len = fl->node->fl_sz - off;
+    nsec = (len + PER_SECSIZE - 1)/PER_SECSIZE;
+
+    fl->pDirty = tAllocHeapforeach(((nsec + 31)/32)*sizeof(J_UINT32));
+    if(NULL == mem_base)
+    {
+        mem_base = tAllocHeapforeach(len);
+        fl->MemOwn = 1;
+    }
+    if((NULL == fl->pDirty) || (NULL == mem_base))
+    {
+        if(fl->MemOwn && mem_base)
+            tFreeHeapforeach(mem_base);
+        if(fl->pDirty)
+            tFreeHeapforeach(fl->pDirty);
+        fl->pDirty = NULL;
+        fl->MemOwn = 0;
+        YC_WriteUnlock(&vol->rw);
+        YC_Unlock(&fl->lock);
+        return MAP_NO_MEM_ERR;
+    }
+    memset(fl->pDirty,0,((nsec + 31)/32)*sizeof(J_UINT32));
+    fl->pMem = (unsigned char *)mem_base;
+    fl->MemOff = off;
+    fl->MemLen = len;
+    YC_FAT_MemXfer(fl,0);
+    YC_WriteUnlock(&vol->rw);
+    YC_Unlock(&fl->lock);
+    return 0;
 }
 
-/* 从第n簇（目录起始簇）解析目录簇链文件目录信息 */
-SeekFile YC_FAT_MatchFile(unsigned int clu,FILE * file,char *filename)
+/* 回写窗口中的脏扇区，窗口保持加载 */
+static int YC_FAT_Writeback(FILE *fl)
 {
-    char DirToMatch[13]; /* 最后一字节为'\0' */
-    unsigned int fdi_clu = clu;
-    if((NULL == file) || (NULL == filename))
-        return NOTFOUND;
-
-    /* 读取首目录簇下的所有扇区 */
-    FDIs_t fdis;
-    do{
-        for(int i = 0;i < g_dbr[0].secPerClus;i++)
+    if(NULL == fl)
+        return ARGVS_ERROR;
+    YC_API_ENTER(YC_OP_MAP,YC_FL_VOL(fl));
+    if(!YC_Lock(&fl->lock))
+        return YC_LOCK_BUSY;
+    if((FILE_OPEN == fl->file_state) && fl->pMem)
+    {
+        if(!YC_WriteLock(&fl->vol->rw))
         {
-            usr_read((unsigned char *)&fdis,START_SECTOR_OF_FILE(fdi_clu)+i,PER_SECSIZE);
-
-            /* 从buffer进行文件名匹配 */
-            FDI_t *fdi = NULL;
-            fdi = (FDI_t *)&fdis.fdi[0];
-
-            /* 先检查文件属性是否为目录 */
-            if( 1 ) /* 不是目录且没有删除 */
-            {
-                /* 从当前扇区地址循环偏移固定字节取目录名 */
-                for( ; (unsigned int)fdi < (((unsigned int)&fdis)+PER_SECSIZE) ; fdi ++)
-                {   
-                    if( (0x10 != CHECK_FDI_ATTR(fdi)) && (0xE5 != fdi->fileName[0]) )
-                    {
-                        /* 将目录簇中的8*3文件名转化为字符串类型 */
-                        FDI_FileNameToString((char *)fdi->fileName, DirToMatch);
-
-                        /* 匹配到目录名 */
-                        if( ycFilenameMatch(DirToMatch,filename) )
-                        {
-                            YC_FAT_AnalyseFDI(fdi,file);
-                            file->file_state = FILE_OPEN;
-                            return FOUND;
-                        }
-                    }
-                }
-            }
+            YC_Unlock(&fl->lock);
+            return YC_LOCK_BUSY;
         }
-        fdi_clu = YC_TakefileNextClu(fdi_clu);
-    }while(!IS_EOF(fdi_clu));
-    
-    return NOTFOUND;
+        YC_FAT_MemXfer(fl,1);
+        YC_WriteUnlock(&fl->vol->rw);
+    }
+    YC_Unlock(&fl->lock);
+    return 0;
 }
 
-typedef struct FAT_Table
+/* 标记窗口中被修改的区域，off为文件偏移 */
+int YC_FAT_MemDirty(FILE *fl,unsigned int off,unsigned int len)
 {
-    J_UINT8 fat[FAT_SIZE];
-}FAT32_t;
+    unsigned int i, e;
 
-typedef struct FAT_TableSector
+    if((NULL == fl) || (0 == len))
+        return ARGVS_ERROR;
+    YC_LockWait(&fl->lock);
+    if((NULL == fl->pMem) || (off < fl->MemOff) || (off - fl->MemOff + len > fl->MemLen))
+    {
+        YC_Unlock(&fl->lock);
+        return MAP_RANGE_ERR;
+    }
+    i = (off - fl->MemOff)/PER_SECSIZE;
+    e = (off - fl->MemOff + len - 1)/PER_SECSIZE;
+    for(; i <= e; i ++)
+        fl->pDirty[i/32] |= 1u << (i%32);
+    YC_Unlock(&fl->lock);
+    return 0;
+}
+#endif
+
+/* 打开文件（雏形），flags为打开标志（YC_O_DIRECT） */
+/* 同一文件已被其他句柄打开时共用其节点，文件大小及簇链不再从磁盘重建 */
+FILE * YC_FAT_fopenEx(VOL_t *vol,FILE * f_op, char * filepath,J_UINT8 flags)
 {
-    FATFAT32_t_t fat_sec[PER_SECSIZE/FAT_SIZE];//128
-}FAT32_Sec_t;
+    FILE * file = NULL;
+    char fp[YC_PATH_MAXLEN];
+    unsigned int file_clu = 0;
+    fdi_loc_t loc;
+    yc_fnode_t *fn;
+    unsigned int end_clu;
+    int fd = -1;
+    if(f_op->file_state == FILE_OPEN)
+        return NULL;
+    YC_API_ENTER(YC_OP_FOPEN,vol);
 
-#define READ_OPS
+    /* 文件路径预处理 */
+    DelexcSpace(filepath,fp);
 
-/* 获取文件下一簇簇号 */
-unsigned int YC_TakefileNextClu(unsigned int fl_clus)
-{
-    unsigned int fat_n = 0;
-    FAT32_Sec_t fat_sec;
+    /* 传参合法性检查 */
+    /* 是否为..///或者.../或者.././//等不合法形式 */
 
-    /* 解析文件首簇在FAT表中的偏移 */
-    /* 先计算总偏移 */
-    unsigned int off_b = fl_clus * FAT_SIZE;
-    /* 再计算扇区偏移,得到FAT所在绝对扇区 */
-    unsigned int off_sec = off_b / PER_SECSIZE;
-    unsigned int t_rSec = off_sec + FatInitArgs_a[0].FAT1Sec; /* 默认取DBR0中的数据 */
+    /* 从路径匹配文件名 */
+    char f_n[YC_PATH_MAXLEN] = {0};
+    if(!YC_FAT_TakeFN(fp,f_n)) return NULL;
 
-    /* 取当前扇区所有FAT */
-    usr_read((unsigned char *)&fat_sec,t_rSec,PER_SECSIZE);
+    /* 从路径匹配目录名 */
+    char f_p[YC_PATH_MAXLEN] = {0};
+    if(!YC_FAT_TakeFP(fp,f_p)) return NULL;
 
-    FAT32_t * fat = (FAT32_t * )&fat_sec.fat_sec[0];
-    unsigned char off_fat = (off_b % PER_SECSIZE)/4;/* 计算在FAT中的偏移（以FAT大小为单位） */
-    fat += off_fat;
+    if(!IS_FILENAME_ILLEGAL(f_n))
+        return NULL;
 
-    /* 返回下一FAT */    
-    return fat_n = Byte2Value((unsigned char *)fat,FAT_SIZE);
-}
+    if(!YC_ReadLock(&vol->rw))
+        return NULL;
 
-/************************************************/
-/* 读取文件整条簇链（文件所有数据在所遍历的簇链中） */
-/* 传入参数：文件首簇                            */
-/* 传出参数：文件末簇                            */
-/* 效率低下，并且对磁盘寿命有影响                 */
-/***********************************************/
-/*  测试通过  */
-static int TakeFileClusList(unsigned int first_clu)
-{
-    unsigned int clu = first_clu;
+    /* 进入文件目录，这里假设是标准绝对路径寻找文件 */
+    file_clu = YC_FAT_EnterDir(vol,f_p);
+    if((0xffffffff == file_clu) || (0 == file_clu))
+    {
+        YC_ReadUnlock(&vol->rw);
+        return NULL;
+    }
 
-    /* 遍历整条簇链 */
-    do 
+    if(FOUND == YC_FAT_MatchFile(vol,file_clu,f_op,f_n,&loc))
     {
-        /* 添加打印信息 */
-        //YC_FAT_Printf("%d\r\n",clu);
-        clu = YC_TakefileNextClu(clu);
-    }while(!IS_EOF(clu));
+        /* 匹配成功，取得共享节点及描述符 */
+        YC_LockWait(&oft_lock);
+        fn = YC_FAT_NodeGet(vol,&loc,f_op,NULL);
+        if(NULL == fn)
+        {
+            /* 第一次打开，在oft_lock之外遍历簇链找出末簇（持有卷读锁，簇链不会变化），再加锁重新查找或占用空闲节点 */
+            YC_Unlock(&oft_lock);
+            end_clu = TakeFileClusList_Eftv(vol,f_op->FirstClu);
+            YC_LockWait(&oft_lock);
+            fn = YC_FAT_NodeGet(vol,&loc,f_op,&end_clu);
+        }
+        if(NULL != fn)
+        {
+            fd = YC_FAT_FdAlloc(f_op);
+            if((fd < 0) && (0 == --fn->ref))
+                fn->vol = NULL;
+        }
+        YC_Unlock(&oft_lock);
 
-    return clu;
+        if(fd >= 0)
+        {
+            file = f_op;
+            file->fd = fd;
+            file->node = fn;
+            file->vol = vol;
+            file->lock.v = 0;
+            /* 读位置从文件头开始 */
+            file->FirstClu = file->CurClus = fn->FirstClu;
+            file->CurOffSec = file->CurOffByte = 0;
+            file->fl_sz = file->left_sz = fn->fl_sz;
+            file->flags = flags;
+            /* 默认无缓冲，由setvbuf开启 */
+            file->pBuf = NULL;
+            file->BufSize = file->BufPos = file->BufLen = 0;
+            file->BufMode = YC_IONBF;
+            file->BufWr = 0;
+#if YC_FILE2MEM
+            file->load2memory = YC_FAT_Load2Memory;
+            file->Writeback = YC_FAT_Writeback;
+            file->pMem = NULL;
+            file->pDirty = NULL;
+            file->MemOff = file->MemLen = 0;
+            file->MemOwn = 0;
+#endif
+        }
+        else
+        {
+            f_op->file_state = FILE_CLOSE;
+        }
+    }
+    YC_ReadUnlock(&vol->rw);
+    return file;
 }
 
-/************************************************/
-/* 读取文件整条簇链（文件所有数据在所遍历的簇链中） */
-/* 传入参数：文件首簇                            */
-/* 传出参数：文件末簇                            */
-/* 效率较高，有效降低磁盘读写次数                 */
-/***********************************************/
-static int TakeFileClusList_Eftv(unsigned int first_clu)
+FILE * YC_FAT_fopen(VOL_t *vol,FILE * f_op, char * filepath)
 {
-    unsigned int clu = first_clu;
-
-    /* 遍历整条簇链 */
-    do 
-    {
-        /* 添加打印信息 */
-        //YC_FAT_Printf("%d\r\n",clu);
-        clu = YC_TakefileNextClu(clu);
-    }while(!IS_EOF(clu));
-
-    return clu;
+    return YC_FAT_fopenEx(vol,f_op,filepath,0);
 }
 
-/* 跨扇区？ */
-#define READ_EOS(f) (0 == (f->fl_sz-f->left_sz)%PER_SECSIZE)
-//#define READ_EOC(f) (0 == (f->fl_sz-f->left_sz)%PER_SECSIZE)
+static int YC_FAT_BufFlush(FILE *fl,J_UINT8 wait);
 
-static unsigned char app_buf[PER_SECSIZE];
-static unsigned int bk = 0;
-/* 待测 */
-/* 数据读取函数，不考虑参数len长度可能导致的数据越界 */
-J_UINT32 YC_ReadDataNoCheck(FILE* fileInfo,unsigned int len,unsigned char * buffer)
+/* 直接读：读位置及长度须扇区对齐，整扇区直接读入用户缓冲，读位置始终保持扇区对齐 */
+/* 文件末尾不满一扇区的部分不经直接读返回，追加写满该扇区后再读出，需要时以普通句柄读取 */
+static J_UINT32 YC_FAT_ReadDirect(FILE *fl,unsigned int len,unsigned char *buf)
 {
-    if(FILE_OPEN != fileInfo->file_state)
+    unsigned int t;
+
+    if(fl->CurOffByte || (len % PER_SECSIZE))
         return 0;
-    FILE1 * f_r;
-    unsigned int l_ilegal = 0;  /* 已读的有效数据长度 */
-    char i;
-    unsigned int n_clu = fileInfo->CurClus; /* 初始簇 */
-    unsigned int t_rSize = MIN(len, fileInfo->left_sz);/* 需要读的数据大小 */
-	unsigned int t_rb = t_rSize;/* 备份 */
-    unsigned int t_rSec = 0, t_rClu = 0;
-    unsigned int Secleft = 0;
-	
-    if(!t_rSize) return 0;
-	/* 需要读的扇区个数 */
-	t_rSec = ( ( PER_SECSIZE*((fileInfo->fl_sz - fileInfo->left_sz + t_rSize)/PER_SECSIZE) )\
-        - ( PER_SECSIZE*((fileInfo->fl_sz - fileInfo->left_sz)/PER_SECSIZE) ) )/PER_SECSIZE;
-    if((fileInfo->fl_sz - fileInfo->left_sz + t_rSize)%PER_SECSIZE)
-    {
-		t_rSec += 1;
-    }
-    /* 需要读的簇个数 */
-	t_rClu = ( ( PER_SECSIZE*g_dbr[0].secPerClus*((fileInfo->fl_sz - fileInfo->left_sz + t_rSize)/(PER_SECSIZE*g_dbr[0].secPerClus)) )\
-        - ( PER_SECSIZE*g_dbr[0].secPerClus*((fileInfo->fl_sz - fileInfo->left_sz)/(PER_SECSIZE*g_dbr[0].secPerClus)) ) )/(PER_SECSIZE*g_dbr[0].secPerClus);
-    if((fileInfo->fl_sz - fileInfo->left_sz + t_rSize)%(PER_SECSIZE*g_dbr[0].secPerClus))
-    {
-		t_rClu += 1;
-    }
-    //t_rClu --;
-#if 1    /* 扇区读 */
-    /* 找出当前簇内的首扇区（扇区偏移） */
-    if(t_rSec)
-        Secleft =  g_dbr[0].secPerClus - fileInfo->CurOffSec;
-    Secleft = (Secleft <= t_rSec)?Secleft : t_rSec;
-    do 
+    YC_FAT_SyncSize(fl);
+    t = MIN(len, fl->left_sz);
+    return YC_ReadDataNoCheck(fl,t - t%PER_SECSIZE,buf);
+}
+
+/* 经用户态缓冲读取：缓冲中有数据时直接拷贝，缓冲为空时预读一整块，剩余请求不小于缓冲区时直接读入用户缓冲 */
+static J_UINT32 YC_FAT_BufRead(FILE *fl,unsigned int len,unsigned char *buf)
+{
+    unsigned int done = 0, n;
+
+    while(done < len)
     {
-        if(Secleft)
-		{
-            /* 下面的逻辑都是当前簇读 */
-            for(i = 0; i < Secleft; i ++)
-            {
-                /* 取当前扇区数据 */
-				SDCARD_ReadBlocks(&stcSdhandle,START_SECTOR_OF_FILE(n_clu)+fileInfo->CurOffSec , 1,app_buf, PER_SECSIZE);
-                //memcpy((unsigned char *)buffer+l_ilegal,app_buf+fileInfo->CurOffByte,MIN(PER_SECSIZE-fileInfo->CurOffByte,t_rSize));
-				memset((unsigned char *)buffer,0,PER_SECSIZE);
-				memcpy((unsigned char *)buffer,app_buf+fileInfo->CurOffByte,MIN(PER_SECSIZE-fileInfo->CurOffByte,t_rSize));
-				
-				l_ilegal += MIN(PER_SECSIZE-fileInfo->CurOffByte,t_rSize);      /* 迄今所读出的有效数据大小 */
-				
-				if(t_rSize <= PER_SECSIZE) bk = t_rSize;
-				
-                t_rSize = t_rSize - MIN(PER_SECSIZE-fileInfo->CurOffByte,t_rSize);/* 剩余数据的总大小 */
-                
-                if(!t_rSize){ 
-					/* 锚定起始字节 */
-					fileInfo->CurOffByte += bk;
-					if(PER_SECSIZE == fileInfo->CurOffByte)
-					{
-						fileInfo->CurOffSec ++;
-						if(g_dbr[0].secPerClus-1 == fileInfo->CurOffSec) 
-							fileInfo->CurOffSec = 0;
-						fileInfo->CurOffByte = 0;
-					}
-                    break;
-                }
-                /* 重新锚定起始字节 */
-                fileInfo->CurOffByte = 0;
-				/* 重新锚定起始扇区 */
-				fileInfo->CurOffSec ++;
-				if(g_dbr[0].secPerClus-1 == fileInfo->CurOffSec) 
-					fileInfo->CurOffSec = 0;
-            }
-			
-            /* 重新锚定起始簇 */
-            t_rSec = t_rSec - Secleft;
-            if(t_rSec){//剩下的需要读的总扇区大于0
-                n_clu = YC_TakefileNextClu(n_clu);
-                fileInfo->CurClus = n_clu;
-                Secleft = (t_rSec >= g_dbr[0].secPerClus)?(g_dbr[0].secPerClus):(t_rSec);
-            }else{
-                break;
-            }
-            /* 重新锚定起始扇区 */
-            fileInfo->CurOffSec = START_SECTOR_OF_FILE(n_clu);
+        if(fl->BufPos < fl->BufLen)
+        {
+            n = MIN(len - done, fl->BufLen - fl->BufPos);
+            memcpy(buf + done,fl->pBuf + fl->BufPos,n);
+            fl->BufPos += n;
+            done += n;
+            continue;
         }
-		else
-		{
+        if(len - done >= fl->BufSize)
+        {
+            done += YC_ReadDataNoCheck(fl,len - done,buf + done);
             break;
         }
-    }while(!IS_EOF(n_clu));
-    /* 可读扇区=0 进行边界处理 */
-    if(READ_EOS(fileInfo) && (fileInfo->left_sz == 0)){
-        fileInfo->CurClus = fileInfo->FirstClu;
-        fileInfo->CurOffSec = 0;
-    }else if(1){
-        ;
+        fl->BufPos = 0;
+        fl->BufLen = YC_ReadDataNoCheck(fl,fl->BufSize,fl->pBuf);
+        if(0 == fl->BufLen)
+            break;
     }
-#else    /* 簇读 */
-	
-#endif
-	fileInfo->left_sz -= t_rb;
+    return done;
 }
 
-/* 小写转大写 */
-J_UINT8 Lower2Up(J_UINT8 ch)
+/* 读文件前加文件锁及卷读锁，缓冲中积累有写数据时先写出，成功返回1，YC_LOCK_TRY模式下被占用或文件未打开返回0 */
+static J_UINT8 YC_FAT_ReadBegin(FILE *fl)
 {
-    J_UINT8 Upch = 0xff;
-    if((ch >= 0x61) && (ch <= 0x7a))
-         Upch = *((J_UINT8 *)&ch) - 0x20;
-    return Upch;
+    VOL_t *vol;
+    int ret;
+    if(!YC_Lock(&fl->lock))
+        return 0;
+    vol = fl->vol;
+    if(FILE_OPEN != fl->file_state)
+    {
+        YC_Unlock(&fl->lock);
+        return 0;
+    }
+    if(fl->BufWr)
+    {
+        ret = YC_FAT_BufFlush(fl,0);
+        if(0 != ret)
+        {
+            YC_Unlock(&fl->lock);
+            return 0;
+        }
+        fl->BufWr = 0;
+        fl->BufPos = fl->BufLen = 0;
+    }
+    if(!YC_ReadLock(&vol->rw))
+    {
+        YC_Unlock(&fl->lock);
+        return 0;
+    }
+    return 1;
 }
 
-/* 大写转小写 */
-J_UINT8 Up2Lower(J_UINT8 ch)
+/* 按缓冲模式读取，直接I/O句柄不经缓冲，调用者持有文件锁及卷读锁 */
+static J_UINT32 YC_FAT_ReadNoLock(FILE *fl,unsigned int len,unsigned char *buf)
 {
-    J_UINT8 Lowch = 0xff;
-    if((ch >= 0x41) && (ch <= 0x5a))
-         Lowch = *((J_UINT8 *)&ch) + 0x20;
-    return Lowch;
+    if(fl->flags & YC_O_DIRECT)
+        return YC_FAT_ReadDirect(fl,len,buf);
+    if((YC_IONBF == fl->BufMode) || (NULL == fl->pBuf))
+        return YC_ReadDataNoCheck(fl,len,buf);
+    return YC_FAT_BufRead(fl,len,buf);
 }
 
-/* 子字符串定位 */
-J_UINT8 FindSubStr(char *str,char *substr,unsigned char pos)
+/* 读取文件，返回实际读出的字节数，YC_LOCK_TRY模式下文件或卷被占用时返回0 */
+J_UINT32 fread(FILE * f_rd, unsigned int len, void *buffer)
 {
-    J_UINT8 i = pos,j = 0,lens = YC_StrLen(str),lent = YC_StrLen(substr);
-    while((i < lens) && (j < lent))
+    J_UINT32 n;
+    if((NULL == f_rd)||(0 == len)||(NULL == buffer))
+        return 0;
+    YC_API_ENTER(YC_OP_FREAD,YC_FL_VOL(f_rd));
+    if(!YC_FAT_ReadBegin(f_rd))
+        return 0;
+    n = YC_FAT_ReadNoLock(f_rd,len,buffer);
+    YC_ReadUnlock(&f_rd->vol->rw);
+    YC_Unlock(&f_rd->lock);
+    return n;
+}
+
+/* 分散读：依次读满各数据段，文件读完时提前结束，返回读出的总字节数 */
+/* 各段中对齐的整扇区直接读入段内存，只有跨段的扇区经扇区缓冲拷贝 */
+J_UINT32 readv(FILE *fl,const yc_iovec_t *iov,int iovcnt)
+{
+    J_UINT32 n, total = 0;
+    int i;
+    if((NULL == fl)||(NULL == iov)||(iovcnt <= 0))
+        return 0;
+    YC_API_ENTER(YC_OP_FREAD,YC_FL_VOL(fl));
+    if(!YC_FAT_ReadBegin(fl))
+        return 0;
+    for(i = 0; i < iovcnt; i ++)
     {
-        if((str[i] == substr[j]) || ('?' == substr[j])){
-            i ++; j ++;
-        }
-        else{
-            i = i - j + 1; j = 0;
-        }
+        if(0 == iov[i].iov_len)
+            continue;
+        n = YC_FAT_ReadNoLock(fl,iov[i].iov_len,iov[i].iov_base);
+        total += n;
+        if(n < iov[i].iov_len)
+            break;
     }
-    if(j == lent) 
-        return (i - lent);
-    else 
-        return 0xff;
+    YC_ReadUnlock(&fl->vol->rw);
+    YC_Unlock(&fl->lock);
+    return total;
 }
 
-/* 文件通配 */
-J_UINT8 FileNameMatch(unsigned char *s,unsigned char *t)
+void YC_FAT_RsvRelease(yc_fnode_t *fl);
+
+/* 关闭文件，写出缓冲中的数据及内存窗口中的脏扇区，释放描述符，最后一个句柄关闭时归还未使用的预留簇并释放共享节点 */
+void fclose(FILE * f_cl)
 {
-    J_UINT8 i = 0, j = 0, lens = YC_StrLen(s), lent = YC_StrLen(t), flag = 0;
-    J_UINT8 buf[10];
-    J_UINT8 bufp = 0;
-    while((j < lent) && ('*' != t[j]))
+    yc_fnode_t *fn;
+    if(NULL == f_cl) return;
+    YC_API_ENTER(YC_OP_FCLOSE,YC_FL_VOL(f_cl));
+    YC_LockWait(&f_cl->lock);
+    if(FILE_OPEN == f_cl->file_state)
     {
-        buf[bufp] = Lower2Up(t[j]);
-        /* 大小写转化失败 */
-        if(buf[bufp] == 0xff) return 1;
-        bufp ++; j ++;
+        fn = f_cl->node;
+        if(f_cl->BufWr)
+            YC_FAT_BufFlush(f_cl,1);
+        YC_WriteLockWait(&f_cl->vol->rw);
+#if YC_FILE2MEM
+        YC_FAT_MemUnmapNoLock(f_cl);
+#endif
+        YC_LockWait(&oft_lock);
+        if(0 == --fn->ref)
+        {
+            YC_FAT_RsvRelease(fn);
+            fn->vol = NULL;
+        }
+        yc_fd_map[f_cl->fd/32] &= ~(1u << (f_cl->fd%32));
+        yc_fd_tab[f_cl->fd] = NULL;
+        YC_Unlock(&oft_lock);
+        YC_WriteUnlock(&f_cl->vol->rw);
     }
-    buf[bufp] = '\0';
-    if(FindSubStr(s, buf, 0) != 0) return 0;
-    i = bufp;
-    while(1)
+    f_cl->pBuf = NULL;
+    f_cl->BufWr = 0;
+    f_cl->BufPos = f_cl->BufLen = 0;
+    f_cl->node = NULL;
+    f_cl->CurClus = f_cl->CurOffByte = f_cl->CurOffSec = 0;
+    f_cl->file_state = FILE_CLOSE;
+    f_cl->FirstClu = 0;
+    f_cl->fl_sz = 0;
+    f_cl->left_sz = 0;
+    YC_Unlock(&f_cl->lock);
+}
+
+/* 从第n号簇（某一目录开始簇）开始匹配目录，并返回目录首簇 */
+/* 配合enterdir函数使用 */
+unsigned int YC_FAT_MatchDirInClus(VOL_t *vol,unsigned int clu,char *dirname)
+{
+    dirscan_t sc = {0};
+    /* 目录起始簇号 */
+    unsigned int dir_clu = 0;
+
+    sc.name = dirname;
+    if(FOUND != YC_FAT_ScanDir(vol,clu,&sc))
+        return 0;
+
+    /* 是目录 */
+    if(!(TP_DIR & sc.fdi.attribute))
+        return 0;
+
+    dir_clu =  Byte2Value((unsigned char *)&sc.fdi.startClusLower,2);
+    dir_clu |=  (Byte2Value((unsigned char *)&sc.fdi.startClusUper,2) << 16);
+    /* ..目录项簇号为0时指向根目录 */
+    return dir_clu ? dir_clu : ROOT_CLUS;
+}
+
+/* 获取当前工作目录 */
+void YC_FAT_getPWD(VOL_t *vol,unsigned char * p)
+{
+    for(unsigned int i = 0;i < YC_StrLen(vol->pwd);i ++)
+        {*p = (vol->pwd[i]); p ++;}
+}
+
+/* 目录解析，保存'/'或者'\\'之后的第一个目录 */
+/* 将dir_s下的第一个/（斜杠）或者\\（反斜杠）后的子目录 */
+/* 斜杠的ascii码为0x2f(47)，用'/'表示，占用一个字节*/
+/* 反斜杠的ascii码为0x5c(92)，用'\\'表示，占用一个字节 */
+/* 根目录没有./和../目录项，根目录下的目录的../项的簇号为2，也就是根目录簇号为2 */
+/* 输入为标准的/dir1/dir2/dir3格式或者.././dir/dir1/.等格式 */
+unsigned char YC_FAT_ParseDir(char * dir_s,char * dir_d)
+{
+    int i = 0;char *p;
+    int len = YC_StrLen(dir_s);
+    if(
+        ( '/' == (*(dir_s)) ) || ( '\\' == (*(dir_s+1)) )
+    )
     {
-        while((j < lent) && ('*' == t[j])) j ++;
-        if(j == lent) return 1;
-        bufp = 0;
-        while((j < lent) && ('*' != t[j]))
+        p = dir_s+1;
+        while((*p != '\0')&&(*p != '/')&&(*p != '\\'))
         {
-            buf[bufp] = Lower2Up(t[j]);
-            /* 大小写转化失败 */
-            if(buf[bufp] == 0xff) return 1;
-            bufp ++; j ++;
+            dir_d[i++] = *p;
+            p++;
         }
-        buf[bufp] = '\0';
-        if(j == lent)
+        dir_d[i] = '\0';
+    }
+    else if('.' == *dir_s){
+        p = dir_s;
+        while((*p != '\0')&&(*p != '/')&&(*p != '\\'))
         {
-            if(FindSubStr(s, buf, i) != (lens - bufp)) return 0;
-            return 1;
+            dir_d[i++] = *p;
+            p++;
         }
-        i = FindSubStr(s, buf, i);
-        if(0xff == i) return 0;
-        i += bufp;
+        dir_d[i] = '\0';
+        return i-1;
     }
+    return i;
 }
 
-/* 文件路径预处理，剔除无效空格字符 */
-void DelexcSpace(char * s,char * d)
+/* 毫秒节拍，由单调时钟换算，YC_OS_ClockNs未移植（恒为0）时超时检测不会触发 */
+unsigned int YC_TakeSystick(void)
 {
-    int i = 0,j = 0;
-    int sp_l = 0;
-    char * s1 = s;
-    while(' ' == *s1)
-    {
-        s1 += 1; sp_l++;
+    return (unsigned int)(YC_OS_ClockNs()/1000000);
+}
+
+/* 自节拍n_t起是否已超过tot毫秒 */
+#define IS_TIMEOUT(n_t,tot) ((YC_TakeSystick() - (n_t)) > (tot))
+
+/* 目录索引错误码，超时与目录不存在同样返回0xffffffff，调用者只需检查该值 */
+#define ENTER_ROOT_PDIR_ERROR 0xffffffff
+#define ENTER_DIR_TIMEOUT_ERROR 0xffffffff
+
+/* 按层级进入目录，调用者持有卷读锁或写锁，失败返回0xffffffff */
+unsigned int YC_FAT_EnterDir(VOL_t *vol,char *dir)
+{
+    unsigned int dir_clu = 0xffffffff;
+
+    char dir_temp[YC_NAME_MAXLEN + 1] = {0};
+    unsigned char i = 0;
+
+    /* 锚定起始目录簇，.和..均从当前工作目录开始 */
+    if(*dir == '.')
+        dir_clu = vol->work_clu;
+    else if((*dir == '\\')||(*dir == '/'))  {
+        dir_clu = ROOT_CLUS;
     }
-    for(i = sp_l;i < YC_StrLen(s);i++)
+
+#if YC_TIMEOUT_SWITCH
+    unsigned int tick_now = YC_TakeSystick();
+#endif
+
+    /* 递归式遍历子目录 */
+    for( ; ; )
     {
-        d[j] = s[i];j++;
+        if(!YC_StrLen(dir))
+            break;
+        {
+            i = YC_FAT_ParseDir(dir,dir_temp);
+            /* 路径末尾的'/' */
+            if('\0' == *dir_temp)
+                break;
+            if(((ROOT_CLUS == dir_clu) && ('.' == *dir_temp) && ('.' == *(dir_temp+1)))){
+                return ENTER_ROOT_PDIR_ERROR;/* 非法目录 */
+            }
+            /* .为当前目录，根目录下没有.目录项 */
+            if(('.' == *dir_temp) && ('\0' == *(dir_temp+1))){
+                YC_SubStr(dir, i+1, YC_PATH_MAXLEN);
+                continue;
+            }
+            dir_clu = YC_FAT_MatchDirInClus(vol,dir_clu,dir_temp);
+            /* 目录不存在 */
+            if(0 == dir_clu)
+                return 0xffffffff;
+            YC_SubStr(dir, i+1, YC_PATH_MAXLEN);
+        }
+        /* 遍历超时退出，返回错误码 */
+#if YC_TIMEOUT_SWITCH
+        if(IS_TIMEOUT(tick_now,1000))
+            return ENTER_DIR_TIMEOUT_ERROR;
+#endif
     }
-    d[j] = '\0';
+    return dir_clu;
 }
 
-/* 字符串复制1 */
-void YC_StrCpy(char *_tar, char *_src)
+/* CD脚本 */
+/* 待测试 */
+/* 修改当前工作目录加卷写锁，YC_LOCK_TRY模式下卷被占用时返回0xffffffff */
+unsigned int YC_CD(VOL_t *vol,char *dir)
 {
-	do
-	{
-		*_tar++ = *_src;
-	}
-	while (*_src++);
-}
+    unsigned int cc = 0xffffffff;
+    YC_API_ENTER(YC_OP_CD,vol);
+    if(!YC_WriteLock(&vol->rw))
+        return cc;
+    cc = YC_FAT_EnterDir(vol,dir);
 
-/* 字符串复制2 */
-void YC_StrCpy_l(char *_tar, char *_src, int len)
-{
-	do
-	{
-		*_tar++ = *_src;
-        len = len - 1;
-	}
-	while ((*_src++) && len);
+    if(cc != 0xffffffff)
+        vol->work_clu = cc;
+    YC_WriteUnlock(&vol->rw);
+    return cc;
 }
 
-/* 内存设置 */
-void *YC_Memset(void *dest, int set, unsigned len)
-{
-	if (dest == NULL || len < 0)
-	{
-		return NULL;
-	}
-	char *pdest = (char *)dest;
-	while (len-->0)
-	{
-		*pdest++ = set;
-	}
-	return dest;
-}
+/* ------------------------------------------ */
+/*        directory stream operations         */
+/* ------------------------------------------ */
 
-/* 字符串自截断 */
-/* start是丢弃前start个字节 */
-/* 传参source不能被const修饰 */
-void YC_SubStr(char *source, int start, int length)
+#define DIR_OK 0
+#define DIR_END -1
+#define DIR_NOT_FOUND -2
+
+/* 打开目录，目录句柄由调用者提供 */
+DIR * YC_FAT_opendir(VOL_t *vol,DIR * dp, char * dirpath)
 {
-    int sourceLength = YC_StrLen(source);
-    /* Tip：这里直接定义一个50Bytes的数组不严谨，建议采用malloc机制 */
-    char bk[50] = {0};
-    if (start < 0 || start >= sourceLength || length <= 0){
-        source[0] = '\0';
-        return;
-    }
+    char fp[YC_PATH_MAXLEN];
+    unsigned int dir_clu;
+    YC_API_ENTER(YC_OP_DIR,vol);
 
-    int i, j = 0;
-    for (i = start; i < start + length && i < sourceLength; i++){
-        bk[j++] = source[i];
-    }
+    if((NULL == dp) || (NULL == dirpath))
+        return NULL;
+    if(FILE_OPEN == dp->dir_state)
+        return NULL;
 
-    bk[j] = '\0';
-    YC_StrCpy(source, bk);
+    /* 路径预处理，EnterDir会修改传入的路径 */
+    DelexcSpace(dirpath,fp);
+
+    if(!YC_ReadLock(&vol->rw))
+        return NULL;
+    dir_clu = YC_FAT_EnterDir(vol,fp);
+    YC_ReadUnlock(&vol->rw);
+    if((0xffffffff == dir_clu) || (0 == dir_clu))
+        return NULL;
+
+    dp->vol = vol;
+    dp->FirstClu = dp->CurClus = dir_clu;
+    dp->CurOffSec = dp->CurOffFdi = 0;
+    dp->SecLoaded = 0;
+    dp->eod = 0;
+#if YC_LFN_ON
+    dp->lfn_ok = 0;
+    dp->lfn.want_len = 0;
+    YC_FAT_LFNReset(&dp->lfn);
+#endif
+    dp->dir_state = FILE_OPEN;
+    return dp;
 }
 
-/* 从文件路径中匹配文件名 */
-char YC_FAT_TakeFN(char * s,char *d)
+/* 取目录流中下一个有效目录项（原始8*3格式），目录结束返回NULL */
+/* 目录扇区按顺序读取，每个扇区只读一次，返回的指针指向目录句柄中的扇区缓冲 */
+/* 目录项带有完整长文件名时dp->lfn_ok置位，长文件名保存在dp->lfn中 */
+static FDI_t * YC_FAT_DirNextFDI(DIR * dp)
 {
-    int i = 0;
-    char s_l = YC_StrLen(s);
-    char *s_end = s + s_l-1;
+    VOL_t *vol = dp->vol;
+    FDI_t *fdi;
 
-    /* 匹配最后一个'/'所在位置，采用后序遍历 */
-    while(*s_end)
+    while(!dp->eod)
     {
-        if((*s_end == '/')||(*s_end == '\\'))
+        /* 读入当前目录扇区 */
+        if(!dp->SecLoaded)
         {
-            if(i == 0)
-                return 0;
-            break;
+            YC_DiskRead(vol,(unsigned char *)&dp->fdis,START_SECTOR_OF_FILE(vol,dp->CurClus)+dp->CurOffSec,1);
+            YC_STAT_ADD(vol,YC_ST_DIR_SEC,1);
+            dp->SecLoaded = 1;
+        }
+
+        while(dp->CurOffFdi < (short)FDI_PER_SEC)
+        {
+            fdi = &dp->fdis.fdi[dp->CurOffFdi ++];
+
+            /* 目录项结束 */
+            if(0x00 == fdi->fileName[0])
+            {
+                dp->eod = 1;
+                return NULL;
+            }
+#if YC_LFN_ON
+            /* 已删除项中断长文件名，长文件名项逐项收集 */
+            if(0xE5 == fdi->fileName[0])
+            {
+                YC_FAT_LFNReset(&dp->lfn);
+                continue;
+            }
+            if(ATTR_LFN == CHECK_FDI_ATTR(fdi))
+            {
+                YC_FAT_LFNFeed(&dp->lfn,(LFN_t *)fdi);
+                continue;
+            }
+            dp->lfn_ok = (LFN_OK == YC_FAT_LFNEnd(&dp->lfn,fdi));
+            if(VOLUME & CHECK_FDI_ATTR(fdi))
+                continue;
+#else
+            /* 跳过已删除项、长文件名项和卷标 */
+            if((0xE5 == fdi->fileName[0]) || (ATTR_LFN == CHECK_FDI_ATTR(fdi)) || (VOLUME & CHECK_FDI_ATTR(fdi)))
+                continue;
+#endif
+            return fdi;
+        }
+
+        /* 当前扇区已读完，锚定下一扇区 */
+        dp->CurOffFdi = 0;
+        dp->SecLoaded = 0;
+        dp->CurOffSec ++;
+        if(vol->dbr.secPerClus == dp->CurOffSec)
+        {
+            dp->CurOffSec = 0;
+            dp->CurClus = YC_TakefileNextClu(vol,dp->CurClus);
+            if(IS_EOF(dp->CurClus))
+                dp->eod = 1;
         }
-        s_end--;i++;
     }
-    YC_StrCpy(d, s_end+1);
-    return 1;
+    return NULL;
 }
 
-/* 从文件路径中匹配目录名 */
-char YC_FAT_TakeFP(char * s,char *d)
+/* 解码目录流当前目录项，带长文件名时以UTF-8长文件名作为文件名 */
+static void YC_FAT_DirDecode(DIR * dp, FDI_t * fdi, dirent_t * ent)
 {
-    int i = 0;
-    char s_l = YC_StrLen(s);
-    char *s_end = s + s_l-1;
+    YC_FAT_DecodeFDI(fdi,ent);
+#if YC_LFN_ON
+    if(dp->lfn_ok)
+        YC_Utf16ToUtf8(dp->lfn.name,dp->lfn.len,ent->name,YC_NAME_MAXLEN);
+#endif
+}
 
-    /* 匹配最后一个'/'所在位置，采用后序遍历 */
-    while(*s_end)
+/* 批量读取目录项，一次最多返回n个解码后的目录项，返回实际读出的目录项数目 */
+int YC_FAT_readdir_n(DIR * dp, dirent_t * ents, int n)
+{
+    int cnt = 0;
+    FDI_t *fdi;
+
+    if((NULL == dp) || (NULL == ents) || (n <= 0))
+        return 0;
+    if(FILE_OPEN != dp->dir_state)
+        return 0;
+    YC_API_ENTER(YC_OP_DIR,dp->vol);
+    if(!YC_ReadLock(&dp->vol->rw))
+        return 0;
+
+    while((cnt < n) && (NULL != (fdi = YC_FAT_DirNextFDI(dp))))
     {
-        if((*s_end == '/')||(*s_end == '\\'))
-        {
-            if(i == 0)
-                return 0;
-            break;
-        }
-        s_end--;i++;
+        YC_FAT_DirDecode(dp,fdi,&ents[cnt ++]);
     }
-    YC_StrCpy_l(d, s, s_l-i-1);
-    return 1;
+    YC_ReadUnlock(&dp->vol->rw);
+    return cnt;
 }
 
-/* 函数声明 */
-unsigned int YC_FAT_EnterDir(char *dir);
+/* 读取一个目录项 */
+int YC_FAT_readdir(DIR * dp, dirent_t * ent)
+{
+    return (1 == YC_FAT_readdir_n(dp,ent,1)) ? DIR_OK : DIR_END;
+}
 
-/* 打开文件（雏形） */
-FILE * YC_FAT_fopen(FILE * f_op, char * filepath)
+/* 目录流复位至首个目录项 */
+void YC_FAT_rewinddir(DIR * dp)
 {
-    FILE * file = NULL;
-    char fp[50];
-    unsigned int file_clu = 0;
-    if(f_op->file_state == FILE_OPEN)
-        return NULL;
+    if((NULL == dp) || (FILE_OPEN != dp->dir_state))
+        return;
+    dp->CurClus = dp->FirstClu;
+    dp->CurOffSec = dp->CurOffFdi = 0;
+    dp->SecLoaded = 0;
+    dp->eod = 0;
+#if YC_LFN_ON
+    YC_FAT_LFNReset(&dp->lfn);
+#endif
+}
+
+/* 关闭目录 */
+void YC_FAT_closedir(DIR * dp)
+{
+    if(NULL == dp) return;
+    dp->FirstClu = dp->CurClus = 0;
+    dp->CurOffSec = dp->CurOffFdi = 0;
+    dp->SecLoaded = 0;
+    dp->dir_state = FILE_CLOSE;
+}
+
+/* 获取文件或目录的目录项信息 */
+int YC_FAT_stat(VOL_t *vol,char * filepath, dirent_t * st)
+{
+    dirscan_t sc = {0};
+    char fp[YC_PATH_MAXLEN];
+    char f_n[YC_PATH_MAXLEN] = {0}; char f_p[YC_PATH_MAXLEN] = {0};
+    unsigned int dir_clu;
+
+    if((NULL == filepath) || (NULL == st))
+        return ARGVS_ERROR;
+    YC_API_ENTER(YC_OP_DIR,vol);
 
     /* 文件路径预处理 */
     DelexcSpace(filepath,fp);
+    if(!YC_FAT_TakeFN(fp,f_n)) return ARGVS_ERROR;
+    if(!YC_FAT_TakeFP(fp,f_p)) return ARGVS_ERROR;
 
-    /* 传参合法性检查 */
-    /* 是否为..///或者.../或者.././//等不合法形式 */
+    if(!YC_ReadLock(&vol->rw))
+        return YC_LOCK_BUSY;
+    dir_clu = YC_FAT_EnterDir(vol,f_p);
+    if((0xffffffff == dir_clu) || (0 == dir_clu))
+    {
+        YC_ReadUnlock(&vol->rw);
+        return DIR_NOT_FOUND;
+    }
 
-    /* 从路径匹配文件名 */
-    char f_n[50] = {0};
-    if(!YC_FAT_TakeFN(fp,f_n)) return NULL;
+    /* 单次顺序遍历父目录 */
+    sc.name = f_n;
+#if YC_LFN_ON
+    sc.lfn_all = 1;
+#endif
+    if(FOUND != YC_FAT_ScanDir(vol,dir_clu,&sc))
+    {
+        YC_ReadUnlock(&vol->rw);
+        return DIR_NOT_FOUND;
+    }
+    YC_ReadUnlock(&vol->rw);
 
-    /* 从路径匹配目录名 */
-    char f_p[50] = {0};
-    if(!YC_FAT_TakeFP(fp,f_p)) return NULL;
+    YC_FAT_DecodeFDI(&sc.fdi,st);
+#if YC_LFN_ON
+    if(sc.lfn_ok)
+        YC_Utf16ToUtf8(sc.lfn.name,sc.lfn.len,st->name,YC_NAME_MAXLEN);
+#endif
+    return DIR_OK;
+}
 
-    if(!IS_FILENAME_ILLEGAL(f_p))
-        return NULL;
+/* 小写转大写，非小写字符原样返回 */
+#define GLOB_UPPER(c) ((((c) >= 'a') && ((c) <= 'z')) ? ((c) - 0x20) : (c))
 
-    /* 进入文件目录，这里假设是标准绝对路径寻找文件 */
-    file_clu = YC_FAT_EnterDir(f_p);
+/* 编译通配符，只需编译一次即可用于整个目录的匹配 */
+int YC_FAT_GlobCompile(glob_pat_t * gp, char * pattern)
+{
+    unsigned char len = 0, i, dot = 0xff, ndot = 0;
+    unsigned char name_wild = 0, ext_wild = 0;
 
-    if(FOUND == YC_FAT_MatchFile(file_clu,f_op,f_n))
+    if((NULL == gp) || (NULL == pattern))
+        return ARGVS_ERROR;
+    YC_Memset(gp, 0, sizeof(glob_pat_t));
+
+    /* 大写转换，记录'.'的位置 */
+    while(pattern[len])
     {
-        /* 匹配成功 */
-        file = f_op;
-        INIT_LIST_HEAD(&file->WRCluChainList);
+        if(GLOB_PAT_MAXLEN - 1 == len)
+            return ARGVS_ERROR;
+        gp->pat[len] = GLOB_UPPER(pattern[len]);
+        if('.' == gp->pat[len]) { dot = len; ndot ++; }
+        len ++;
+    }
+    gp->pat[len] = '\0';
 
-        /* 找出文件尾簇,写文件用 */
-        file->EndClu = TakeFileClusList_Eftv(file->FirstClu);
-        
-        return file;
+    /* DOS约定，*和*.*匹配所有目录项 */
+    if(((1 == len) && ('*' == gp->pat[0])) ||
+       ((3 == len) && ('*' == gp->pat[0]) && ('.' == gp->pat[1]) && ('*' == gp->pat[2])))
+    {
+        gp->match_all = 1;
+        return DIR_OK;
     }
-    return NULL;
-}
 
-/* 读取文件 */
-void fread(FILE * f_rd, unsigned int len, void *buffer)
-{
-    if((NULL == f_rd)||(0 == len)||(NULL == buffer))
-        return;
-    YC_ReadDataNoCheck(f_rd,len,buffer);
-}
+    /* 8*3文件名至多含一个'.' */
+    if(ndot > 1)
+    {
+        gp->never = 1;
+        return DIR_OK;
+    }
 
-/* 关闭文件 */
-void fclose(FILE * f_cl)
-{
-    if(NULL == f_cl) return;
-    f_cl->CurClus = f_cl->CurOffByte = f_cl->CurOffSec = 0;
-    f_cl->file_state = FILE_CLOSE;
-    f_cl->FirstClu = 0;
-    f_cl->fl_sz = 0;
-    f_cl->left_sz = 0;
-}
+    /* 文件名固定前缀：第一个通配符或'.'之前的字节 */
+    for(i = 0; (i < len) && (i < 8); i++)
+    {
+        if(('*' == gp->pat[i]) || ('?' == gp->pat[i]) || ('.' == gp->pat[i]))
+            break;
+        gp->pre[i] = gp->pat[i];
+    }
+    gp->pre_len = i;
 
-/* 从第n号簇（某一目录开始簇）开始匹配目录，并返回目录首簇 */
-/* 配合enterdir函数使用 */
-unsigned int YC_FAT_MatchDirInClus(unsigned int clu,char *DIR)
-{
-    char DirToMatch[13]; /* 最后一字节为'\0' */
-    unsigned int fdi_clu = clu;
-    /* 目录起始簇号 */
-    unsigned int dir_clu = 0;
+    for(i = 0; i < ((0xff == dot) ? len : dot); i++)
+        if(('*' == gp->pat[i]) || ('?' == gp->pat[i])) name_wild = 1;
 
-    /* 读取首目录簇下的所有扇区 */
-    FDIs_t fdis;
-    do{
-        for(int i = 0;i < g_dbr[0].secPerClus;i++)
+    /* 文件名部分不含通配符时整个8字节文件名固定 */
+    if(!name_wild)
+    {
+        if(gp->pre_len != ((0xff == dot) ? len : dot))
         {
-            usr_read((unsigned char *)&fdis,START_SECTOR_OF_FILE(fdi_clu)+i,PER_SECSIZE);
-
-            /* 从buffer进行文件名匹配 */
-            FDI_t *fdi = NULL;
-            fdi = (FDI_t *)&fdis.fdi[0];
+            gp->never = 1;
+            return DIR_OK;
+        }
+        for(i = gp->pre_len; i < 8; i++) gp->pre[i] = ' ';
+        gp->pre_len = 8;
+    }
 
-            /* 先检查文件属性是否为目录 */
-            if(1) /* 是目录且没有删除 */
+    /* 扩展名：'.'之后不含通配符时固定；无'.'且文件名固定时扩展名为空 */
+    if(0xff != dot)
+    {
+        for(i = dot + 1; i < len; i++)
+            if(('*' == gp->pat[i]) || ('?' == gp->pat[i])) ext_wild = 1;
+        if(!ext_wild)
+        {
+            if(len - dot - 1 > 3)
             {
-                /* 从当前扇区地址循环偏移固定字节取目录名 */
-                for( ; (unsigned int)fdi < (((unsigned int)&fdis)+PER_SECSIZE) ; fdi ++)
-                {   
-                    if( (0x10 != CHECK_FDI_ATTR(fdi)) && (0xE5 != fdi->fileName[0]) )
-                    {
-                        /* 将目录簇中的8*3名转化为字符串类型 */
-                        FDI_FileNameToString((char *)fdi->fileName, DirToMatch);
-
-                        /* 匹配到目录名 */
-                        if( ycFilenameMatch(DirToMatch,DIR) )
-                        {
-                            dir_clu =  Byte2Value((unsigned char *)&fdi->startClusLower,2);
-                            dir_clu |=  (Byte2Value((unsigned char *)&fdi->startClusUper[1],2) << 16);
-                            return dir_clu;
-                        }
-                    }
-                }
-            }
-        }
-        fdi_clu = YC_TakefileNextClu(fdi_clu);
-    }while(!IS_EOF(fdi_clu));
-    
-    return 0;
+                gp->never = 1;
+                return DIR_OK;
+            }
+            for(i = 0; i < 3; i++)
+                gp->ext[i] = (dot + 1 + i < len) ? gp->pat[dot + 1 + i] : ' ';
+            gp->ext_fixed = 1;
+        }
+    }
+    else if(!name_wild)
+    {
+        gp->ext[0] = gp->ext[1] = gp->ext[2] = ' ';
+        gp->ext_fixed = 1;
+    }
+    return DIR_OK;
 }
 
-/* 获取当前工作目录 */
-void YC_FAT_getPWD(unsigned char fsn,unsigned char * p)
+/* 通配符匹配，支持*和?，*匹配时回溯至最近一个* */
+/* DOS约定，不含'.'的文件名视为扩展名为空，可与末尾的".*"或"."匹配，如NAME.*匹配NAME */
+static J_UINT8 YC_FAT_GlobMatchStr(const char * p, const char * s)
 {
-    for(int i = 0;i < YC_StrLen(&pwd[fsn]);i ++)
-        {*p = (pwd[fsn][i]); p ++;}
-}
+    const char *star = NULL, *s_bk = NULL;
+    J_UINT8 has_dot = 0;
 
-/* 目录解析，保存'/'或者'\\'之后的第一个目录 */
-/* 将dir_s下的第一个/（斜杠）或者\\（反斜杠）后的子目录 */
-/* 斜杠的ascii码为0x2f(47)，用'/'表示，占用一个字节*/
-/* 反斜杠的ascii码为0x5c(92)，用'\\'表示，占用一个字节 */
-/* 根目录没有./和../目录项，根目录下的目录的../项的簇号为2，也就是根目录簇号为2 */
-/* 输入为标准的/dir1/dir2/dir3格式或者.././dir/dir1/.等格式 */
-unsigned char YC_FAT_ParseDir(char * dir_s,char * dir_d)
-{
-    int i = 0;char *p;
-    int len = YC_StrLen(dir_s);
-    if(
-        ( '/' == (*(dir_s)) ) || ( '\\' == (*(dir_s+1)) )
-    )
+    while(*s)
     {
-        p = dir_s+1;
-        while((*p != '\0')&&(*p != '/')&&(*p != '\\'))
+        if('.' == *s) has_dot = 1;
+        if(('?' == *p) || (*p == GLOB_UPPER(*s)))
         {
-            dir_d[i++] = *p;
-            p++;
+            p ++; s ++;
         }
-        dir_d[i] = '\0';
-    }
-    else if('.' == *dir_s){
-        p = dir_s;
-        while((*p != '\0')&&(*p != '/')&&(*p != '\\'))
+        else if('*' == *p)
         {
-            dir_d[i++] = *p;
-            p++;
+            star = p ++; s_bk = s;
+        }
+        else if(star)
+        {
+            p = star + 1; s = ++ s_bk;
+        }
+        else
+        {
+            return 0;
         }
-        dir_d[i] = '\0';
-        return i-1;
     }
-    return i;
+    while('*' == *p) p ++;
+    if(!has_dot && ('.' == *p))
+    {
+        p ++;
+        while('*' == *p) p ++;
+    }
+    return ('\0' == *p);
 }
 
-static unsigned int yc_fstick = 0;
-unsigned int YC_TakeSystick(void)
-{   
-    return yc_fstick;
-}
+/* 以编译后的通配符匹配原始8*3目录项，先以固定前缀和扩展名字节预过滤 */
+J_UINT8 YC_FAT_GlobMatchFDI(glob_pat_t * gp, FDI_t * fdi)
+{
+    char fn[13];
+    unsigned char i;
 
-#define IS_TIMEOUT(n_t,tot) ((n_t-tot)>yc_fstick)
+    if(gp->match_all) return 1;
+    if(gp->never) return 0;
 
-/* 目录索引错误码 */
-#define ENTER_ROOT_PDIR_ERROR -1
-#define ENTER_DIR_TIMEOUT_ERROR -2
+    /* 固定前缀预过滤 */
+    for(i = 0; i < gp->pre_len; i++)
+        if(GLOB_UPPER(fdi->fileName[i]) != gp->pre[i]) return 0;
 
-/* 按层级进入目录 */
-unsigned int YC_FAT_EnterDir(char *dir)
-{
-    unsigned int dir_clu = 0xffffffff;
+    /* 固定扩展名预过滤 */
+    if(gp->ext_fixed)
+    {
+        for(i = 0; i < 3; i++)
+            if(GLOB_UPPER(fdi->extName[i]) != gp->ext[i]) return 0;
+        /* 文件名与扩展名均固定，无需完整匹配 */
+        if(8 == gp->pre_len) return 1;
+    }
 
-    char dir_temp[20] = {0};
-    unsigned char i = 0;
+    FDI_FileNameToString((char *)fdi->fileName, fn);
+    return YC_FAT_GlobMatchStr(gp->pat, fn);
+}
 
-    /* 锚定起始目录簇 */
-    if((*(char *)fp == '.')&&(*((char *)fp+1)) == '..'))
-        dir_clu = work_clu[0];
-    else if((*(char *)fp == '\\')||(*(char *)fp == '/'))  {
-        dir_clu = ROOT_CLUS;
-    }
-    else if(*(char *)fp = '.')  
-        dir_clu = work_clu[0];
+/* 从已打开的目录流中批量读取与通配符匹配的目录项，返回实际读出的目录项数目 */
+int YC_FAT_readdir_glob(DIR * dp, glob_pat_t * gp, dirent_t * ents, int n)
+{
+    int cnt = 0;
+    FDI_t *fdi;
 
-#if YC_TIMEOUT_SWITCH
-    int tick_now = YC_TakeSystick();
-#endif
+    if((NULL == dp) || (NULL == gp) || (NULL == ents) || (n <= 0))
+        return 0;
+    if(FILE_OPEN != dp->dir_state)
+        return 0;
+    YC_API_ENTER(YC_OP_DIR,dp->vol);
+    if(!YC_ReadLock(&dp->vol->rw))
+        return 0;
 
-    /* 递归式遍历子目录 */
-    for( ; ; )
+    while((cnt < n) && (NULL != (fdi = YC_FAT_DirNextFDI(dp))))
     {
-        if(!YC_StrLen(dir))
-            break;
+#if YC_LFN_ON
+        /* 带长文件名的目录项，长文件名或别名匹配均可 */
+        if(dp->lfn_ok)
         {
-            i = YC_FAT_ParseDir(dir,dir_temp);
-            if(((ROOT_CLUS == dir_clu) && ('.' == *dir_temp) && ('.' == *(dir_temp+1)))){
-                return ENTER_ROOT_PDIR_ERROR;/* 非法目录 */
-            }
-            dir_clu = YC_FAT_MatchDirInClus(dir_clu,dir_temp);
-            YC_SubStr(dir, i+1, 100);
+            YC_FAT_DirDecode(dp,fdi,&ents[cnt]);
+            if(gp->match_all || YC_FAT_GlobMatchStr(gp->pat,ents[cnt].name) || YC_FAT_GlobMatchFDI(gp,fdi))
+                cnt ++;
+            continue;
         }
-        /* 遍历超时退出，返回错误码 */
-#if YC_TIMEOUT_SWITCH
-        if(IS_TIMEOUT(tick_now,1000));
-            return ENTER_DIR_TIMEOUT_ERROR;
 #endif
+        /* 只对匹配的目录项进行解码 */
+        if(YC_FAT_GlobMatchFDI(gp,fdi))
+            YC_FAT_DirDecode(dp,fdi,&ents[cnt ++]);
     }
-    return dir_clu;
+    YC_ReadUnlock(&dp->vol->rw);
+    return cnt;
 }
 
-/* CD脚本 */
-/* 待测试 */
-unsigned int YC_CD(char *dir)
+/* 单次遍历目录，返回至多max个与通配符匹配的目录项 */
+int YC_FAT_glob(VOL_t *vol,char * dirpath, char * pattern, dirent_t * ents, int max)
 {
-    unsigned int cc = 0xffffffff;
-    cc = YC_FAT_EnterDir(dir);
-
-    if(cc != 0xffffffff)
-        work_clu[0] = cc;
-    return cc;
+    DIR dir = {0};
+    glob_pat_t gp;
+    int cnt;
+    YC_API_ENTER(YC_OP_DIR,vol);
+
+    if(DIR_OK != YC_FAT_GlobCompile(&gp,pattern))
+        return ARGVS_ERROR;
+    if(NULL == YC_FAT_opendir(vol,&dir,dirpath))
+        return DIR_NOT_FOUND;
+
+    cnt = YC_FAT_readdir_glob(&dir,&gp,ents,max);
+    YC_FAT_closedir(&dir);
+    return cnt;
 }
 
 /* 更新FSINFO扇区，主要用于更新剩余空闲簇数目 */
-void YC_FAT_UpdateFSInfo(void)
+void YC_FAT_UpdateFSInfo(VOL_t *vol)
 {
     FSINFO_t fsi,* pfsi = &fsi;
-    usr_read((unsigned char *)&fsi,g_mbr.dpt[0].partStartSec+1,PER_SECSIZE);
-    pfsi->Free_nClus[0] = FatInitArgs_a[0].FreeClusNum;
-    pfsi->Free_nClus[1] = FatInitArgs_a[0].FreeClusNum>>8;
-    pfsi->Free_nClus[2] = FatInitArgs_a[0].FreeClusNum>>16;
-    pfsi->Free_nClus[3] = FatInitArgs_a[0].FreeClusNum>>24;
-    usr_write((char *)&fsi,g_mbr.dpt[0].partStartSec+1,PER_SECSIZE);
+    YC_DiskRead(vol,(unsigned char *)&fsi,vol->FSInfoSec,1);
+    pfsi->Free_nClus[0] = vol->args.FreeClusNum;
+    pfsi->Free_nClus[1] = vol->args.FreeClusNum>>8;
+    pfsi->Free_nClus[2] = vol->args.FreeClusNum>>16;
+    pfsi->Free_nClus[3] = vol->args.FreeClusNum>>24;
+    YC_DiskWrite(vol,(char *)&fsi,vol->FSInfoSec,1);
 }
 
 /* 读取FSINFO扇区 */
-void YC_FAT_ReadInfoSec(unsigned int *leftnum)
+void YC_FAT_ReadInfoSec(VOL_t *vol)
 {
     FSINFO_t fsinfo;
-    usr_read((unsigned char *)&fsinfo,g_mbr.dpt[0].partStartSec+1,PER_SECSIZE);
-    FatInitArgs_a[0].FreeClusNum = Byte2Value((unsigned char *)&fsinfo.Free_nClus,4);
+    YC_DiskRead(vol,(unsigned char *)&fsinfo,vol->FSInfoSec,1);
+    vol->args.FreeClusNum = Byte2Value((unsigned char *)&fsinfo.Free_nClus,4);
+}
+
+/* 簇是否已被某个文件预留 */
+static J_UINT8 YC_FAT_IsReserved(VOL_t *vol,unsigned int clu)
+{
+    struct list_head *f,*pos;
+    w_buffer_t *w;
+    yc_fnode_t *fl;
+    unsigned int i;
+
+    list_for_each(f,&vol->rsv_list)
+    {
+        fl = list_entry(f,yc_fnode_t,RsvNode);
+        for(i = fl->RsvRunHead; i < fl->RsvRunNum; i++)
+        {
+            if((clu >= fl->RsvRun[i].s_clu) && (clu <= fl->RsvRun[i].e_clu))
+                return 1;
+        }
+        list_for_each(pos,&fl->WRCluChainList)
+        {
+            w = (w_buffer_t *)pos;
+            if((clu >= w->w_s_clu) && (clu <= w->w_e_clu))
+                return 1;
+        }
+    }
+    return 0;
 }
 
 /* 遍历FAT表，寻找第一个空簇 */
-int YC_FAT_SeekFirstEmptyClus(unsigned int * d)
+int YC_FAT_SeekFirstEmptyClus(VOL_t *vol,unsigned int * d)
 {
     /* 遍历FAT所有扇区 */
     /* 由DBR获取FAT首扇区地址 */
-    int j = g_dbr[0].FATSz32;int k;
-    unsigned int fat_ss = g_mbr.dpt[0].partStartSec+g_dbr[0].rsvdSecCnt;
+    int j = vol->dbr.FATSz32;int k;
+    unsigned int fat_ss = vol->partStartSec+vol->dbr.rsvdSecCnt;
     FAT32_Sec_t fat_secA;
     FAT32_t * fat;
     for(k = 0; k < j; k++)
     {
         /* 取当前扇区所有FAT链 */
-        usr_read((unsigned char *)&fat_secA,fat_ss+k,PER_SECSIZE);
+        YC_DiskRead(vol,(unsigned char *)&fat_secA,fat_ss+k,1);
 		fat = (FAT32_t *)&fat_secA.fat_sec[0];
-        for(; (unsigned int)fat < ((unsigned int)&fat_secA+sizeof(FAT32_Sec_t)); fat++)
+        for(; (unsigned char *)fat < ((unsigned char *)&fat_secA + sizeof(FAT32_Sec_t)); fat++)
         {
-            /* 找到一个FAT */
+            /* 找到一个FAT，跳过其他文件预留的簇 */
             if(0x00 == *(unsigned int *)fat) {
                 /* 将在一个扇区内的Byte偏移转化为簇号 */
-                *(unsigned int *)d = k*(PER_SECSIZE/FAT_SIZE)+((unsigned int)fat-(unsigned int)&fat_secA)/FAT_SIZE;
+                *(unsigned int *)d = k*(PER_SECSIZE/FAT_SIZE)+((unsigned char *)fat - (unsigned char *)&fat_secA)/FAT_SIZE;
+                /* FAT表尾部的填充项 */
+                if(*d >= vol->args.ClusEnd)
+                    return -1;
+                if(YC_FAT_IsReserved(vol,*d))
+                    continue;
                 return 0;
             }
             else continue;
@@ -1230,17 +3536,17 @@ int YC_FAT_SeekFirstEmptyClus(unsigned int * d)
 #define SET_BIT(a,n) (a = a|(1<<n))
 
 /* FAT表映射到位图,默认1个扇区的FAT */
-int YC_FAT_RemapToBit(unsigned int start_sec)
+int YC_FAT_RemapToBit(VOL_t *vol,unsigned int start_sec)
 {
     FAT32_Sec_t fat_secA;
     unsigned int *pi = (unsigned int *)&fat_secA;
-    unsigned char *pc = clusterBitmap;
+    unsigned char *pc = vol->clusterBitmap;
     unsigned char n = 0,k = 0;
-    YC_Memset(clusterBitmap, 0, sizeof(clusterBitmap));
+    YC_Memset(vol->clusterBitmap, 0, sizeof(vol->clusterBitmap));
     /* 先读出FAT扇区所有数据 */
-    usr_read((unsigned char *)&fat_secA,start_sec,1);
+    YC_DiskRead(vol,(unsigned char *)&fat_secA,start_sec,1);
     /* 将整个FAT扇区映射到位图，0->0,!0->1 */
-    while((unsigned int)pi < ((unsigned int)&fat_secA + PER_SECSIZE))
+    while((unsigned char *)pi < ((unsigned char *)&fat_secA + PER_SECSIZE))
     {
         if((*pi)&&(0xffffffff)){
             SET_BIT(*pc,n);k++;
@@ -1263,7 +3569,7 @@ int YC_FAT_RemapToBit(unsigned int start_sec)
 }
 
 /* 扩展簇链（不进行自动缝合簇链） */
-int YC_FAT_ExpandCluChain(unsigned int theclu,unsigned int nextclu)
+int YC_FAT_ExpandCluChain(VOL_t *vol,unsigned int theclu,unsigned int nextclu)
 {
     /* 索引theclu在FAT表中的偏移 */
     FAT32_Sec_t fat_sec1;
@@ -1273,10 +3579,10 @@ int YC_FAT_ExpandCluChain(unsigned int theclu,unsigned int nextclu)
     unsigned int off_b = theclu * FAT_SIZE;
     /* 再计算扇区偏移,得到FAT所在绝对扇区 */
     unsigned int off_sec = off_b / PER_SECSIZE;
-    unsigned int t_rSec = off_sec + FatInitArgs_a[0].FAT1Sec; /* 默认取DBR0中的数据 */
+    unsigned int t_rSec = off_sec + vol->args.FAT1Sec; /* 取本卷FAT1起始扇区 */
 
     /* 取当前扇区所有FAT */
-    usr_read((unsigned char *)&fat_sec1,t_rSec,PER_SECSIZE);
+    YC_DiskRead(vol,(unsigned char *)&fat_sec1,t_rSec,1);
 
     FAT32_t * fat = (FAT32_t * )&fat_sec1.fat_sec[0];
     unsigned char off_fat = (off_b % PER_SECSIZE)/4;/* 计算在FAT中的偏移（以FAT大小为单位） */
@@ -1289,7 +3595,7 @@ int YC_FAT_ExpandCluChain(unsigned int theclu,unsigned int nextclu)
     *((unsigned char *)(fat)+3) = nextclu >> 24;
 
     /* 回写扇区 */
-    usr_write((unsigned char *)&fat_sec1,t_rSec,PER_SECSIZE);
+    YC_FAT_PutFatSec(vol,t_rSec,&fat_sec1);
     return 0;
 }
 
@@ -1298,64 +3604,148 @@ int YC_FAT_ExpandCluChain(unsigned int theclu,unsigned int nextclu)
 
 /* 寻找当前簇的下一个空闲簇 */
 /* 简单测试通过 */
-int YC_FAT_SeekNextFirstEmptyClu(unsigned int current_clu,unsigned int * free_clu)
+int YC_FAT_SeekNextFirstEmptyClu(VOL_t *vol,unsigned int current_clu,unsigned int * free_clu)
 {
     if(!free_clu) return ARGVS_ERROR;
+    YC_HIST_SCOPE(YC_HIST_FAT_SCAN)
 
     FAT32_Sec_t fat_sec1;FAT32_t * fat;
     current_clu ++;
     /* 是否存在满足需求的空簇 */
-    if(!FatInitArgs_a[0].FreeClusNum) return NO_FREE_CLU;
+    if(!VOL_FREE_CLU(vol)) return NO_FREE_CLU;
     /* 从当前FAT表所在扇区向后遍历FAT表中的所有扇区，找出第一个空闲簇 */
-    unsigned int t_rSec = (current_clu * FAT_SIZE / PER_SECSIZE) + FatInitArgs_a[0].FAT1Sec;
-    for(;t_rSec < FatInitArgs_a[0].FAT1Sec + g_dbr[0].FATSz32;t_rSec ++)
+    unsigned int t_rSec = (current_clu * FAT_SIZE / PER_SECSIZE) + vol->args.FAT1Sec;
+    for(;t_rSec < vol->args.FAT1Sec + vol->dbr.FATSz32;t_rSec ++)
     {
         /* 取当前扇区所有FAT */
-        usr_read((unsigned char *)&fat_sec1,t_rSec,PER_SECSIZE);
+        YC_DiskRead(vol,(unsigned char *)&fat_sec1,t_rSec,1);
         fat = (FAT32_t * )&fat_sec1.fat_sec[0];
         fat = fat + (current_clu * FAT_SIZE % PER_SECSIZE)/4;
         /* 从当前FAT所在扇区偏移开始向后遍历 */
-        for(; (unsigned int)fat < ((unsigned int)&fat_sec1+sizeof(FAT32_Sec_t)); fat++)
+        for(; (unsigned char *)fat < ((unsigned char *)&fat_sec1 + sizeof(FAT32_Sec_t)); fat++)
         {
             current_clu ++;
-            /* 找到一个FAT为0 */
+            /* 找到一个FAT为0，跳过其他文件预留的簇 */
             if(0 == *(unsigned int *)fat) {
                 /* 将在一个扇区内的Byte偏移转化为簇号 */
-                *(unsigned int *)free_clu = (t_rSec-FatInitArgs_a[0].FAT1Sec)*(PER_SECSIZE/FAT_SIZE)+\
-                                            ((unsigned int)fat-(unsigned int)&fat_sec1)/FAT_SIZE;
+                *(unsigned int *)free_clu = (t_rSec-vol->args.FAT1Sec)*(PER_SECSIZE/FAT_SIZE)+\
+                                            ((unsigned char *)fat - (unsigned char *)&fat_sec1)/FAT_SIZE;
+                /* FAT表尾部的填充项，从头开始遍历 */
+                if(*free_clu >= vol->args.ClusEnd)
+                    goto wrap;
+                if(YC_FAT_IsReserved(vol,*free_clu))
+                    continue;
                 return 0;
             }
         }
     }
+wrap:
     /* 若遍历完，还未找到空簇，从头开始遍历 */
-    if(-1 == YC_FAT_SeekFirstEmptyClus(free_clu))
+    if(-1 == YC_FAT_SeekFirstEmptyClus(vol,free_clu))
         return -1;
     return FOUND_FREE_CLU;
 }
 
-/* ycfat初始化 */
-void YC_FAT_Init(void)
+/* 挂载错误码 */
+#define MOUNT_OK 0
+#define MOUNT_NO_PART -1    /* 分区不存在 */
+#define MOUNT_NOT_FAT32 -2  /* 不是FAT32分区 */
+
+/* 挂载分区，卷对象由调用者提供 */
+/* 解析绝对0扇区的MBR或DBR，读取part号分区的DBR及FSINFO，绝对0扇区即为DBR（无MBR）时只有0号分区 */
+int YC_FAT_Mount(VOL_t *vol,const blk_dev_t *dev,J_UINT8 part)
 {
-    /* 解析绝对0扇区 */
-    YC_FAT_AnalyseSec0();
-    
+    unsigned char buffer[PER_SECSIZE];
+
+    if((NULL == vol) || (NULL == dev) || (part > 3))
+        return ARGVS_ERROR;
+
+    YC_Memset(vol, 0, sizeof(VOL_t));
+    vol->dev = *dev;
+    YC_API_ENTER(YC_OP_MOUNT,vol);
+    vol->part = part;
+    INIT_LIST_HEAD(&vol->rsv_list);
+
+    /* 读取绝对0扇区 */
+    YC_DiskRead(vol,buffer,0,1);
+
+    /* 判断绝对0扇区是不是为DBR扇区 */
+    if((*buffer == 0xEB)&&(*(buffer+1) == 0x58)&&(*(buffer+2) == 0x90))
+    {
+        if(part) return MOUNT_NO_PART;
+        vol->partStartSec = 0;
+    }
+    else
+    {
+        /* 解析分区开始扇区 */
+        vol->partStartSec = Byte2Value((unsigned char *)(buffer+446+16*part+8),4);
+        if(0 == vol->partStartSec) return MOUNT_NO_PART;
+    }
+
     /* 解析DBR */
-    YC_FAT_ReadDBR(&g_dbr[0]);
+    YC_FAT_ReadDBR(vol,&vol->dbr);
+    if((0 == vol->dbr.secPerClus) || (0 == vol->dbr.FATSz32))
+        return MOUNT_NOT_FAT32;
+
+    /* 初始化卷参数 */
+    vol->args.DBR_Ss = vol->partStartSec;
+    vol->args.FAT1Sec = vol->partStartSec + vol->dbr.rsvdSecCnt;/* FAT1起始扇区等于DBR起始扇区加保留扇区数 */
+    vol->args.FirstDirSector = vol->args.FAT1Sec + (vol->dbr.numFATs * vol->dbr.FATSz32);
+    /* 数据区簇数由DBR总扇区数计算，FAT表按扇区取整，其容量可能大于实际簇数 */
+    if(vol->dbr.totSec32 <= vol->args.FirstDirSector - vol->partStartSec)
+        return MOUNT_NOT_FAT32;
+    vol->args.ClusEnd = (vol->dbr.totSec32 - (vol->args.FirstDirSector - vol->partStartSec))/vol->dbr.secPerClus + 2;
+    vol->args.ClusEnd = MIN(vol->args.ClusEnd, vol->dbr.FATSz32*(PER_SECSIZE/FAT_SIZE));
+    vol->FSInfoSec = vol->partStartSec + (vol->dbr.FSInfo ? vol->dbr.FSInfo : 1);
+
+    /* 当前目录为根目录 */
+    vol->pwd[0] = '/';
+    vol->work_clu = ROOT_CLUS;
 
     /* 获取FAT表大小推荐参数 */
     //unsigned int disk_size = ioctl();
 
     /* 遍历FAT表，寻找第一个空闲簇 */
-    YC_FAT_SeekFirstEmptyClus((unsigned int *)&FatInitArgs_a[0].NextFreeClu);
+    if(-1 == YC_FAT_SeekFirstEmptyClus(vol,(unsigned int *)&vol->args.NextFreeClu))
+        vol->args.NextFreeClu = 0xffffffff;
     /* 第一个空闲簇所在FAT扇区 */
-    cur_fat_sec = CLU_TO_FATSEC(FatInitArgs_a[0].NextFreeClu);
+    vol->cur_fat_sec = CLU_TO_FATSEC(vol,vol->args.NextFreeClu);
 
     /* 找出第一个有空闲簇的FAT扇区 */
-    if((FatInitArgs_a[0].NextFreeClu != 0xffffffff) && (FatInitArgs_a[0].NextFreeClu != 0))
-        YC_FAT_RemapToBit(cur_fat_sec);
+    if((vol->args.NextFreeClu != 0xffffffff) && (vol->args.NextFreeClu != 0))
+        YC_FAT_RemapToBit(vol,vol->cur_fat_sec);
 
     /* 读取FSINFO扇区，更新剩余空簇 */
-    YC_FAT_ReadInfoSec((unsigned int *)&FatInitArgs_a[0].FreeClusNum);
+    YC_FAT_ReadInfoSec(vol);
+
+    vol->mounted = 1;
+    return MOUNT_OK;
+}
+
+/* 挂载磁盘（或镜像）上的所有分区，vols至少提供4个卷对象，返回成功挂载的分区数目 */
+int YC_FAT_MountAll(VOL_t *vols,const blk_dev_t *dev)
+{
+    int n = 0;
+    if((NULL == vols) || (NULL == dev))
+        return ARGVS_ERROR;
+    for(J_UINT8 i = 0; i < 4; i++)
+    {
+        if(MOUNT_OK == YC_FAT_Mount(&vols[i],dev,i))
+            n ++;
+    }
+    return n;
+}
+
+/* 卸载分区，回写FSINFO */
+void YC_FAT_Unmount(VOL_t *vol)
+{
+    if((NULL == vol) || (!vol->mounted))
+        return;
+    YC_API_ENTER(YC_OP_MOUNT,vol);
+    YC_WriteLockWait(&vol->rw);
+    YC_FAT_UpdateFSInfo(vol);
+    vol->mounted = 0;
+    YC_WriteUnlock(&vol->rw);
 }
 
 /* ------------------------------------------ */
@@ -1368,7 +3758,7 @@ static void Genfilename_s(char *filename,char *d)
     if((NULL == d)||(NULL == filename)) return;
     int len = YC_StrLen(filename);
     char *fn = filename;
-    char i = 0;char j = 0;
+    int i = 0;int j = 0;
     for(i = 0; i < len; i++){
         if('.' == fn[i])
             break;
@@ -1419,140 +3809,496 @@ static void Genfilename_s(char *filename,char *d)
     }
 }
 
-#define MAKETIME(T) 
-#define MAKEDATE(T)
+#define MAKETIME(T) 
+#define MAKEDATE(T)
+
+typedef enum CreatFDItype
+{
+    FDIT_DIR = 0,
+    FDIT_FILE = 1
+}FDIT_t;
+
+/* 生成文件目录项fdi */
+/* 测试通过 */
+static void YC_FAT_GenerateFDI(FDI_t *fdi,char *filename,FDIT_t fdi_t)
+{
+    /* 检查传参合法性 */
+    if((NULL == fdi)||(NULL == filename)||(!IS_FILENAME_ILLEGAL(filename))) return;
+    
+    FDI_t *fdi2full = fdi;
+    char fn[11] = {0};
+
+    YC_Memset(fdi2full, 0, sizeof(FDI_t));
+
+    /* create SFN */
+    if(FDIT_FILE == fdi_t)
+        Genfilename_s(filename,fn);
+    else{
+        if((*filename == '.')&&(*(filename+1) == '.')){
+            fn[0] = '.';fn[1] = '.';fn[2]=fn[3]=fn[4]=fn[5]=fn[6]=fn[7]=fn[8]=fn[9]=fn[10] = ' ';
+        }else if(*filename == '.'){
+            fn[0] = '.';fn[1]=fn[2]=fn[3]=fn[4]=fn[5]=fn[6]=fn[7]=fn[8]=fn[9]=fn[10] = ' ';
+        }
+        else if((*filename != '.')&&(*(filename+1) != '.')){
+            Genfilename_s(filename,fn);
+        }
+    }
+
+    YC_StrCpy_l((char *)fdi2full->fileName,fn,sizeof(fn));/* fill file name */
+    fdi2full->attribute = (FDIT_FILE == fdi_t)?ARCHIVE:TP_DIR;/* 属性字段文件or目录 */
+	if(*filename == '.')
+		fdi2full->UpLower = 0;
+	else
+		fdi2full->UpLower = (FDIT_FILE == fdi_t)?0x10:0x08;
+    *(J_UINT16 *)fdi2full->startClusUper = 0;
+    *(J_UINT16 *)fdi2full->startClusLower = 0;
+    *(J_UINT32 *)fdi2full->fileSize = 0;
+#if YC_TIMESTAMP_ON
+    fdi2full->crtTime = MAKETIME(systime_now());
+    fdi2full->crtDate = MAKEDATE(sysdate_now());
+#else
+    fdi2full->crtTime = 0;
+    fdi2full->crtDate = 0;
+#endif
+}
+
+#define CRT_FILE_OK 0
+#define CRT_SAME_FILE_ERR -1
+#define CRT_FILE_NO_FREE_CLU_ERR -2
+
+/* 扩展目录簇链，新目录簇清零，返回新簇号，无空闲簇返回0xffffffff */
+static unsigned int YC_FAT_AppendDirClu(VOL_t *vol,unsigned int tail_clu)
+{
+    FDIs_t fdis;
+    unsigned int freeclu = vol->args.NextFreeClu;
+
+    /* 若没有空闲簇，错误返回 */
+    if((0xffffffff == freeclu) || (!VOL_FREE_CLU(vol)))
+        return 0xffffffff;
+
+    /* 扩展目录簇链 */
+    YC_FAT_ExpandCluChain(vol,tail_clu,freeclu);
+    YC_FAT_ExpandCluChain(vol,freeclu,CLU_EOC);
+
+    /* 新目录簇清零，保证目录以0x00目录项结束 */
+    YC_Memset(&fdis, 0, sizeof(FDIs_t));
+    for(int i = 0;i < vol->dbr.secPerClus;i++)
+        YC_DiskWrite(vol,(unsigned char *)&fdis,START_SECTOR_OF_FILE(vol,freeclu)+i,1);
+
+    /* 更新FSINFO扇区中的空簇数目 */
+    vol->args.FreeClusNum --;
+    YC_FAT_UpdateFSInfo(vol);
+    /* 寻找下一空闲簇 */
+    if(VOL_FREE_CLU(vol))
+        YC_FAT_SeekNextFirstEmptyClu(vol,freeclu,(unsigned int *)&vol->args.NextFreeClu);
+    else
+        vol->args.NextFreeClu = 0xffffffff;
+    return freeclu;
+}
+
+/* 目录项位置在簇内后移一项，越过簇尾返回0 */
+static J_UINT8 YC_FAT_LocNext(VOL_t *vol,fdi_loc_t *pos)
+{
+    if(FDI_PER_SEC != ++pos->idx)
+        return 1;
+    pos->idx = 0;
+    return (vol->dbr.secPerClus != ++pos->sec);
+}
+
+/* 从上一个已复用的已删除目录项向后寻找下一个，找不到时清零计数 */
+/* 已删除目录项只会向后查找，整个目录的查找代价均摊为常数 */
+static void YC_FAT_HintSeekE5(VOL_t *vol,dir_hint_t *h)
+{
+    FDIs_t fdis;
+    fdi_loc_t pos = h->first_e5;
+
+    for( ; ; )
+    {
+        YC_DiskRead(vol,(unsigned char *)&fdis,START_SECTOR_OF_FILE(vol,pos.clu)+pos.sec,1);
+        for( ; pos.idx < FDI_PER_SEC; pos.idx ++)
+        {
+            if(0x00 == fdis.fdi[pos.idx].fileName[0])
+            {
+                h->e5_cnt = 0;
+                return;
+            }
+            if(0xE5 == fdis.fdi[pos.idx].fileName[0])
+            {
+                h->first_e5 = pos;
+                h->e5_known = 1;
+                return;
+            }
+        }
+        pos.idx = 0;
+        if(vol->dbr.secPerClus == ++pos.sec)
+        {
+            pos.sec = 0;
+            pos.clu = YC_TakefileNextClu(vol,pos.clu);
+            if(IS_EOF(pos.clu))
+            {
+                h->e5_cnt = 0;
+                return;
+            }
+        }
+    }
+}
+
+/* 取目录提示，不存在时遍历一次目录建立 */
+static dir_hint_t * YC_FAT_HintLoad(VOL_t *vol,unsigned int dir_clu)
+{
+    dir_hint_t *h = YC_FAT_HintGet(vol,dir_clu);
+    if(NULL == h)
+    {
+        dirscan_t sc = {0};
+        YC_FAT_ScanDir(vol,dir_clu,&sc);
+        h = YC_FAT_HintGet(vol,dir_clu);
+    }
+    return h;
+}
+
+/* 从目录结束标记处连续写入n个目录项需要扩展的目录簇数 */
+static unsigned int YC_FAT_EndNeedClu(VOL_t *vol,dir_hint_t *h,unsigned int n)
+{
+    unsigned int left, per = vol->dbr.secPerClus*FDI_PER_SEC;
+
+    left = h->end_valid ? ((vol->dbr.secPerClus - h->end.sec)*FDI_PER_SEC - h->end.idx) : 0;
+    return (n <= left) ? 0 : (n - left + per - 1)/per;
+}
+
+/* 插入n个目录项需要扩展的目录簇数 */
+static unsigned int YC_FAT_HintNeedClu(VOL_t *vol,unsigned int dir_clu,unsigned int n)
+{
+    dir_hint_t *h = YC_FAT_HintLoad(vol,dir_clu);
+
+    if(NULL == h) return 1;
+    if((1 == n) && h->e5_cnt) return 0;
+    return YC_FAT_EndNeedClu(vol,h,n);
+}
+
+/* 将n个连续目录项写入目录，可跨扇区、跨簇，空间不足时扩展目录簇链 */
+/* 由空闲目录项提示直接定位，单个目录项优先复用已删除目录项，否则写在目录结束标记处 */
+/* sfn_loc返回最后一个目录项（短文件名目录项）的位置 */
+static int YC_FAT_InsertEntries(VOL_t *vol,unsigned int dir_clu,FDI_t *ents,J_UINT8 n,fdi_loc_t *sfn_loc)
+{
+    FDIs_t fdis;
+    fdi_loc_t pos;
+    unsigned int nclu;
+    J_UINT8 k = 0, at_end = 1;
+    dir_hint_t *h = YC_FAT_HintLoad(vol,dir_clu);
+
+    if(NULL == h)
+        return ARGVS_ERROR;
+
+    /* 单个目录项优先复用已删除目录项 */
+    if((1 == n) && h->e5_cnt && !h->e5_known)
+        YC_FAT_HintSeekE5(vol,h);
+    if((1 == n) && h->e5_cnt)
+    {
+        pos = h->first_e5;
+        h->e5_cnt --;
+        h->e5_known = 0;
+        at_end = 0;
+    }
+    else if(h->end_valid)
+    {
+        pos = h->end;
+    }
+    else
+    {
+        /* 目录已满，在新簇头部写入 */
+        nclu = YC_FAT_AppendDirClu(vol,h->tail_clu);
+        if(0xffffffff == nclu)
+            return CRT_FILE_NO_FREE_CLU_ERR;
+        h->tail_clu = nclu;
+        pos.clu = nclu; pos.sec = pos.idx = 0;
+    }
+
+    YC_DiskRead(vol,(unsigned char *)&fdis,START_SECTOR_OF_FILE(vol,pos.clu)+pos.sec,1);
+    for( ; ; )
+    {
+        fdis.fdi[pos.idx] = ents[k];
+        if(n == ++k)
+            break;
+
+        /* 锚定下一目录项 */
+        if(FDI_PER_SEC == ++pos.idx)
+        {
+            YC_DiskWrite(vol,(unsigned char *)&fdis,START_SECTOR_OF_FILE(vol,pos.clu)+pos.sec,1);
+            pos.idx = 0;
+            if(vol->dbr.secPerClus == ++pos.sec)
+            {
+                pos.sec = 0;
+                nclu = YC_TakefileNextClu(vol,pos.clu);
+                if(IS_EOF(nclu))
+                {
+                    nclu = YC_FAT_AppendDirClu(vol,pos.clu);
+                    if(0xffffffff == nclu)
+                    {
+                        YC_FAT_HintDrop(vol,dir_clu);
+                        return CRT_FILE_NO_FREE_CLU_ERR;
+                    }
+                    h->tail_clu = nclu;
+                }
+                pos.clu = nclu;
+            }
+            YC_DiskRead(vol,(unsigned char *)&fdis,START_SECTOR_OF_FILE(vol,pos.clu)+pos.sec,1);
+        }
+    }
+    /* 回写当前扇区 */
+    YC_DiskWrite(vol,(unsigned char *)&fdis,START_SECTOR_OF_FILE(vol,pos.clu)+pos.sec,1);
+
+    /* 目录结束标记后移，越过末簇尾时目录已满 */
+    if(at_end)
+    {
+        h->end = pos;
+        h->end_valid = YC_FAT_LocNext(vol,&h->end);
+    }
+
+    if(sfn_loc) *sfn_loc = pos;
+    return CRT_FILE_OK;
+}
+
+#if YC_LFN_ON
+/* 8*3文件名中允许的特殊字符 */
+#define IS_SFN_SPECIAL(c) (((c) == '$') || ((c) == '%') || ((c) == '\'') || ((c) == '-') || \
+                           ((c) == '_') || ((c) == '@') || ((c) == '~') || ((c) == '`') || \
+                           ((c) == '!') || ((c) == '(') || ((c) == ')') || ((c) == '{') || \
+                           ((c) == '}') || ((c) == '^') || ((c) == '#') || ((c) == '&'))
+#define IS_SFN_CHAR(c) ((((c) >= 'A') && ((c) <= 'Z')) || (((c) >= 'a') && ((c) <= 'z')) || \
+                        (((c) >= '0') && ((c) <= '9')) || IS_SFN_SPECIAL(c))
+
+/* 文件名是否需要长文件名目录项：不能无损表示为8*3文件名 */
+static J_UINT8 YC_FAT_NeedLFN(char *name)
+{
+    int len = YC_StrLen(name), dot = -1;
+
+    for(int i = 0; i < len; i++)
+    {
+        if('.' == name[i])
+        {
+            /* 多个'.'或以'.'开头 */
+            if((-1 != dot) || (0 == i)) return 1;
+            dot = i;
+        }
+        else if(!IS_SFN_CHAR((J_UINT8)name[i]))
+        {
+            return 1;
+        }
+    }
+    /* 文件名不超过8字节，扩展名不超过3字节 */
+    if(-1 == dot)
+        return (len > 8);
+    return ((dot > 8) || (len - dot - 1 > 3) || (len - dot - 1 == 0));
+}
+
+/* 由长文件名生成别名基名（11字节8*3格式，大写），返回文件名部分有效长度 */
+static J_UINT8 YC_FAT_GenAliasBasis(char *name,J_UINT8 *basis)
+{
+    int len = YC_StrLen(name), dot = -1, i;
+    J_UINT8 n = 0, e = 0, c;
+
+    YC_Memset(basis, ' ', 11);
+
+    /* 最后一个'.'之后为扩展名 */
+    for(i = len - 1; i > 0; i--)
+        if('.' == name[i]) { dot = i; break; }
+
+    /* 文件名部分，跳过空格和'.'，非法字符替换为'_' */
+    for(i = 0; (i < ((-1 == dot) ? len : dot)) && (n < 8); i++)
+    {
+        c = (J_UINT8)name[i];
+        if((' ' == c) || ('.' == c)) continue;
+        /* UTF-8多字节字符只替换一次 */
+        if((c & 0xC0) == 0x80) continue;
+        basis[n ++] = IS_SFN_CHAR(c) ? FOLD_UPPER(c) : '_';
+    }
+    if(0 == n) basis[n ++] = '_';
+
+    /* 扩展名部分 */
+    if(-1 != dot)
+    {
+        for(i = dot + 1; (i < len) && (e < 3); i++)
+        {
+            c = (J_UINT8)name[i];
+            if(' ' == c) continue;
+            if((c & 0xC0) == 0x80) continue;
+            basis[8 + e ++] = IS_SFN_CHAR(c) ? FOLD_UPPER(c) : '_';
+        }
+    }
+    return n;
+}
+
+/* 由别名基名及数字尾n生成8*3别名 */
+static void YC_FAT_AliasMake(J_UINT8 *basis,J_UINT8 basis_len,unsigned int n,J_UINT8 *sfn)
+{
+    J_UINT8 dig = YC_AliasTailDigits(n);
+    J_UINT8 pre = MIN(basis_len, 7 - dig);
+    J_UINT8 k;
+
+    YC_Memset(sfn, ' ', 8);
+    for(k = 0; k < pre; k++) sfn[k] = basis[k];
+    sfn[pre] = '~';
+    for(k = 0; k < dig; k++, n /= 10)
+        sfn[pre + dig - k] = '0' + (n % 10);
+    sfn[8] = basis[8]; sfn[9] = basis[9]; sfn[10] = basis[10];
+}
 
-typedef enum CreatFDItype
+/* 在扫描得到的已占用序号中选出最小可用数字尾，生成8*3别名 */
+static int YC_FAT_PickAliasTail(dirscan_t *sc,J_UINT8 *sfn)
 {
-    FDIT_DIR = 0,
-    FDIT_FILE = 1
-}FDIT_t;
+    for(unsigned int n = 1; n <= YC_ALIAS_TAIL_MAX; n++)
+    {
+        if(sc->tails[n/8] & (1 << (n%8)))
+            continue;
+        YC_FAT_AliasMake(sc->alias,sc->alias_len,n,sfn);
+        return 0;
+    }
+    return -1;
+}
 
-/* 生成文件目录项fdi */
-/* 测试通过 */
-static void YC_FAT_GenerateFDI(FDI_t *fdi,char *filename,FDIT_t fdi_t)
+/* 生成长文件名目录项链（按磁盘存放顺序，序号从大到小），返回目录项数目 */
+static J_UINT8 YC_FAT_BuildLFN(J_UINT16 *u16,int len,J_UINT8 *sfn,FDI_t *ents)
 {
-    /* 检查传参合法性 */
-    if((NULL == fdi)||(NULL == filename)||(!IS_FILENAME_ILLEGAL(filename))) return;
-    
-    FDI_t *fdi2full = fdi;
-    char fn[11] = {0};
+    J_UINT8 n = (len + LFN_CHARS_PER_ITEM - 1)/LFN_CHARS_PER_ITEM;
+    J_UINT8 chk = YC_FAT_LFNChkSum(sfn);
+    J_UINT8 ord;
+    LFN_t *l;
+    int k, pos;
 
-    /* create SFN */
-    if(FDIT_FILE == fdi_t)
-        Genfilename_s(filename,fn);
-    else{
-        if((*filename == '.')&&(*(filename+1) == '.')){
-            fn[0] = '.';fn[1] = '.';fn[2]=fn[3]=fn[4]=fn[5]=fn[6]=fn[7]=fn[8]=fn[9]=fn[10] = ' ';
-        }else if(*filename == '.'){
-            fn[0] = '.';fn[1]=fn[2]=fn[3]=fn[4]=fn[5]=fn[6]=fn[7]=fn[8]=fn[9]=fn[10] = ' ';
-        }
-        else if((*filename != '.')&&(*(filename+1) != '.')){
-            Genfilename_s(filename,fn);
+    for(J_UINT8 i = 0; i < n; i++)
+    {
+        l = (LFN_t *)&ents[i];
+        YC_Memset(l, 0, sizeof(LFN_t));
+        ord = n - i;
+        l->ord = ord | ((0 == i) ? LFN_LAST_ORD : 0);
+        l->attribute = ATTR_LFN;
+        l->chksum = chk;
+        /* 文件名以0x0000结束，其后以0xFFFF填充 */
+        for(k = 0; k < LFN_CHARS_PER_ITEM; k++)
+        {
+            pos = (ord - 1)*LFN_CHARS_PER_ITEM + k;
+            YC_FAT_LFNSetChar(l, k, (pos < len) ? u16[pos] : ((pos == len) ? 0x0000 : 0xFFFF));
         }
     }
+    return n;
+}
+#endif
 
-    YC_StrCpy_l((char *)fdi2full->fileName,fn,sizeof(fn));/* fill file name */
-    fdi2full->attribute = (FDIT_FILE == fdi_t)?ARCHIVE:TP_DIR;/* 属性字段文件or目录 */
-	if(*filename == '.')
-		fdi2full->UpLower = 0;
-	else
-		fdi2full->UpLower = (FDIT_FILE == fdi_t)?0x10:0x08;
-    *(J_UINT16 *)fdi2full->startClusUper = 0;
-    *(J_UINT16 *)fdi2full->startClusLower = 0;
-    *(J_UINT32 *)fdi2full->fileSize = 0;
-#if YC_TIMESTAMP_ON
-    *(J_UINT16 *)fdi2full->crtTime = MAKETIME(systime_now());
-    *(J_UINT16 *)fdi2full->crtDate = MAKEDATE(sysdate_now());
+/* 生成新建文件/目录所需的全部目录项（长文件名目录项链及短文件名目录项），返回目录项数目 */
+/* 调用前需以同一扫描上下文完成目录扫描，以获得别名冲突信息 */
+static J_UINT8 YC_FAT_GenerateEntries(dirscan_t *sc,char *filename,FDIT_t fdi_t,FDI_t *ents)
+{
+#if YC_LFN_ON
+    J_UINT8 sfn[11];
+    J_UINT8 n;
+
+    if(NULL != sc->alias)
+    {
+        if(0 != YC_FAT_PickAliasTail(sc,sfn))
+            return 0;
+        n = YC_FAT_BuildLFN(sc->u16,sc->u16_len,sfn,ents);
+        YC_FAT_GenerateFDI(&ents[n],filename,fdi_t);
+        for(int i = 0; i < 8; i++) ents[n].fileName[i] = sfn[i];
+        for(int i = 0; i < 3; i++) ents[n].extName[i] = sfn[8 + i];
+        ents[n].UpLower = 0;
+        return n + 1;
+    }
 #else
-    *(J_UINT16 *)fdi2full->crtTime = 0;
-    *(J_UINT16 *)fdi2full->crtDate = 0;
+    (void)sc;
 #endif
+    YC_FAT_GenerateFDI(&ents[0],filename,fdi_t);
+    return 1;
 }
 
-#define CRT_FILE_OK 0
-#define CRT_SAME_FILE_ERR -1
-#define CRT_FILE_NO_FREE_CLU_ERR -2
+/* 准备目录扫描上下文：需要长文件名时生成别名基名 */
+static void YC_FAT_PrepareCreateScan(dirscan_t *sc,char *filename,J_UINT8 *basis)
+{
+    sc->name = filename;
+#if YC_LFN_ON
+    int l;
+    sc->alias = NULL;
+    if(YC_FAT_NeedLFN(filename))
+    {
+        l = YC_Utf8ToUtf16(filename,sc->u16,YC_LFN_MAXLEN);
+        if(l > 0)
+        {
+            sc->alias_len = YC_FAT_GenAliasBasis(filename,basis);
+            sc->alias = basis;
+        }
+    }
+#else
+    (void)basis;
+#endif
+}
 
-/* create file operation */
-int YC_FAT_CreateFile(char *filepath)
+#if YC_LFN_ON
+#define CRT_MAX_ENTRIES (LFN_MAX_ITEMS + 1)
+#else
+#define CRT_MAX_ENTRIES 1
+#endif
+
+/* 在已解析的目录簇file_clu下创建文件f_n，调用者持有卷写锁 */
+static int YC_FAT_CreateInDirNoLock(VOL_t *vol,unsigned int file_clu,char *f_n)
+{
+    dirscan_t sc = {0};
+    FDI_t ents[CRT_MAX_ENTRIES];
+    J_UINT8 basis[11];
+    J_UINT8 n;
+
+    /* 单次遍历目录：同名检查、空闲目录项定位、别名冲突收集 */
+    YC_FAT_PrepareCreateScan(&sc,f_n,basis);
+    /* 同名文件 返回错误码 */
+    if(FOUND == YC_FAT_ScanDir(vol,file_clu,&sc))
+        return CRT_SAME_FILE_ERR;
+
+    n = YC_FAT_GenerateEntries(&sc,f_n,FDIT_FILE,ents);
+    if(0 == n)
+        return CRT_SAME_FILE_ERR;
+
+    /* 写入目录项，目录空间不足时自动扩展目录簇链 */
+    return YC_FAT_InsertEntries(vol,file_clu,ents,n,NULL);
+}
+
+/* create file operation，调用者持有卷写锁 */
+static int YC_FAT_CreateFileNoLock(VOL_t *vol,char *filepath)
 {
     if(NULL == filepath)
-        return;
-    unsigned int file_clu = 0; char f_n[50] = {0}; char f_p[50] = {0};
-    char fp[50];
-    char FileToMatch[13]; /* 最后一字节为'\0' */
-    unsigned int tail_clu = 0;
+        return ARGVS_ERROR;
+    unsigned int file_clu = 0; char f_n[YC_PATH_MAXLEN] = {0}; char f_p[YC_PATH_MAXLEN] = {0};
+    char fp[YC_PATH_MAXLEN];
 
     /* 文件路径预处理 */
     DelexcSpace(filepath,fp);
     
-    if(!YC_FAT_TakeFN(fp,f_n)) return NULL; if(!YC_FAT_TakeFP(fp,f_p)) return NULL;
-    if(!IS_FILENAME_ILLEGAL(f_p)) return NULL;
+    if(!YC_FAT_TakeFN(fp,f_n)) return ARGVS_ERROR;
+    if(!YC_FAT_TakeFP(fp,f_p)) return ARGVS_ERROR;
+    if(!IS_FILENAME_ILLEGAL(f_n)) return ARGVS_ERROR;
 
     /* 进入文件目录，返回首目录簇 */
-    file_clu = YC_FAT_EnterDir(f_p);
-
-    FDIs_t fdis; FDI_t *fdi;
-    do{
-        tail_clu = file_clu;
-        /* 遍历簇下所有扇区 */
-        for(int i = 0;i < g_dbr[0].secPerClus;i++)
-        {
-            usr_read((unsigned char *)&fdis,START_SECTOR_OF_FILE(file_clu)+i,PER_SECSIZE);
-            fdi = (FDI_t *)&fdis.fdi[0];
-            /* 从当前扇区地址循环偏移固定字节取文件/目录名 */
-            for( ; (unsigned int)fdi < (((unsigned int)&fdis)+PER_SECSIZE) ; fdi ++)
-            {   
-                if(0x00 == *(char *)fdi) 
-                {
-                    YC_FAT_GenerateFDI(fdi,f_n,FDIT_FILE);
-                    /* 回写当前扇区并退出 */
-                    usr_write((char *)&fdis,START_SECTOR_OF_FILE(file_clu)+i,PER_SECSIZE);
-                    return CRT_FILE_OK;
-                }
-                /* 将目录簇中的8*3名转化为字符串类型 */
-                FDI_FileNameToString((char *)fdi->fileName, FileToMatch);
-                /* 同名文件 返回错误码 */
-                if(ycFilenameMatch(FileToMatch,f_n)) return CRT_SAME_FILE_ERR;
-            }
-        }
-        file_clu = YC_TakefileNextClu(file_clu);
-    }while(!IS_EOF(file_clu));
-
-    /* 当前簇空间不足，寻找空簇扩展目录簇链 */
-    /* 寻找第一个空闲簇 */
-    unsigned int freeclu = FatInitArgs_a[0].NextFreeClu;
+    file_clu = YC_FAT_EnterDir(vol,f_p);
+    if((0xffffffff == file_clu) || (0 == file_clu))
+        return ARGVS_ERROR;
 
-    /* 若没有空闲簇，错误返回 */
-    if(0xffffffff == freeclu)
-        return CRT_FILE_NO_FREE_CLU_ERR;
-
-    /* 扩展目录簇链 */
-    YC_FAT_ExpandCluChain(tail_clu,freeclu);
-    YC_FAT_ExpandCluChain(freeclu,0xffffffff);
-
-    /* 在新簇头部写入新fdi */
-    usr_read((unsigned char *)&fdis,START_SECTOR_OF_FILE(freeclu),PER_SECSIZE);
-    fdi = (FDI_t *)&fdis.fdi[0];
-    YC_FAT_GenerateFDI(fdi,f_n,FDIT_FILE);
-    usr_write((unsigned char *)&fdis,START_SECTOR_OF_FILE(freeclu),PER_SECSIZE);
-    
-    /* 更新FSINFO扇区中的空簇数目 */
-    FatInitArgs_a[0].FreeClusNum --;
-    YC_FAT_UpdateFSInfo();
-    /* 寻找下一空闲簇 */
-    if(FatInitArgs_a[0].FreeClusNum)
-        YC_FAT_SeekNextFirstEmptyClu(freeclu,(unsigned int *)&FatInitArgs_a[0].NextFreeClu);
+    return YC_FAT_CreateInDirNoLock(vol,file_clu,f_n);
+}
 
-    return CRT_FILE_OK;
+/* create file operation */
+int YC_FAT_CreateFile(VOL_t *vol,char *filepath)
+{
+    int ret;
+    YC_API_ENTER(YC_OP_CREATE,vol);
+    if(!YC_WriteLock(&vol->rw))
+        return YC_LOCK_BUSY;
+    ret = YC_FAT_CreateFileNoLock(vol,filepath);
+    YC_WriteUnlock(&vol->rw);
+    return ret;
 }
 
 #define CRT_DIR_OK 0
 #define CRT_SAME_DIR_ERR -1
 #define CRT_DIR_NO_FREE_CLU_ERR -2
 /* 在当前簇下创建新目录，p_clu是新目录的父目录簇号 */
-int YC_GenDirInClu(unsigned int thisclu,unsigned int p_clu)
+int YC_GenDirInClu(VOL_t *vol,unsigned int thisclu,unsigned int p_clu)
 {
     FDIs_t fdis; FDI_t *fdi = (FDI_t *)&fdis;
 	YC_Memset((char *)&fdis,0,sizeof(FDIs_t));
@@ -1571,128 +4317,524 @@ int YC_GenDirInClu(unsigned int thisclu,unsigned int p_clu)
 		fdi->startClusLower[0] = p_clu;
 		fdi->startClusLower[1] = p_clu >> 8;
 	}
-    usr_write((unsigned char *)&fdis,START_SECTOR_OF_FILE(thisclu),PER_SECSIZE);
+    YC_DiskWrite(vol,(unsigned char *)&fdis,START_SECTOR_OF_FILE(vol,thisclu),1);
+
+    /* 目录簇其余扇区清零 */
+    YC_Memset((char *)&fdis,0,sizeof(FDIs_t));
+    for(int i = 1;i < vol->dbr.secPerClus;i++)
+        YC_DiskWrite(vol,(unsigned char *)&fdis,START_SECTOR_OF_FILE(vol,thisclu)+i,1);
     return 0;
 }
 
-/* create directory operation */
-int YC_FAT_CreateDir(char *dir)
+/* create directory operation，调用者持有卷写锁 */
+static int YC_FAT_CreateDirNoLock(VOL_t *vol,char *dir)
 {
     if(NULL == dir)
-        return;
-    unsigned int file_clu = 0; char f_n[50] = {0}; char f_p[50] = {0};
-    char fp[50];int freeclu;
-    char FileToMatch[13]; /* 最后一字节为'\0' */
-    unsigned int tail_clu = 0;
+        return ARGVS_ERROR;
+    unsigned int file_clu = 0; char f_n[YC_PATH_MAXLEN] = {0}; char f_p[YC_PATH_MAXLEN] = {0};
+    char fp[YC_PATH_MAXLEN];unsigned int newclu;
+    dirscan_t sc = {0};
+    FDI_t ents[CRT_MAX_ENTRIES];
+    J_UINT8 basis[11];
+    J_UINT8 n;
 
     /* 文件路径预处理 */
     DelexcSpace(dir,fp);
     
-    if(!YC_FAT_TakeFN(fp,f_n)) return NULL; if(!YC_FAT_TakeFP(fp,f_p)) return NULL;
-    if(!IS_FILENAME_ILLEGAL(f_p)) return NULL;
+    if(!YC_FAT_TakeFN(fp,f_n)) return ARGVS_ERROR;
+    if(!YC_FAT_TakeFP(fp,f_p)) return ARGVS_ERROR;
+    if(!IS_FILENAME_ILLEGAL(f_n)) return ARGVS_ERROR;
 
     /* 进入文件目录，返回首目录簇 */
-    file_clu = YC_FAT_EnterDir(f_p);
+    file_clu = YC_FAT_EnterDir(vol,f_p);
+    if((0xffffffff == file_clu) || (0 == file_clu))
+        return ARGVS_ERROR;
+
+    /* 单次遍历目录：同名检查、空闲目录项定位、别名冲突收集 */
+    YC_FAT_PrepareCreateScan(&sc,f_n,basis);
+    /* 同名目录 返回错误码 */
+    if(FOUND == YC_FAT_ScanDir(vol,file_clu,&sc))
+        return CRT_SAME_DIR_ERR;
+
+    n = YC_FAT_GenerateEntries(&sc,f_n,FDIT_DIR,ents);
+    if(0 == n)
+        return CRT_SAME_DIR_ERR;
+
+    /* 判断剩余空闲簇数目是否足够，目录已满时还需扩展父目录 */
+    if((0xffffffff == vol->args.NextFreeClu) ||
+       (VOL_FREE_CLU(vol) < 1 + YC_FAT_HintNeedClu(vol,file_clu,n)))
+        return CRT_DIR_NO_FREE_CLU_ERR;
 
-    FDIs_t fdis; FDI_t *fdi;
-    do{
-        tail_clu = file_clu;
-        /* 遍历簇下所有扇区 */
-        for(int i = 0;i < g_dbr[0].secPerClus;i++)
+    /* 为子目录分配首簇 */
+    newclu = vol->args.NextFreeClu;
+    YC_FAT_ExpandCluChain(vol,newclu,CLU_EOC);
+    vol->args.FreeClusNum --;
+    if(VOL_FREE_CLU(vol))
+        YC_FAT_SeekNextFirstEmptyClu(vol,newclu,(unsigned int *)&vol->args.NextFreeClu);
+    else
+        vol->args.NextFreeClu = 0xffffffff;
+
+    /* 在子目录新簇写入.和..目录项 */
+    YC_GenDirInClu(vol,newclu,file_clu);
+
+    /* 短文件名目录项指向子目录首簇 */
+    ents[n-1].startClusUper[0] = newclu >> 16;
+    ents[n-1].startClusUper[1] = newclu >> 24;
+    ents[n-1].startClusLower[0] = newclu;
+    ents[n-1].startClusLower[1] = newclu >> 8;
+
+    /* 更新FSINFO扇区中的空簇数目 */
+    YC_FAT_UpdateFSInfo(vol);
+
+    /* 写入目录项，目录空间不足时自动扩展目录簇链 */
+    if(CRT_FILE_OK != YC_FAT_InsertEntries(vol,file_clu,ents,n,NULL))
+    {
+        /* 写入失败，归还子目录首簇 */
+        YC_FAT_ExpandCluChain(vol,newclu,0);
+        vol->args.FreeClusNum ++;
+        if(newclu < vol->args.NextFreeClu)
+            vol->args.NextFreeClu = newclu;
+        YC_FAT_UpdateFSInfo(vol);
+        return CRT_DIR_NO_FREE_CLU_ERR;
+    }
+    return CRT_DIR_OK;
+}
+
+/* create directory operation */
+int YC_FAT_CreateDir(VOL_t *vol,char *dir)
+{
+    int ret;
+    YC_API_ENTER(YC_OP_MKDIR,vol);
+    if(!YC_WriteLock(&vol->rw))
+        return YC_LOCK_BUSY;
+    ret = YC_FAT_CreateDirNoLock(vol,dir);
+    YC_WriteUnlock(&vol->rw);
+    return ret;
+}
+
+/* ------------------------------------------ */
+/*             bulk file creation             */
+/* ------------------------------------------ */
+
+/* 单次分配的最大目录簇数 */
+#define BULK_CLU_BATCH 8
+
+/* 批量写目录项的扇区缓冲，连续扇区合并为一次写入 */
+typedef struct
+{
+    VOL_t *vol;                         /* 目录所在卷 */
+    FDIs_t buf[YC_BULK_SEC_NUM];        /* 扇区缓冲 */
+    unsigned int start_sec;             /* 缓冲首扇区的绝对扇区号 */
+    J_UINT8 nsec;                       /* 缓冲中扇区数目，最后一个为当前扇区 */
+    J_UINT8 open;                       /* 当前扇区已在缓冲中 */
+    J_UINT8 fresh;                      /* 当前簇为新分配的目录簇 */
+    fdi_loc_t pos;                      /* 下一个目录项写入位置 */
+    unsigned int clus[BULK_CLU_BATCH];  /* 最近一次分配的目录簇 */
+    J_UINT8 clu_n;                      /* 最近一次分配的目录簇数目 */
+    J_UINT8 clu_i;                      /* 下一个待使用的目录簇 */
+    unsigned int left;                  /* 尚待写入的目录项数目（上界） */
+}bulk_wr_t;
+
+/* 批量创建的哈希槽及写缓冲为所有卷共用，以bulk_lock互斥 */
+static J_UINT32 bulk_slot[YC_BULK_SET_NUM];
+static bulk_wr_t bulk_wr;
+static yc_lock_t bulk_lock;
+
+/* 从NextFreeClu起分配m个空闲簇，链接在tail_clu之后，每个FAT扇区只读写一次 */
+/* 返回实际分配的簇数 */
+static unsigned int YC_FAT_AllocChain(VOL_t *vol,unsigned int tail_clu,unsigned int m,unsigned int *clus)
+{
+    FAT32_Sec_t fat_sec;
+    unsigned int *ent = (unsigned int *)&fat_sec;
+    unsigned int per = PER_SECSIZE/FAT_SIZE;
+    unsigned int end_clu = vol->args.ClusEnd;
+    unsigned int prev = tail_clu, clu = vol->args.NextFreeClu, got = 0, sec;
+    J_UINT8 dirty, wrap = 0;
+
+    while(got < m)
+    {
+        sec = clu/per;
+        YC_DiskRead(vol,(unsigned char *)&fat_sec,vol->args.FAT1Sec+sec,1);
+        dirty = 0;
+        for( ; (clu < (sec + 1)*per) && (clu < end_clu) && (got < m); clu++)
         {
-            usr_read((unsigned char *)&fdis,START_SECTOR_OF_FILE(file_clu)+i,PER_SECSIZE);
-            fdi = (FDI_t *)&fdis.fdi[0];
-            /* 从当前扇区地址循环偏移固定字节取文件/目录名 */
-            for( ; (unsigned int)fdi < (((unsigned int)&fdis)+PER_SECSIZE) ; fdi ++)
-            {   
-                if(0x00 == *(char *)fdi) 
-                {
-                    if(!FatInitArgs_a[0].FreeClusNum)
-						return CRT_DIR_NO_FREE_CLU_ERR;
-                    YC_FAT_GenerateFDI(fdi,f_n,FDIT_DIR);
-                    fdi->startClusUper[0] = FatInitArgs_a[0].NextFreeClu >> 16;
-                    fdi->startClusUper[1] = FatInitArgs_a[0].NextFreeClu >> 24;
-                    fdi->startClusLower[0] = FatInitArgs_a[0].NextFreeClu;
-                    fdi->startClusLower[1] = FatInitArgs_a[0].NextFreeClu >> 8;
-
-                    usr_write((char *)&fdis,START_SECTOR_OF_FILE(file_clu)+i,PER_SECSIZE);
-                    YC_FAT_ExpandCluChain(FatInitArgs_a[0].NextFreeClu,0xffffffff);
-                    YC_GenDirInClu(FatInitArgs_a[0].NextFreeClu,file_clu);
-                    freeclu = FatInitArgs_a[0].NextFreeClu;
-                    YC_FAT_SeekNextFirstEmptyClu(freeclu,(unsigned int *)&FatInitArgs_a[0].NextFreeClu);
-                    
-                    /* 更新FSINFO扇区中的空簇数目 */
-                    FatInitArgs_a[0].FreeClusNum --;
-                    YC_FAT_UpdateFSInfo();
-                    return CRT_DIR_OK;
-                }
-                /* 将目录簇中的8*3名转化为字符串类型 */
-                FDI_FileNameToString((char *)fdi->fileName, FileToMatch);
+            if((clu < 2) || (ent[clu%per] & 0x0fffffff) || YC_FAT_IsReserved(vol,clu))
+                continue;
+            /* 前驱簇在本扇区时直接修改缓冲，否则单独改写其所在FAT扇区 */
+            if(prev/per == sec)
+                ent[prev%per] = clu;
+            else
+                YC_FAT_ExpandCluChain(vol,prev,clu);
+            ent[clu%per] = CLU_EOC;
+            clus[got ++] = prev = clu;
+            dirty = 1;
+        }
+        if(dirty)
+            YC_FAT_PutFatSec(vol,vol->args.FAT1Sec+sec,&fat_sec);
+
+        /* 遍历到FAT表尾后从头开始，只回绕一次 */
+        if(clu >= end_clu)
+        {
+            if(wrap ++) break;
+            clu = 2;
+        }
+    }
+
+    vol->args.FreeClusNum -= got;
+    if(VOL_FREE_CLU(vol))
+        YC_FAT_SeekNextFirstEmptyClu(vol,prev,(unsigned int *)&vol->args.NextFreeClu);
+    else
+        vol->args.NextFreeClu = 0xffffffff;
+    return got;
+}
+
+/* 写出缓冲中的连续扇区 */
+static void YC_FAT_BulkFlush(bulk_wr_t *w)
+{
+    VOL_t *vol = w->vol;
+    if(w->nsec)
+        YC_DiskWrite(vol,(unsigned char *)w->buf,w->start_sec,w->nsec);
+    w->nsec = 0;
+}
+
+/* 将pos所在扇区放入缓冲，与缓冲不连续或缓冲已满时先写出 */
+/* 目录结束标记之后的扇区均空闲，不读盘直接清零 */
+static void YC_FAT_BulkOpenSec(bulk_wr_t *w,J_UINT8 load)
+{
+    VOL_t *vol = w->vol;
+    unsigned int sec = START_SECTOR_OF_FILE(vol,w->pos.clu) + w->pos.sec;
+
+    if(w->nsec && ((YC_BULK_SEC_NUM == w->nsec) || (w->start_sec + w->nsec != sec)))
+        YC_FAT_BulkFlush(w);
+    if(0 == w->nsec)
+        w->start_sec = sec;
+    if(load)
+        YC_DiskRead(vol,(unsigned char *)&w->buf[w->nsec],sec,1);
+    else
+        YC_Memset(&w->buf[w->nsec], 0, sizeof(FDIs_t));
+    w->nsec ++;
+}
+
+/* 写入一个目录项，越过簇尾时进入下一目录簇，已分配的目录簇用完时成批扩展 */
+static int YC_FAT_BulkPut(bulk_wr_t *w,FDI_t *fdi)
+{
+    VOL_t *vol = w->vol;
+    unsigned int per = vol->dbr.secPerClus*FDI_PER_SEC, m;
 
-                /* 同名目录 返回错误码 */
-                if(ycFilenameMatch(FileToMatch,f_n)) return CRT_SAME_DIR_ERR;
+    if(!w->open)
+    {
+        if(vol->dbr.secPerClus == w->pos.sec)
+        {
+            if(w->clu_i == w->clu_n)
+            {
+                m = MIN((w->left + per - 1)/per, BULK_CLU_BATCH);
+                if((0xffffffff == vol->args.NextFreeClu) || (VOL_FREE_CLU(vol) < m))
+                    return CRT_FILE_NO_FREE_CLU_ERR;
+                w->clu_n = YC_FAT_AllocChain(vol,w->pos.clu,m,w->clus);
+                w->clu_i = 0;
+                if(w->clu_n != m)
+                    return CRT_FILE_NO_FREE_CLU_ERR;
             }
+            w->pos.clu = w->clus[w->clu_i ++];
+            w->pos.sec = 0;
+            w->fresh = 1;
         }
-        file_clu = YC_TakefileNextClu(file_clu);
-    }while(!IS_EOF(file_clu));
+        YC_FAT_BulkOpenSec(w,0);
+        w->open = 1;
+    }
+
+    w->buf[w->nsec - 1].fdi[w->pos.idx] = *fdi;
+    w->left --;
+    if(FDI_PER_SEC == ++ w->pos.idx)
+    {
+        w->pos.idx = 0;
+        w->pos.sec ++;
+        w->open = 0;
+    }
+    return CRT_FILE_OK;
+}
 
-    /* 当前簇空间不足，寻找空簇扩展目录簇链 */
-    /* 寻找第一个空闲簇 */
-    freeclu = FatInitArgs_a[0].NextFreeClu;
+/* 写出缓冲，新分配目录簇中未写入的扇区清零 */
+static void YC_FAT_BulkFinish(bulk_wr_t *w)
+{
+    VOL_t *vol = w->vol;
+    if(w->open)
+    {
+        w->pos.sec ++;
+        w->open = 0;
+    }
+    if(w->fresh)
+    {
+        for( ; w->pos.sec < vol->dbr.secPerClus; w->pos.sec ++)
+            YC_FAT_BulkOpenSec(w,0);
+    }
+    /* 多分配的目录簇 */
+    for( ; w->clu_i < w->clu_n; w->clu_i ++)
+    {
+        w->pos.clu = w->clus[w->clu_i];
+        for(w->pos.sec = 0; w->pos.sec < vol->dbr.secPerClus; w->pos.sec ++)
+            YC_FAT_BulkOpenSec(w,0);
+    }
+    YC_FAT_BulkFlush(w);
+}
 
-    /* 若没有空闲簇，错误返回 */
-    if(0xffffffff == freeclu)
-        return CRT_DIR_NO_FREE_CLU_ERR;
+/* 批量创建时的文件名检查：合法性、与目录中及本批次中已有文件名同名 */
+/* 返回所需目录项数目，出错返回错误码 */
+static int YC_FAT_BulkCheck(VOL_t *vol,name_set_t *set,dirscan_t *sc,unsigned int dir_clu,char **names,int *res,int i)
+{
+    char *fn = names[i];
+    J_UINT32 h;
+    int n = 1;
+
+    if((NULL == fn) || ('\0' == *fn) || (YC_StrLen(fn) > YC_NAME_MAXLEN) || (!IS_FILENAME_ILLEGAL(fn)))
+        return ARGVS_ERROR;
+#if YC_LFN_ON
+    int l = YC_Utf8ToUtf16(fn,sc->u16,YC_LFN_MAXLEN);
+    if(l <= 0)
+        return ARGVS_ERROR;
+    h = YC_FAT_NameHash(sc->u16,l);
+    if(YC_FAT_NeedLFN(fn))
+        n = (l + LFN_CHARS_PER_ITEM - 1)/LFN_CHARS_PER_ITEM + 1;
+#else
+    if(YC_StrLen(fn) > 12)
+        return ARGVS_ERROR;
+    h = YC_FAT_StrHash(fn);
+#endif
 
-    /* 判断剩余空闲簇数目是否足够扩展目录 */
-    if(!(FatInitArgs_a[0].FreeClusNum-2))
-        return CRT_DIR_NO_FREE_CLU_ERR;
-    
-    /* 扩展目录簇链 */
-    YC_FAT_ExpandCluChain(tail_clu,freeclu);
-    YC_FAT_ExpandCluChain(freeclu,0xffffffff);
-    YC_FAT_SeekNextFirstEmptyClu(freeclu,(unsigned int *)&FatInitArgs_a[0].NextFreeClu);
-    /* 在当前目录扩展新簇头部写入新fdi */
-    usr_read((unsigned char *)&fdis,START_SECTOR_OF_FILE(freeclu),PER_SECSIZE);
-    YC_Memset(&fdis, 0, sizeof(FDIs_t));
-    fdi = (FDI_t *)&fdis.fdi[0];
-    YC_FAT_GenerateFDI(fdi,f_n,FDIT_DIR);
-    fdi->startClusUper[0] = FatInitArgs_a[0].NextFreeClu >> 16;
-    fdi->startClusUper[1] = FatInitArgs_a[0].NextFreeClu >> 24;
-    fdi->startClusLower[0] = FatInitArgs_a[0].NextFreeClu;
-    fdi->startClusLower[1] = FatInitArgs_a[0].NextFreeClu >> 8;
-    usr_write((unsigned char *)&fdis,START_SECTOR_OF_FILE(freeclu),PER_SECSIZE);
-
-    YC_FAT_ExpandCluChain(FatInitArgs_a[0].NextFreeClu,0xffffffff);
-    /* 在子目录新簇写入fdi */
-    YC_GenDirInClu(FatInitArgs_a[0].NextFreeClu,tail_clu);
+    /* 哈希命中：先与本批次已接受的文件名比较，再遍历目录精确确认 */
+    if(YC_FAT_SetHas(set,h))
+    {
+        for(int k = 0; k < i; k++)
+            if((res[k] > 0) && YC_FAT_NameEqual(names[k],fn))
+                return CRT_SAME_FILE_ERR;
+        sc->set = NULL;
+        sc->name = fn;
+        if(FOUND == YC_FAT_ScanDir(vol,dir_clu,sc))
+            return CRT_SAME_FILE_ERR;
+    }
+    YC_FAT_SetAdd(set,h);
+    return n;
+}
+
+/* 生成批量创建的目录项，长文件名别名以哈希集合避开已有8*3文件名，返回目录项数目 */
+static J_UINT8 YC_FAT_BulkEntries(name_set_t *set,char *filename,J_UINT16 *u16,FDI_t *ents)
+{
+#if YC_LFN_ON
+    J_UINT8 basis[11], sfn[11], basis_len, n;
+    char fn[13];
+    J_UINT32 h;
+    unsigned int t;
+    int l;
+
+    if(YC_FAT_NeedLFN(filename))
+    {
+        l = YC_Utf8ToUtf16(filename,u16,YC_LFN_MAXLEN);
+        basis_len = YC_FAT_GenAliasBasis(filename,basis);
+        for(t = 1; t <= YC_ALIAS_TAIL_MAX; t++)
+        {
+            YC_FAT_AliasMake(basis,basis_len,t,sfn);
+            FDI_FileNameToString((char *)sfn, fn);
+            h = YC_FAT_StrHash(fn);
+            if(!YC_FAT_SetHas(set,h))
+                break;
+        }
+        if(t > YC_ALIAS_TAIL_MAX)
+            return 0;
+        YC_FAT_SetAdd(set,h);
+
+        n = YC_FAT_BuildLFN(u16,l,sfn,ents);
+        YC_FAT_GenerateFDI(&ents[n],filename,FDIT_FILE);
+        for(int i = 0; i < 8; i++) ents[n].fileName[i] = sfn[i];
+        for(int i = 0; i < 3; i++) ents[n].extName[i] = sfn[8 + i];
+        ents[n].UpLower = 0;
+        return n + 1;
+    }
+#else
+    (void)set;
+    (void)u16;
+#endif
+    YC_FAT_GenerateFDI(&ents[0],filename,FDIT_FILE);
+    return 1;
+}
+
+/* 批量创建文件：目录只解析、遍历一次，同名检查在内存哈希集合中完成， */
+/* 新目录项按扇区打包、连续扇区合并写入，目录簇按需成批扩展，FSINFO只更新一次 */
+/* res[i]返回names[i]的创建结果（CRT_FILE_OK或错误码），函数返回成功创建的文件数目 */
+/* 调用者持有卷写锁及bulk_lock */
+static int YC_FAT_CreateManyNoLock(VOL_t *vol,char *dirpath,char **names,int count,int *res)
+{
+    if((NULL == dirpath) || (NULL == names) || (NULL == res) || (count <= 0))
+        return ARGVS_ERROR;
+    unsigned int dir_clu, need = 0, extra = 0, freeNum;
+    char fp[YC_PATH_MAXLEN];
+    dirscan_t sc = {0};
+    name_set_t set;
+    dir_hint_t *h;
+    bulk_wr_t *w = &bulk_wr;
+    FDI_t ents[CRT_MAX_ENTRIES];
+    int i, k, ok = 0, ret = CRT_FILE_OK;
+    J_UINT8 n;
+
+    /* 文件路径预处理 */
+    DelexcSpace(dirpath,fp);
+
+    /* 进入目录，只解析一次路径 */
+    dir_clu = YC_FAT_EnterDir(vol,fp);
+    if((0xffffffff == dir_clu) || (0 == dir_clu))
+        return ARGVS_ERROR;
+
+    /* 单次遍历目录：收集已有文件名哈希，同时刷新空闲目录项提示 */
+    /* 哈希集合先用静态槽，目录较大时由堆扩容 */
+    YC_Memset(bulk_slot, 0, sizeof(bulk_slot));
+    set.slot = bulk_slot; set.size = YC_BULK_SET_NUM; set.cnt = 0; set.full = 0; set.own = 0;
+    sc.set = &set;
+    YC_FAT_ScanDir(vol,dir_clu,&sc);
+
+    /* 合法性及同名检查，统计所需目录项数目及长文件名别名数目 */
+    for(i = 0; (i < count) && (!set.full); i++)
+    {
+        res[i] = YC_FAT_BulkCheck(vol,&set,&sc,dir_clu,names,res,i);
+        if(res[i] > 0) need += res[i];
+        if(res[i] > 1) extra ++;
+    }
+    /* 为别名预留哈希槽，写入过程中不再扩容；堆空间不足时退化为逐个创建 */
+    if(set.full || !YC_FAT_SetReserve(&set,extra))
+        goto one_by_one;
+
+    /* 写入前确认空闲簇足够 */
+    h = YC_FAT_HintLoad(vol,dir_clu);
+    if(NULL == h)
+    {
+        ok = ARGVS_ERROR;
+        goto done;
+    }
+    freeNum = YC_FAT_EndNeedClu(vol,h,need);
+    if(freeNum && ((0xffffffff == vol->args.NextFreeClu) || (VOL_FREE_CLU(vol) < freeNum)))
+    {
+        ok = CRT_FILE_NO_FREE_CLU_ERR;
+        goto done;
+    }
+    if(0 == need)
+        goto done;
+
+    /* 从目录结束标记处开始连续写入 */
+    YC_Memset(w, 0, sizeof(bulk_wr_t));
+    w->vol = vol;
+    w->left = need;
+    if(h->end_valid)
+    {
+        w->pos = h->end;
+        YC_FAT_BulkOpenSec(w,(0 != w->pos.idx));
+        w->open = 1;
+    }
+    else
+    {
+        w->pos.clu = h->tail_clu;
+        w->pos.sec = vol->dbr.secPerClus;
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        if(res[i] <= 0)
+            continue;
+        if(CRT_FILE_OK != ret)
+        {
+            res[i] = ret;
+            continue;
+        }
+#if YC_LFN_ON
+        n = YC_FAT_BulkEntries(&set,names[i],sc.u16,ents);
+#else
+        n = YC_FAT_BulkEntries(&set,names[i],NULL,ents);
+#endif
+        if(0 == n)
+        {
+            w->left -= res[i];
+            res[i] = CRT_SAME_FILE_ERR;
+            continue;
+        }
+        for(k = 0; (k < n) && (CRT_FILE_OK == ret); k++)
+            ret = YC_FAT_BulkPut(w,&ents[k]);
+        res[i] = ret;
+        if(CRT_FILE_OK == ret) ok ++;
+    }
+
+    /* 更新目录提示：新的目录结束标记及末簇 */
+    if(w->clu_n)
+        h->tail_clu = w->clus[w->clu_n - 1];
+    if(w->pos.sec < vol->dbr.secPerClus)
+    {
+        h->end = w->pos;
+        h->end_valid = 1;
+    }
+    else if(w->clu_i < w->clu_n)
+    {
+        h->end.clu = w->clus[w->clu_i];
+        h->end.sec = h->end.idx = 0;
+        h->end_valid = 1;
+    }
+    else
+    {
+        h->end_valid = 0;
+    }
+    YC_FAT_BulkFinish(w);
 
     /* 更新FSINFO扇区中的空簇数目 */
-    FatInitArgs_a[0].FreeClusNum -= 2;
-    YC_FAT_UpdateFSInfo();
-    /* 寻找下一空闲簇 */
-    if(FatInitArgs_a[0].FreeClusNum)
-        YC_FAT_SeekNextFirstEmptyClu(FatInitArgs_a[0].NextFreeClu,(unsigned int *)&FatInitArgs_a[0].NextFreeClu);
+    if(freeNum)
+        YC_FAT_UpdateFSInfo(vol);
+    goto done;
 
-    return CRT_DIR_OK;
+one_by_one:
+    /* 直接在已解析的目录簇中逐个创建 */
+    for(i = 0; i < count; i++)
+    {
+        if((NULL == names[i]) || ('\0' == *names[i]) || (YC_StrLen(names[i]) > YC_NAME_MAXLEN) || (!IS_FILENAME_ILLEGAL(names[i])))
+        {
+            res[i] = ARGVS_ERROR;
+            continue;
+        }
+        res[i] = YC_FAT_CreateInDirNoLock(vol,dir_clu,names[i]);
+        if(CRT_FILE_OK == res[i]) ok ++;
+    }
+done:
+    YC_FAT_SetFree(&set);
+    return ok;
+}
+
+/* 批量创建文件 */
+int YC_FAT_CreateMany(VOL_t *vol,char *dirpath,char **names,int count,int *res)
+{
+    int ret;
+    YC_API_ENTER(YC_OP_CREATE,vol);
+    if(!YC_WriteLock(&vol->rw))
+        return YC_LOCK_BUSY;
+    if(!YC_Lock(&bulk_lock))
+    {
+        YC_WriteUnlock(&vol->rw);
+        return YC_LOCK_BUSY;
+    }
+    ret = YC_FAT_CreateManyNoLock(vol,dirpath,names,count,res);
+    YC_Unlock(&bulk_lock);
+    YC_WriteUnlock(&vol->rw);
+    return ret;
 }
 
 /* 在FAT位图中寻找下一个空簇,找不到下一个空簇就返回-1 */
 /* 测试通过 */
-int SeekNextFreeClu_BitMap(unsigned int clu)
+int SeekNextFreeClu_BitMap(VOL_t *vol,unsigned int clu)
 {
     /* clu在bitmap中的索引 */
     int a = clu%(PER_SECSIZE/FAT_SIZE);
     unsigned char b = a/8;
     char c = a%8;
-    unsigned char * p = ((unsigned char *)clusterBitmap + b);
+    unsigned char * p = ((unsigned char *)vol->clusterBitmap + b);
     unsigned int next = 0;
     char k = 0;
 
     if(c == 7){
         p++;c=-1;
     }
-    for(;p < clusterBitmap + sizeof(clusterBitmap); p++)
+    for(;p < vol->clusterBitmap + sizeof(vol->clusterBitmap); p++)
     {
         if((*p & 0xff) == 0xff)
         {
@@ -1705,7 +4847,7 @@ int SeekNextFreeClu_BitMap(unsigned int clu)
             {
                 if (((*p >> k) & 0x01) != 0x01)
                 {
-                    next = cur_fat_sec*(PER_SECSIZE/FAT_SIZE) +  ((unsigned int)p - (unsigned int)clusterBitmap)*8 + k;
+                    next = vol->cur_fat_sec*(PER_SECSIZE/FAT_SIZE) +  (p - (unsigned char *)vol->clusterBitmap)*8 + k;
                     return next;
                 }
             }
@@ -1716,31 +4858,60 @@ int SeekNextFreeClu_BitMap(unsigned int clu)
     return -1;
 }
 
+/* 写缓冲簇链节点对象池，容量在编译期确定，为所有卷、所有文件共用，分配释放以wbuf_lock互斥 */
+tPOOL_MEM_DEFINE(wbuf_mem, w_buffer_t, YC_WBUF_POOL_NUM);
+static tPool_t wbuf_pool;
+static yc_lock_t wbuf_lock;
+
+static w_buffer_t * YC_WBufAlloc(void)
+{
+    w_buffer_t *w;
+    YC_LockWait(&wbuf_lock);
+    if(0 == wbuf_pool.Capacity)
+        tPoolInit(&wbuf_pool,wbuf_mem,sizeof(w_buffer_t),YC_WBUF_POOL_NUM);
+    w = (w_buffer_t *)tPoolAlloc(&wbuf_pool);
+    YC_Unlock(&wbuf_lock);
+    return w;
+}
+
+static void YC_WBufFree(void *p)
+{
+    YC_LockWait(&wbuf_lock);
+    tPoolFree(&wbuf_pool,p);
+    YC_Unlock(&wbuf_lock);
+}
+
+/* 预留簇是否已全部取完 */
+#define YC_RSV_EMPTY(fl) (((fl)->RsvRunHead == (fl)->RsvRunNum) && list_empty(&(fl)->WRCluChainList))
+
 /* 将空簇添加至文件写缓冲簇链中 */
+/* 溢出链表为空时优先记录在内联簇段中，内联簇段用完后才从对象池分配节点 */
 /* 2023.11.22测试通过 */
-int YC_FAT_AddToList(FILE *fl,unsigned int clu)
+int YC_FAT_AddToList(yc_fnode_t *fl,unsigned int clu)
 {
     if(NULL == fl) return -1;
     w_buffer_t *w_ccb = NULL;
-    struct list_head *pos,*tmp;
+    yc_run_t *r;
 
     if(list_empty(&fl->WRCluChainList))
     {
-        /* 新建第一个节点 */
-        w_ccb = (w_buffer_t *)tAllocHeapforeach(sizeof(w_buffer_t));
-        if(NULL == w_ccb)
+        /* 与最后一个内联簇段连续则并入 */
+        if(fl->RsvRunNum > fl->RsvRunHead)
         {
-            /* 错误处理，删除并释放所有链表节点 */
-            list_for_each_safe(pos, tmp, &fl->WRCluChainList)
+            r = &fl->RsvRun[fl->RsvRunNum - 1];
+            if(clu == (r->e_clu + 1))
             {
-                list_del(pos);
-                tFreeHeapforeach((void *)pos);
+                r->e_clu = clu;
+                return 0;
             }
-            return -1;
         }
-        /* 初始化第一个节点 */
-        w_ccb->w_s_clu = w_ccb->w_e_clu = clu;
-        list_add_tail(&w_ccb->WRCluChainNode,&fl->WRCluChainList);
+        /* 新建内联簇段 */
+        if(fl->RsvRunNum < YC_RSV_RUN_NUM)
+        {
+            r = &fl->RsvRun[fl->RsvRunNum++];
+            r->s_clu = r->e_clu = clu;
+            return 0;
+        }
     }
     else
     {
@@ -1750,73 +4921,256 @@ int YC_FAT_AddToList(FILE *fl,unsigned int clu)
         if(clu == (w_ccb->w_e_clu + 1))
         {
             w_ccb->w_e_clu = clu;
-        }
-        /* 匹配失败则分配新节点 */
-        else
-        {
-            w_ccb = (w_buffer_t *)tAllocHeapforeach(sizeof(w_buffer_t));
-            if(NULL == w_ccb)
-            {
-                /* 错误处理，删除并释放所有链表节点 */
-                list_for_each_safe(pos, tmp, &fl->WRCluChainList)
-                {
-                    list_del(pos);
-                    tFreeHeapforeach((void *)pos);
-                }
-                return -1;
-            }
-            w_ccb->w_s_clu = w_ccb->w_e_clu = clu;
-            list_add_tail(&w_ccb->WRCluChainNode,&fl->WRCluChainList);
+            return 0;
         }
     }
+
+    /* 匹配失败则分配新节点，对象池耗尽时已记录的簇保持不变 */
+    w_ccb = YC_WBufAlloc();
+    if(NULL == w_ccb)
+        return -1;
+    w_ccb->w_s_clu = w_ccb->w_e_clu = clu;
+    list_add_tail(&w_ccb->WRCluChainNode,&fl->WRCluChainList);
     return 0;
 }
 
 /* 2023/11/17注释：基本思路是将含有空簇的FAT表读出来，在调用fwrite时，分配簇，将压缩缓冲簇链记录进mheap中，在save时缝合簇链 */
-/* 预建文件簇链缓冲（链表形式），暂存在theap中 */
-int YC_FAT_CreateFileCluChain(FILE *fl,unsigned int cluNum)
-{
-    unsigned int ret = 0;
-    /* 还原FatInitArgs_a[0].NextFreeClu备用 */
-    unsigned int bkclu = FatInitArgs_a[0].NextFreeClu;
-    /* 还原FatInitArgs_a[0].NextFreeClu备用1 */
-    unsigned int bkclu1;
-
-    /* 遍历bit map，将0位存放到链表中 */
-    while(cluNum--)
-    {
-        if(-1 == YC_FAT_AddToList(fl,FatInitArgs_a[0].NextFreeClu)) //返回-1表示堆栈空间不足
-        {
-            /* 还原历史数据 */
-            FatInitArgs_a[0].NextFreeClu = bkclu;
-            cur_fat_sec = CLU_TO_FATSEC(FatInitArgs_a[0].NextFreeClu);
-            YC_FAT_RemapToBit(cur_fat_sec);
-            /* 退出,返回错误码 */
-            ret = -1;
-            break;
+/* 预建文件簇链缓冲（链表形式），暂存在写缓冲节点对象池中 */
+/* 预留的空簇从文件末簇之后开始寻找，连续簇合并为一个节点，其他文件及目录分配簇时跳过这些簇 */
+/* 多个文件同时追加写时，各自从紧邻末簇的私有窗口中取簇，簇链不会相互交错 */
+/* 返回实际预留的簇数 */
+int YC_FAT_CreateFileCluChain(yc_fnode_t *fl,unsigned int cluNum)
+{
+    VOL_t *vol = fl->vol;
+    J_UINT32 fat_sec[PER_SECSIZE/FAT_SIZE];
+    unsigned int per = PER_SECSIZE/FAT_SIZE;
+    unsigned int end_clu = vol->args.ClusEnd;
+    unsigned int clu, sec = 0xffffffff, got = 0, scanned;
+
+    cluNum = MIN(cluNum, VOL_FREE_CLU(vol));
+    /* 新文件从下一空簇开始 */
+    clu = fl->FirstClu ? fl->EndClu + 1 : vol->args.NextFreeClu;
+    if((clu < 2) || (clu >= end_clu))
+        clu = 2;
+
+    for(scanned = 0; (got < cluNum) && (scanned < end_clu); scanned ++, clu ++)
+    {
+        /* 遍历到FAT表尾后从头开始 */
+        if(clu >= end_clu)
+            clu = 2;
+        if(clu/per != sec)
+        {
+            sec = clu/per;
+            YC_DiskRead(vol,(unsigned char *)fat_sec,vol->args.FAT1Sec+sec,1);
         }
-        FatInitArgs_a[0].NextFreeClu == SeekNextFreeClu_BitMap(FatInitArgs_a[0].NextFreeClu);
-        bkclu1 = FatInitArgs_a[0].NextFreeClu;
-        if(-1 == FatInitArgs_a[0].NextFreeClu)
+        if((fat_sec[clu%per] & 0x0fffffff) || YC_FAT_IsReserved(vol,clu))
+            continue;
+        /* 返回-1表示对象池已耗尽，保留已预留的部分 */
+        if(-1 == YC_FAT_AddToList(fl,clu))
+            break;
+        got ++;
+    }
+    if(0 == got)
+        return 0;
+
+    if(list_empty(&fl->RsvNode))
+        list_add_tail(&fl->RsvNode,&vol->rsv_list);
+    vol->RsvClusNum += got;
+
+    /* 下一空簇落在预留窗口内时后移 */
+    if((0xffffffff != vol->args.NextFreeClu) && YC_FAT_IsReserved(vol,vol->args.NextFreeClu))
+    {
+        if(!VOL_FREE_CLU(vol) || (0 != YC_FAT_SeekNextFirstEmptyClu(vol,vol->args.NextFreeClu,(unsigned int *)&vol->args.NextFreeClu)))
+            vol->args.NextFreeClu = 0xffffffff;
+    }
+    return got;
+}
+
+/* 从预留簇链缓冲头部取至多max个连续簇，返回实际取出的簇数 */
+/* 内联簇段在溢出链表之前，先取内联簇段 */
+static unsigned int YC_FAT_RsvTake(yc_fnode_t *fl,unsigned int max,unsigned int *start)
+{
+    yc_run_t *r;
+    w_buffer_t *w;
+    unsigned int n;
+
+    if(fl->RsvRunHead < fl->RsvRunNum)
+    {
+        r = &fl->RsvRun[fl->RsvRunHead];
+        n = MIN(max, r->e_clu - r->s_clu + 1);
+        *start = r->s_clu;
+        r->s_clu += n;
+        /* 内联簇段全部取完后复位 */
+        if((r->s_clu > r->e_clu) && (++fl->RsvRunHead == fl->RsvRunNum))
+            fl->RsvRunHead = fl->RsvRunNum = 0;
+    }
+    else
+    {
+        w = (w_buffer_t *)(fl->WRCluChainList.next);
+        n = MIN(max, w->w_e_clu - w->w_s_clu + 1);
+        *start = w->w_s_clu;
+        w->w_s_clu += n;
+        if(w->w_s_clu > w->w_e_clu)
         {
-            /* 继续往下找出第一个空闲簇 */
-            FatInitArgs_a[0].NextFreeClu = bkclu1;
-            YC_FAT_SeekNextFirstEmptyClu(FatInitArgs_a[0].NextFreeClu,(unsigned int *)&FatInitArgs_a[0].NextFreeClu);
+            list_del(&w->WRCluChainNode);
+            YC_WBufFree((void *)w);
+        }
+    }
+    fl->vol->RsvClusNum -= n;
+    return n;
+}
+
+/* 归还文件未使用的预留簇 */
+void YC_FAT_RsvRelease(yc_fnode_t *fl)
+{
+    struct list_head *pos,*tmp;
+    w_buffer_t *w;
+    yc_run_t *r;
+
+    for(; fl->RsvRunHead < fl->RsvRunNum; fl->RsvRunHead++)
+    {
+        r = &fl->RsvRun[fl->RsvRunHead];
+        fl->vol->RsvClusNum -= r->e_clu - r->s_clu + 1;
+        if(r->s_clu < fl->vol->args.NextFreeClu)
+            fl->vol->args.NextFreeClu = r->s_clu;
+    }
+    fl->RsvRunHead = fl->RsvRunNum = 0;
+    list_for_each_safe(pos, tmp, &fl->WRCluChainList)
+    {
+        w = (w_buffer_t *)pos;
+        fl->vol->RsvClusNum -= w->w_e_clu - w->w_s_clu + 1;
+        /* 归还的簇位于下一空簇之前时前移，优先复用 */
+        if(w->w_s_clu < fl->vol->args.NextFreeClu)
+            fl->vol->args.NextFreeClu = w->w_s_clu;
+        list_del(pos);
+        YC_WBufFree((void *)pos);
+    }
+    if(!list_empty(&fl->RsvNode))
+        list_del_init(&fl->RsvNode);
+}
+
+/* 将n个连续簇start~start+n-1链接在prev之后（prev为0表示新文件首簇），每个FAT扇区只读写一次 */
+static void YC_FAT_LinkRun(VOL_t *vol,unsigned int prev,unsigned int start,unsigned int n)
+{
+    J_UINT32 fat_sec[PER_SECSIZE/FAT_SIZE];
+    unsigned int per = PER_SECSIZE/FAT_SIZE;
+    unsigned int clu = start, end = start + n, sec;
+
+    /* 前驱簇在其他FAT扇区时单独改写 */
+    if(prev && (prev/per != start/per))
+        YC_FAT_ExpandCluChain(vol,prev,start);
+
+    while(clu < end)
+    {
+        sec = clu/per;
+        YC_DiskRead(vol,(unsigned char *)fat_sec,vol->args.FAT1Sec+sec,1);
+        if(prev && (prev/per == sec))
+            fat_sec[prev%per] = start;
+        for( ; (clu < end) && (clu/per == sec); clu ++)
+            fat_sec[clu%per] = (clu + 1 == end) ? CLU_EOC : (clu + 1);
+        YC_FAT_PutFatSec(vol,vol->args.FAT1Sec+sec,fat_sec);
+    }
+}
+
+/* 聚集写游标：当前数据段及段内已写偏移 */
+typedef struct
+{
+    const yc_iovec_t *iov;
+    int cnt;
+    unsigned int off;
+}yc_iocur_t;
+
+/* 跳过已写完的数据段，停在最后一段 */
+static void YC_FAT_IoSkip(yc_iocur_t *c)
+{
+    while((c->cnt > 1) && (c->off >= c->iov->iov_len))
+    {
+        c->iov ++;
+        c->cnt --;
+        c->off = 0;
+    }
+}
+
+/* 从游标处拷贝len字节，可跨越多个数据段 */
+static void YC_FAT_IoCopy(yc_iocur_t *c,unsigned char *dst,unsigned int len)
+{
+    unsigned int k;
+    while(len)
+    {
+        YC_FAT_IoSkip(c);
+        k = MIN(len, c->iov->iov_len - c->off);
+        if(0 == k)
+            break;
+        memcpy(dst,(unsigned char *)c->iov->iov_base + c->off,k);
+        c->off += k;
+        dst += k;
+        len -= k;
+    }
+}
+
+/* 从连续簇链clu起第off字节处写入游标处的数据，ncl为连续簇数目，返回实际写入的字节数 */
+/* 数据段内对齐的整扇区直接写入设备，首扇区不对齐时读改写，跨段或不满一扇区的部分经扇区缓冲拼接 */
+static unsigned int YC_FAT_WriteRun(VOL_t *vol,unsigned int clu,unsigned int off,unsigned int ncl,yc_iocur_t *cur,unsigned int len)
+{
+    unsigned char sbuf[PER_SECSIZE];
+    unsigned int sec0 = START_SECTOR_OF_FILE(vol,clu);
+    unsigned int n = MIN(len, ncl*PER_SECSIZE*vol->dbr.secPerClus - off);
+    unsigned int done = 0, full, k, sec;
 
-            /* 继续将下一空闲簇所在FAT扇区映射 */
-            cur_fat_sec = CLU_TO_FATSEC(FatInitArgs_a[0].NextFreeClu);
-            if((FatInitArgs_a[0].NextFreeClu != 0xffffffff) && (FatInitArgs_a[0].NextFreeClu != 0))
-                YC_FAT_RemapToBit(cur_fat_sec);
+    while(done < n)
+    {
+        sec = sec0 + (off + done)/PER_SECSIZE;
+        k = (off + done)%PER_SECSIZE;
+        YC_FAT_IoSkip(cur);
+        full = MIN(cur->iov->iov_len - cur->off, n - done)/PER_SECSIZE;
+        if((0 == k) && full)
+        {
+            /* 整扇区 */
+            YC_DiskWrite(vol,(unsigned char *)cur->iov->iov_base + cur->off,sec,full);
+            cur->off += full*PER_SECSIZE;
+            done += full*PER_SECSIZE;
+            continue;
         }
+        /* 扇区拼接，文件末尾之后补零 */
+        if(k)
+            YC_DiskRead(vol,sbuf,sec,1);
+        else
+            YC_Memset(sbuf, 0, PER_SECSIZE);
+        full = MIN(n - done, PER_SECSIZE - k);
+        YC_FAT_IoCopy(cur,sbuf + k,full);
+        YC_DiskWrite(vol,sbuf,sec,1);
+        done += full;
     }
-    return ret;
+    return done;
+}
+
+/* 回写文件目录项中的首簇及文件大小 */
+static void YC_FAT_UpdateFileFDI(VOL_t *vol,yc_fnode_t *fl)
+{
+    FDIs_t fdis;
+    FDI_t *fdi = &fdis.fdi[fl->dir_loc.idx];
+    unsigned int sec = START_SECTOR_OF_FILE(vol,fl->dir_loc.clu) + fl->dir_loc.sec;
+
+    YC_DiskRead(vol,(unsigned char *)&fdis,sec,1);
+    fdi->startClusUper[0] = fl->FirstClu >> 16;
+    fdi->startClusUper[1] = fl->FirstClu >> 24;
+    fdi->startClusLower[0] = fl->FirstClu;
+    fdi->startClusLower[1] = fl->FirstClu >> 8;
+    fdi->fileSize[0] = fl->fl_sz;
+    fdi->fileSize[1] = fl->fl_sz >> 8;
+    fdi->fileSize[2] = fl->fl_sz >> 16;
+    fdi->fileSize[3] = fl->fl_sz >> 24;
+    YC_DiskWrite(vol,(unsigned char *)&fdis,sec,1);
 }
 
 #if PRINT_DEBUG_ON
 /* 列出文件所有写压缩缓冲簇链 */
-void YC_FAT_ListFileCluChain(FILE *fl)
+void YC_FAT_ListFileCluChain(yc_fnode_t *fl)
 {
     struct list_head *pos;
+    unsigned int i;
+    for(i = fl->RsvRunHead; i < fl->RsvRunNum; i++)
+        printf("start_clu = %d,end_clu = %d\n",fl->RsvRun[i].s_clu,fl->RsvRun[i].e_clu);
     if(!list_empty(&fl->WRCluChainList))
     {
         list_for_each(pos, &fl->WRCluChainList)
@@ -1827,16 +5181,95 @@ void YC_FAT_ListFileCluChain(FILE *fl)
 }
 #endif
 
-/* 临时交换区 */
-static unsigned int buffer1[PER_SECSIZE];
-
 /* 写文件，只支持在文件末尾追加数据 */
 //JYCFAT库只需要向底层提供起始扇区，写扇区数两个参数即可！
 //对于多文件并发写入时，采用一些策略来优化簇的分配，确保并发写入的正确性
 //策略1：定义互斥量mutex，while(1)等待互斥量释放，只建议独立线程中使用，其他情况不建议使用
 //策略2：定义互斥量mutex，非阻塞等待，若互斥量不可用，直接返回错误码
 //策略3：定义互斥量mutex，阻塞等待，若互斥量不可用，陷入内核
-int YC_WriteDataNoCheck(FILE* fileInfo,unsigned char * d_buf,unsigned int len)
+//三种策略分别对应YC_LOCK_SPIN、YC_LOCK_TRY、YC_LOCK_BLOCK，由YC_LOCK_MODE在编译期选择
+#define WR_NO_FREE_CLU_ERR -4
+#define WR_NOT_ALIGN_ERR -5     /* 直接I/O句柄的写入位置或长度不是扇区对齐 */
+
+static void YC_FAT_ZeroSecs(VOL_t *vol,unsigned int sec,unsigned int n);
+
+/* 文件预留窗口中的簇数，调用者持有节点追加锁 */
+static unsigned int YC_FAT_RsvClus(yc_fnode_t *fl)
+{
+    struct list_head *pos;
+    w_buffer_t *w;
+    unsigned int i, n = 0;
+
+    for(i = fl->RsvRunHead; i < fl->RsvRunNum; i ++)
+        n += fl->RsvRun[i].e_clu - fl->RsvRun[i].s_clu + 1;
+    list_for_each(pos, &fl->WRCluChainList)
+    {
+        w = (w_buffer_t *)pos;
+        n += w->w_e_clu - w->w_s_clu + 1;
+    }
+    return n;
+}
+
+/* 按预留顺序把游标处的len字节写入预留簇（不取出），cur为NULL时将相应的整簇清零，返回写入的字节数 */
+/* 预留簇尚未缝合进文件，调用者持有节点追加锁及卷读锁即可 */
+static unsigned int YC_FAT_RsvWrite(yc_fnode_t *fl,yc_iocur_t *cur,unsigned int len)
+{
+    VOL_t *vol = fl->vol;
+    unsigned int clu_sz = PER_SECSIZE*vol->dbr.secPerClus;
+    struct list_head *pos;
+    w_buffer_t *w;
+    unsigned int i, s, e, n, done = 0;
+
+    pos = fl->WRCluChainList.next;
+    for(i = fl->RsvRunHead; done < len; i ++)
+    {
+        if(i < fl->RsvRunNum)
+        {
+            s = fl->RsvRun[i].s_clu;
+            e = fl->RsvRun[i].e_clu;
+        }
+        else if(pos != &fl->WRCluChainList)
+        {
+            w = (w_buffer_t *)pos;
+            s = w->w_s_clu;
+            e = w->w_e_clu;
+            pos = pos->next;
+        }
+        else
+            break;
+        if(cur)
+        {
+            done += YC_FAT_WriteRun(vol,s,0,e - s + 1,cur,len - done);
+            continue;
+        }
+        n = MIN(e - s + 1, (len - done + clu_sz - 1)/clu_sz);
+        YC_FAT_ZeroSecs(vol,START_SECTOR_OF_FILE(vol,s),n*vol->dbr.secPerClus);
+        done += MIN(len - done, n*clu_sz);
+    }
+    return done;
+}
+
+/* 从预留窗口头部取n个簇依次缝合到文件末簇之后，调用者持有节点追加锁及卷写锁 */
+static void YC_FAT_RsvLink(yc_fnode_t *fl,unsigned int n)
+{
+    unsigned int start, k;
+    while(n)
+    {
+        k = YC_FAT_RsvTake(fl,n,&start);
+        YC_FAT_LinkRun(fl->vol,fl->FirstClu ? fl->EndClu : 0,start,k);
+        if(0 == fl->FirstClu)
+            fl->FirstClu = start;
+        fl->EndClu = start + k - 1;
+        fl->vol->args.FreeClusNum -= k;
+        n -= k;
+    }
+}
+
+/* 追加写核心，调用者只持有文件锁，wait为0时按YC_LOCK_MODE尝试加锁，被占用返回YC_LOCK_BUSY */
+/* 同一文件的追加写由节点追加锁串行，每轮分三段：卷写锁下预留足够的簇；卷读锁下把数据写入末簇剩余部分及预留簇， */
+/* 新数据都在文件大小之外，读者不会访问；再在卷写锁下缝合簇链并更新文件大小及目录项 */
+/* 簇从文件私有的预留窗口中分配，窗口用完时在末簇之后重新预留，多文件交替追加时各自的簇链保持连续 */
+static int YC_WriteDataV(FILE* fileInfo,yc_iocur_t *cur,unsigned int len,J_UINT8 wait)
 {
     if(NULL == fileInfo)
         return -1;
@@ -1844,60 +5277,561 @@ int YC_WriteDataNoCheck(FILE* fileInfo,unsigned char * d_buf,unsigned int len)
         return -2;
     if(0 == len)
         return -3;
+    VOL_t *vol = fileInfo->vol;
+    yc_fnode_t *fn = fileInfo->node;
+    unsigned int clu_sz = PER_SECSIZE*vol->dbr.secPerClus;
+    unsigned int done = 0, used, room, need, have, k, n, alloc = 0;
+    int ret = 0;
+
+    if(wait)
+        YC_LockWait(&fn->wr_lock);
+    else if(!YC_Lock(&fn->wr_lock))
+        return YC_LOCK_BUSY;
+    /* 直接I/O只写整扇区，数据从用户缓冲直接写入设备 */
+    if((fileInfo->flags & YC_O_DIRECT) && ((fn->fl_sz % PER_SECSIZE) || (len % PER_SECSIZE)))
+    {
+        YC_Unlock(&fn->wr_lock);
+        return WR_NOT_ALIGN_ERR;
+    }
+    if(wait)
+        YC_WriteLockWait(&vol->rw);
+    else if(!YC_WriteLock(&vol->rw))
+    {
+        YC_Unlock(&fn->wr_lock);
+        return YC_LOCK_BUSY;
+    }
+
+    while(done < len)
+    {
+        /* 末簇已写大小，空文件或末簇已写满时需要新簇 */
+        used = fn->fl_sz % clu_sz;
+        room = (fn->FirstClu && (fn->fl_sz == 0 || used)) ? (clu_sz - used) : 0;
+        need = (len - done > room) ? (len - done - room + clu_sz - 1)/clu_sz : 0;
+        /* 预留窗口不够时紧邻末簇补充预留，对象池耗尽时本轮只写已预留的部分 */
+        have = YC_FAT_RsvClus(fn);
+        while((have < need) && (0 != (n = YC_FAT_CreateFileCluChain(fn,MAX(need - have,YC_RSV_CLU_NUM)))))
+            have += n;
+        k = MIN(len - done, room + MIN(have, need)*clu_sz);
+        if(0 == k)
+        {
+            ret = WR_NO_FREE_CLU_ERR;
+            break;
+        }
+        YC_WriteUnlock(&vol->rw);
+
+        YC_ReadLockWait(&vol->rw);
+        n = room ? YC_FAT_WriteRun(vol,fn->EndClu,used,1,cur,k) : 0;
+        if(n < k)
+            n += YC_FAT_RsvWrite(fn,cur,k - n);
+        YC_ReadUnlock(&vol->rw);
+
+        /* 缝合写入的簇，更新共享节点中的文件大小及目录项，各句柄读取时同步 */
+        YC_WriteLockWait(&vol->rw);
+        need = (n > room) ? (n - room + clu_sz - 1)/clu_sz : 0;
+        YC_FAT_RsvLink(fn,need);
+        alloc += need;
+        fn->fl_sz += n;
+        fn->EndCluLeftSize = (fn->fl_sz % clu_sz) ? (clu_sz - fn->fl_sz % clu_sz) : 0;
+        YC_FAT_UpdateFileFDI(vol,fn);
+        done += n;
+    }
+
+    YC_STAT_ADD(vol,YC_ST_BYTES_WR,done);
+    /* 更新FSINFO扇区中的空簇数目 */
+    if(alloc)
+        YC_FAT_UpdateFSInfo(vol);
+    YC_WriteUnlock(&vol->rw);
+    YC_Unlock(&fn->wr_lock);
+    return ret;
+}
+
+/* 写出一块连续数据，wrote不为NULL时返回实际写出的字节数（出错时可能只写出一部分） */
+static int YC_WriteData(FILE* fileInfo,unsigned char * d_buf,unsigned int len,J_UINT8 wait,unsigned int *wrote)
+{
+    yc_iovec_t iov;
+    yc_iocur_t cur;
+    int ret;
+    iov.iov_base = d_buf;
+    iov.iov_len = len;
+    cur.iov = &iov;
+    cur.cnt = 1;
+    cur.off = 0;
+    ret = YC_WriteDataV(fileInfo,&cur,len,wait);
+    if(wrote)
+        *wrote = cur.off;
+    return ret;
+}
+
+/* 写文件：加文件锁后追加，簇分配及FAT缝合期间持卷写锁，数据写入期间只持卷读锁 */
+int YC_WriteDataNoCheck(FILE* fileInfo,unsigned char * d_buf,unsigned int len)
+{
+    int ret;
+    if(NULL == fileInfo)
+        return -1;
+    YC_API_ENTER(YC_OP_FWRITE,YC_FL_VOL(fileInfo));
+    if(!YC_Lock(&fileInfo->lock))
+        return YC_LOCK_BUSY;
+    ret = YC_WriteData(fileInfo,d_buf,len,0,NULL);
+    YC_Unlock(&fileInfo->lock);
+    return ret;
+}
+
+/* 写出缓冲中积累的数据，调用者持有文件锁，wait含义同YC_WriteDataV */
+/* 失败时未写出的数据移到缓冲头部保留，下次写出时重试 */
+static int YC_FAT_BufFlush(FILE *fl,J_UINT8 wait)
+{
+    unsigned int n = 0, i;
+    int ret = 0;
+    if(fl->BufWr && fl->BufPos)
+    {
+        ret = YC_WriteData(fl,fl->pBuf,fl->BufPos,wait,&n);
+        for(i = n; n && (i < fl->BufPos); i ++)
+            fl->pBuf[i - n] = fl->pBuf[i];
+        fl->BufPos -= n;
+    }
+    return ret;
+}
 
-    /* 记录剩余大小 */
-    unsigned int left_size = len;
+/* 设置文件的用户态缓冲，应在打开文件后、读写之前调用 */
+/* buf为NULL时使用描述符的静态缓冲（size为0或超过YC_FILE_BUF_SIZE时取YC_FILE_BUF_SIZE），否则size为0时取簇大小；mode为YC_IONBF时不使用缓冲 */
+/* 缓冲区取簇大小的整数倍时，小块读写合并为整簇读写 */
+int setvbuf(FILE *fl,void *buf,int mode,unsigned int size)
+{
+    int ret = 0;
+    VOL_t *vol;
+    if((NULL == fl) || (mode < YC_IOFBF) || (mode > YC_IONBF))
+        return -1;
+    /* 直接I/O句柄不使用缓冲 */
+    if((fl->flags & YC_O_DIRECT) && (YC_IONBF != mode))
+        return -1;
+    YC_API_ENTER(YC_OP_FWRITE,YC_FL_VOL(fl));
+    YC_LockWait(&fl->lock);
+    vol = fl->vol;
+    if(FILE_OPEN != fl->file_state)
+    {
+        YC_Unlock(&fl->lock);
+        return -1;
+    }
+    /* 预读的数据尚未读完时不能更换缓冲 */
+    if(!fl->BufWr && (fl->BufPos < fl->BufLen))
+    {
+        YC_Unlock(&fl->lock);
+        return -1;
+    }
+    /* 缓冲中的数据写不出时保留原缓冲 */
+    if(fl->BufWr && (0 != (ret = YC_FAT_BufFlush(fl,1))))
+    {
+        YC_Unlock(&fl->lock);
+        return ret;
+    }
+    fl->pBuf = NULL;
+    fl->BufSize = fl->BufPos = fl->BufLen = 0;
+    fl->BufWr = 0;
+    fl->BufMode = YC_IONBF;
 
-    /* 计算需要的空闲簇数，注意文件末簇是否写完 */
-    unsigned int to_alloc_num;
-    to_alloc_num = (len > fileInfo->EndCluLeftSize)?\
-        ( (len - fileInfo->EndCluLeftSize)/(PER_SECSIZE*g_dbr[0].secPerClus) + 1 ) : 1;
-    if((len - fileInfo->EndCluLeftSize)%(PER_SECSIZE*g_dbr[0].secPerClus)) 
-        to_alloc_num ++;
-        
-    /* 预生成文件簇链 */
-    if(to_alloc_num > 1)
+    if(YC_IONBF != mode)
     {
-        if(0 > YC_FAT_CreateFileCluChain(fileInfo,to_alloc_num-1))
+        if(NULL == buf)
         {
-            /* 错误处理 */
-            return -1;
+            buf = yc_fd_buf[fl->fd];
+            if((0 == size) || (size > YC_FILE_BUF_SIZE))
+                size = YC_FILE_BUF_SIZE;
         }
+        else if(0 == size)
+            size = PER_SECSIZE*vol->dbr.secPerClus;
+        fl->pBuf = (unsigned char *)buf;
+        fl->BufSize = size;
+        fl->BufMode = mode;
     }
-    /* 灌数据 */
-    if(to_alloc_num == 1){
-        /* 锚定尾扇区 */
-        char endsec = fileInfo->fl_sz%(PER_SECSIZE*g_dbr[0].secPerClus);
-    }else{
-        usr_write(d_buf,1,100);
+    YC_Unlock(&fl->lock);
+    return ret;
+}
+
+/* 写文件（追加），经用户态缓冲积累，缓冲满、行缓冲遇到换行符或fflush/fclose时写出 */
+/* 缓冲为空且数据不小于缓冲区时直接写出；缓冲中有未读完的预读数据时不经缓冲 */
+/* 返回接受的字节数（已写出或已放入缓冲），YC_LOCK_TRY模式下被占用或空簇不足时小于len，放入缓冲的数据在下次写出时重试 */
+/* 不使用fwrite作函数名，避免与编译器内建的fwrite声明冲突（编译器可能把printf等改写为调用fwrite） */
+J_UINT32 YC_FAT_fwrite(FILE *f_wr,unsigned int len,void *buffer)
+{
+    unsigned char *d = (unsigned char *)buffer;
+    unsigned int done = 0, n, i;
+    int ret = 0;
+    J_UINT8 flush = 0;
+
+    if((NULL == f_wr)||(0 == len)||(NULL == buffer))
+        return 0;
+    YC_API_ENTER(YC_OP_FWRITE,YC_FL_VOL(f_wr));
+    if(!YC_Lock(&f_wr->lock))
+        return 0;
+    if(FILE_OPEN != f_wr->file_state)
+    {
+        YC_Unlock(&f_wr->lock);
+        return 0;
     }
 
-    struct list_head *pos,*tmp;
-    /* 修改FAT表缝合簇链 */
-    list_for_each_safe(pos, tmp, &fileInfo->WRCluChainList)
+    /* 无缓冲 */
+    if((YC_IONBF == f_wr->BufMode) || (NULL == f_wr->pBuf) || (!f_wr->BufWr && (f_wr->BufPos < f_wr->BufLen)))
+    {
+        YC_WriteData(f_wr,d,len,0,&done);
+        YC_Unlock(&f_wr->lock);
+        return done;
+    }
+
+    /* 缓冲转为写 */
+    if(!f_wr->BufWr)
+    {
+        f_wr->BufWr = 1;
+        f_wr->BufPos = f_wr->BufLen = 0;
+    }
+    if(YC_IOLBF == f_wr->BufMode)
     {
-        /* 找到压缩簇链所在FAT表扇区 */
-        /* 先找出首簇所在FAT扇区 */
-        unsigned int headsec = CLU_TO_FATSEC(((w_buffer_t *)pos)->w_s_clu);
+        for(i = 0; (i < len) && ('\n' != d[i]); i ++);
+        flush = (i < len);
+    }
 
-        for(;;)
-        {   
-            /* 同扇区FAT缝合 */
-            if(1){break;}
+    while((done < len) && (0 == ret))
+    {
+        /* 缓冲为空且剩余数据不小于缓冲区，直接写出 */
+        if((0 == f_wr->BufPos) && (len - done >= f_wr->BufSize))
+        {
+            YC_WriteData(f_wr,d + done,len - done,0,&n);
+            done += n;
+            break;
         }
-        usr_write(cur_fat_sec,1,100);
+        /* 上次写出失败时缓冲可能仍是满的，此时n为0，直接重试写出 */
+        n = MIN(len - done, f_wr->BufSize - f_wr->BufPos);
+        memcpy(f_wr->pBuf + f_wr->BufPos,d + done,n);
+        f_wr->BufPos += n;
+        done += n;
+        if((f_wr->BufPos == f_wr->BufSize) || (flush && (done == len)))
+            ret = YC_FAT_BufFlush(f_wr,0);
+    }
+    YC_Unlock(&f_wr->lock);
+    return done;
+}
+
+/* 聚集写（追加）：各数据段按顺序写入文件，免去调用者先拷贝到一块缓冲 */
+/* 文件缓冲中积累的数据先写出，返回写入的总字节数，失败时返回0 */
+J_UINT32 writev(FILE *fl,const yc_iovec_t *iov,int iovcnt)
+{
+    yc_iocur_t cur;
+    unsigned int total = 0;
+    int i, ret;
 
-        /* 备份FAT1至FAT2 */
-        {;}
+    if((NULL == fl)||(NULL == iov)||(iovcnt <= 0))
+        return 0;
+    YC_API_ENTER(YC_OP_FWRITE,YC_FL_VOL(fl));
+    for(i = 0; i < iovcnt; i ++)
+    {
+        /* 直接I/O时各段都须整扇区，跨段的扇区不经扇区缓冲拼接 */
+        if((fl->flags & YC_O_DIRECT) && (iov[i].iov_len % PER_SECSIZE))
+            return 0;
+        total += iov[i].iov_len;
+    }
+    if(0 == total)
+        return 0;
+    if(!YC_Lock(&fl->lock))
+        return 0;
+    if(FILE_OPEN != fl->file_state)
+    {
+        YC_Unlock(&fl->lock);
+        return 0;
+    }
+    ret = YC_FAT_BufFlush(fl,0);
+    if(0 == ret)
+    {
+        cur.iov = iov;
+        cur.cnt = iovcnt;
+        cur.off = 0;
+        ret = YC_WriteDataV(fl,&cur,total,0);
     }
+    YC_Unlock(&fl->lock);
+    return (0 == ret) ? total : 0;
+}
+
+/* ------------------------------------------ */
+/*                卷内文件复制                  */
+/* ------------------------------------------ */
+#define CPY_SRC_ERR -1          /* 源文件不存在 */
+#define CPY_DST_ERR -2          /* 目标文件已存在或无法创建 */
+#define CPY_NO_FREE_CLU_ERR -3  /* 空簇不足，目标文件只含已复制的部分 */
+
+/* 将源文件接下来的数据复制到连续簇s_clu~e_clu中，left为尚未复制的字节数，返回本段复制的字节数 */
+/* 源文件经读核心按簇内连续扇区读入缓冲，再整段写入目标簇，缓冲中文件末尾之后的部分补零 */
+static unsigned int YC_FAT_CopyRun(FILE *fs,unsigned int s_clu,unsigned int e_clu,unsigned char *buf,unsigned int bsz,unsigned int left)
+{
+    VOL_t *vol = fs->vol;
+    unsigned int sec = START_SECTOR_OF_FILE(vol,s_clu);
+    unsigned int n = MIN(left, (e_clu - s_clu + 1)*PER_SECSIZE*vol->dbr.secPerClus);
+    unsigned int done = 0, k, got, nsec;
 
-    /* 删除写压缩缓冲簇链，释放内存 */
-    list_for_each_safe(pos, tmp, &fileInfo->WRCluChainList)
+    while(done < n)
     {
-        list_del(pos);
-        tFreeHeapforeach((void *)pos);
+        k = MIN(n - done, bsz);
+        got = YC_ReadDataNoCheck(fs,k,buf);
+        if(0 == got)
+            break;
+        nsec = (got + PER_SECSIZE - 1)/PER_SECSIZE;
+        if(got % PER_SECSIZE)
+            YC_Memset(buf + got, 0, nsec*PER_SECSIZE - got);
+        YC_DiskWrite(vol,buf,sec,nsec);
+        sec += nsec;
+        done += got;
     }
-    return 0;
+    YC_STAT_ADD(vol,YC_ST_BYTES_WR,done);
+    return done;
+}
+
+/* 复制文件数据，调用者持有源、目标文件锁及目标节点追加锁，目标文件为空 */
+/* 每轮为剩余数据预留尽量连续的簇，在卷读锁下把数据写入预留簇（预留簇不属于任何文件，其他读者不会访问）， */
+/* 再在卷写锁下逐段缝合本轮簇链并一次更新目录项及FSINFO，预留受对象池限制时分多轮完成 */
+static int YC_FAT_CopyNoLock(FILE *fs,FILE *fd,unsigned char *buf,unsigned int bsz)
+{
+    VOL_t *vol = fs->vol;
+    yc_fnode_t *fn = fd->node;
+    unsigned int clu_sz = PER_SECSIZE*vol->dbr.secPerClus;
+    unsigned int total, done = 0, round, n, i;
+    struct list_head *pos;
+    w_buffer_t *w;
+    int ret = 0;
+
+    YC_ReadLockWait(&vol->rw);
+    total = fs->node->fl_sz;
+    YC_ReadUnlock(&vol->rw);
+
+    while(done < total)
+    {
+        YC_WriteLockWait(&vol->rw);
+        n = YC_FAT_CreateFileCluChain(fn,(total - done + clu_sz - 1)/clu_sz);
+        YC_WriteUnlock(&vol->rw);
+        if(0 == n)
+        {
+            ret = CPY_NO_FREE_CLU_ERR;
+            break;
+        }
+
+        /* 数据写入预留簇 */
+        round = 0;
+        YC_ReadLockWait(&vol->rw);
+        for(i = fn->RsvRunHead; i < fn->RsvRunNum; i ++)
+            round += YC_FAT_CopyRun(fs,fn->RsvRun[i].s_clu,fn->RsvRun[i].e_clu,buf,bsz,total - done - round);
+        list_for_each(pos, &fn->WRCluChainList)
+        {
+            w = (w_buffer_t *)pos;
+            round += YC_FAT_CopyRun(fs,w->w_s_clu,w->w_e_clu,buf,bsz,total - done - round);
+        }
+        YC_ReadUnlock(&vol->rw);
+
+        /* 缝合本轮写入数据的簇，源文件被截断时多余的预留簇在关闭文件时归还 */
+        YC_WriteLockWait(&vol->rw);
+        YC_FAT_RsvLink(fn,(round + clu_sz - 1)/clu_sz);
+        fn->fl_sz += round;
+        fn->EndCluLeftSize = (fn->fl_sz % clu_sz) ? (clu_sz - fn->fl_sz % clu_sz) : 0;
+        YC_FAT_UpdateFileFDI(vol,fn);
+        YC_FAT_UpdateFSInfo(vol);
+        YC_WriteUnlock(&vol->rw);
+
+        done += round;
+        /* 源文件提前结束（被截断） */
+        if(round < n*clu_sz && (done < total))
+            break;
+    }
+    return ret;
+}
+
+/* 复制缓冲取整扇区，各次复制共用，由copy_lock串行，不依赖堆 */
+static unsigned char yc_copy_buf[YC_COPY_BUF_SIZE - YC_COPY_BUF_SIZE%PER_SECSIZE];
+static yc_lock_t copy_lock;
+
+/* 在卷内复制文件，目标文件不能已存在 */
+/* 数据经静态复制缓冲以多扇区读写搬运，不经过调用者的缓冲，目标文件簇尽量连续分配 */
+/* 同一时刻只进行一次复制，YC_LOCK_TRY模式下有其他复制进行时返回YC_LOCK_BUSY */
+int YC_FAT_CopyFile(VOL_t *vol,char *src,char *dst)
+{
+    FILE fs = {0}, fd = {0};
+    int ret;
+
+    if((NULL == vol) || (NULL == src) || (NULL == dst))
+        return ARGVS_ERROR;
+    YC_API_ENTER(YC_OP_COPY,vol);
+    if(!YC_Lock(&copy_lock))
+        return YC_LOCK_BUSY;
+    if(NULL == YC_FAT_fopen(vol,&fs,src))
+    {
+        YC_Unlock(&copy_lock);
+        return CPY_SRC_ERR;
+    }
+    ret = YC_FAT_CreateFile(vol,dst);
+    if((0 != ret) || (NULL == YC_FAT_fopen(vol,&fd,dst)))
+    {
+        fclose(&fs);
+        YC_Unlock(&copy_lock);
+        return (YC_LOCK_BUSY == ret) ? ret : CPY_DST_ERR;
+    }
+
+    YC_LockWait(&fs.lock);
+    YC_LockWait(&fd.lock);
+    YC_LockWait(&fd.node->wr_lock);
+    ret = YC_FAT_CopyNoLock(&fs,&fd,yc_copy_buf,sizeof(yc_copy_buf));
+    YC_Unlock(&fd.node->wr_lock);
+    YC_Unlock(&fd.lock);
+    YC_Unlock(&fs.lock);
+
+    fclose(&fd);
+    fclose(&fs);
+    YC_Unlock(&copy_lock);
+    return ret;
+}
+
+/* ------------------------------------------ */
+/*                 文件预分配                   */
+/* ------------------------------------------ */
+/* 零扇区缓冲，设备不支持清零时以多扇区写入代替 */
+static unsigned char yc_zero_sec[YC_ZERO_SEC_NUM*PER_SECSIZE];
+
+/* 将连续n个扇区清零 */
+static void YC_FAT_ZeroSecs(VOL_t *vol,unsigned int sec,unsigned int n)
+{
+    unsigned int k;
+    if(vol->dev.zero)
+    {
+        YC_STAT_IO(vol,1,sec,n);
+        YC_TRACE_IO('B',"dev_zero",sec,n);
+        YC_HIST_DEV_B();
+        vol->dev.zero(vol->dev.ctx,sec,n);
+        YC_HIST_DEV_E(YC_HIST_DEV_ZERO);
+        YC_TRACE_IO('E',"dev_zero",sec,n);
+        return;
+    }
+    while(n)
+    {
+        k = MIN(n, YC_ZERO_SEC_NUM);
+        YC_DiskWrite(vol,yc_zero_sec,sec,k);
+        sec += k;
+        n -= k;
+    }
+}
+
+/* 将文件扩展到new_size字节，new_size不大于文件大小时不做任何操作 */
+/* 簇在卷写锁下预留，清零在卷读锁下进行（新簇尚未缝合，末簇中文件末尾之后的部分读者不会访问），再在卷写锁下按连续段缝合 */
+/* zero_fill为0时只分配簇，新增部分内容不确定；空簇不足时扩展到已分配簇的末尾并返回WR_NO_FREE_CLU_ERR */
+int YC_FAT_Extend(FILE *fl,unsigned int new_size,J_UINT8 zero_fill)
+{
+    unsigned char sbuf[PER_SECSIZE];
+    yc_fnode_t *fn;
+    VOL_t *vol;
+    unsigned int clu_sz, have, need, alloc = 0, off, sec, rsv, k, n;
+    J_UINT8 tail;
+    int ret = 0;
+
+    if(NULL == fl)
+        return ARGVS_ERROR;
+    YC_API_ENTER(YC_OP_EXTEND,YC_FL_VOL(fl));
+    if(!YC_Lock(&fl->lock))
+        return YC_LOCK_BUSY;
+    if(FILE_OPEN != fl->file_state)
+    {
+        YC_Unlock(&fl->lock);
+        return ARGVS_ERROR;
+    }
+    vol = fl->vol;
+    fn = fl->node;
+    /* 缓冲中积累的数据先写出 */
+    ret = YC_FAT_BufFlush(fl,0);
+    if(0 != ret)
+    {
+        YC_Unlock(&fl->lock);
+        return ret;
+    }
+    if(!YC_Lock(&fn->wr_lock))
+    {
+        YC_Unlock(&fl->lock);
+        return YC_LOCK_BUSY;
+    }
+    if(!YC_WriteLock(&vol->rw))
+    {
+        YC_Unlock(&fn->wr_lock);
+        YC_Unlock(&fl->lock);
+        return YC_LOCK_BUSY;
+    }
+    if(new_size <= fn->fl_sz)
+    {
+        YC_WriteUnlock(&vol->rw);
+        YC_Unlock(&fn->wr_lock);
+        YC_Unlock(&fl->lock);
+        return 0;
+    }
+
+    clu_sz = PER_SECSIZE*vol->dbr.secPerClus;
+    /* 文件已占用的簇数，空文件也可能已有首簇 */
+    have = fn->FirstClu ? MAX(1, (fn->fl_sz + clu_sz - 1)/clu_sz) : 0;
+    need = (new_size + clu_sz - 1)/clu_sz;
+    need = (need > have) ? (need - have) : 0;
+    off = fn->fl_sz % clu_sz;
+    tail = zero_fill && have && ((0 == fn->fl_sz) || off);
+
+    do
+    {
+        rsv = YC_FAT_RsvClus(fn);
+        while((rsv < need - alloc) && (0 != (n = YC_FAT_CreateFileCluChain(fn,need - alloc - rsv))))
+            rsv += n;
+        k = MIN(need - alloc, rsv);
+        if(tail || (zero_fill && k))
+        {
+            YC_WriteUnlock(&vol->rw);
+            YC_ReadLockWait(&vol->rw);
+            /* 末簇中原文件末尾之后的部分清零，不满一扇区的部分读改写 */
+            if(tail)
+            {
+                sec = START_SECTOR_OF_FILE(vol,fn->EndClu) + off/PER_SECSIZE;
+                if(off % PER_SECSIZE)
+                {
+                    YC_DiskRead(vol,sbuf,sec,1);
+                    YC_Memset(sbuf + off%PER_SECSIZE, 0, PER_SECSIZE - off%PER_SECSIZE);
+                    YC_DiskWrite(vol,sbuf,sec,1);
+                    sec ++;
+                    off += PER_SECSIZE - off%PER_SECSIZE;
+                }
+                if(off < clu_sz)
+                    YC_FAT_ZeroSecs(vol,sec,(clu_sz - off)/PER_SECSIZE);
+                tail = 0;
+            }
+            YC_FAT_RsvWrite(fn,NULL,k*clu_sz);
+            YC_ReadUnlock(&vol->rw);
+            YC_WriteLockWait(&vol->rw);
+        }
+        YC_FAT_RsvLink(fn,k);
+        alloc += k;
+        if((0 == k) && (alloc < need))
+            ret = WR_NO_FREE_CLU_ERR;
+    }while((0 == ret) && (alloc < need));
+
+    if(ret)
+        new_size = MIN(new_size, (have + alloc)*clu_sz);
+    fn->fl_sz = new_size;
+    fn->EndCluLeftSize = (fn->fl_sz % clu_sz) ? (clu_sz - fn->fl_sz % clu_sz) : 0;
+    YC_FAT_UpdateFileFDI(vol,fn);
+    if(alloc)
+        YC_FAT_UpdateFSInfo(vol);
+    YC_WriteUnlock(&vol->rw);
+    YC_Unlock(&fn->wr_lock);
+    YC_Unlock(&fl->lock);
+    return ret;
+}
+
+/* 写出文件缓冲中积累的数据，返回0成功 */
+int fflush(FILE *fl)
+{
+    int ret = 0;
+    if(NULL == fl)
+        return -1;
+    YC_API_ENTER(YC_OP_FWRITE,YC_FL_VOL(fl));
+    if(!YC_Lock(&fl->lock))
+        return YC_LOCK_BUSY;
+    if((FILE_OPEN == fl->file_state) && fl->BufWr && fl->BufPos)
+        ret = YC_FAT_BufFlush(fl,0);
+    YC_Unlock(&fl->lock);
+    return ret;
 }
 
 /* 格式化磁盘 */
@@ -1,13 +1,90 @@
 #ifndef YCFAT_CONFIG_H
 #define YCFAT_CONFIG_H
 
-/* 超时检测 */
+/* 超时检测：目录遍历超过1秒返回超时错误，节拍取自io.c中的YC_OS_ClockNs，非Linux平台须先对接硬件定时器，否则时钟恒为0，超时不会触发 */
 #define YC_TIMEOUT_SWITCH   0
 #define YC_TIMESTAMP_ON 0
 
 /* 文件内容重定向至内存 */
 #define YC_FILE2MEM 1
 
+/* 长文件名（VFAT）支持 */
+#define YC_LFN_ON 1
+
+/* 长文件名最大长度（UTF-16字符数），FAT32规定不超过255 */
+#define YC_LFN_MAXLEN 255
+
+/* 文件名（UTF-8）及路径最大长度（字节），长文件名至多YC_LFN_MAXLEN个UTF-16字符，每个字符UTF-8编码至多3字节 */
+#if YC_LFN_ON
+#define YC_NAME_MAXLEN (YC_LFN_MAXLEN*3)
+#define YC_PATH_MAXLEN 260
+#else
+#define YC_NAME_MAXLEN 12
+#define YC_PATH_MAXLEN 50
+#endif
+
+/* 目录空闲目录项提示表项数（按目录缓存） */
+#define YC_DIR_HINT_NUM 4
+
+/* 批量创建文件：文件名哈希集合初始槽数（2的幂），目录中已有文件名与本批次文件名合计超过其3/4时由堆扩容 */
+#define YC_BULK_SET_NUM 1024
+
+/* 批量创建文件：单次合并写入的最大连续扇区数 */
+#define YC_BULK_SEC_NUM 4
+
+/* 打开文件表容量：同时打开的文件句柄数目（描述符数目），同一文件的多个句柄共用一个共享节点 */
+#define YC_OPEN_FILE_NUM 16
+
+/* 追加写：每个文件紧邻末簇预留的空簇窗口大小（簇数），关闭文件时归还未使用的部分 */
+#define YC_RSV_CLU_NUM 16
+
+/* 文件句柄内联的预留簇段数目，预留窗口不超过这么多段时追加写不需要对象池操作 */
+#define YC_RSV_RUN_NUM 4
+
+/* 写缓冲簇链节点对象池容量，内联簇段用完后每段不连续的预留簇占用一个节点 */
+#define YC_WBUF_POOL_NUM 32
+
+/* 卷内复制文件：静态复制缓冲大小（字节，向下取整扇区），各次复制共用，越大单次读写的扇区越多 */
+#define YC_COPY_BUF_SIZE (32*1024)
+
+/* 用户态缓冲：setvbuf未指定缓冲区时每个描述符使用的静态缓冲大小（字节） */
+#define YC_FILE_BUF_SIZE 4096
+
+/* 文件预分配：设备不支持清零时，零扇区缓冲的扇区数（单次写入的最大扇区数） */
+#define YC_ZERO_SEC_NUM 8
+
+/* 并发访问锁模式 */
+#define YC_LOCK_NONE  0     /* 不加锁，仅单线程访问 */
+#define YC_LOCK_SPIN  1     /* 自旋等待 */
+#define YC_LOCK_TRY   2     /* 加锁失败立即返回错误码YC_LOCK_BUSY */
+#define YC_LOCK_BLOCK 3     /* 等待期间调用YC_OS_Yield让出CPU，由用户对接操作系统 */
+#define YC_LOCK_MODE YC_LOCK_NONE
+
+/* FAT扇区缓存：分片数及每片缓存扇区数，按扇区号分片，每片独立加锁，0表示关闭缓存 */
+#define YC_FAT_CACHE_SHARDS 4
+#define YC_FAT_CACHE_WAYS 2
+
+/* I/O统计：按公共接口、线程及卷统计调用次数、扇区读写、设备命令、FAT缓存命中、目录扫描及数据字节数，0表示关闭 */
+#define YC_STATS_ON 0
+
+/* I/O统计：独立统计槽数目，每个线程第一次统计时领取一个，超出的线程共用最后一个 */
+#define YC_STATS_THREADS 8
+
+/* 线程局部存储说明符，编译器不支持时定义为空，此时所有线程共用第一个统计槽 */
+#define YC_THREAD_LOCAL __thread
+
+/* 跟踪：在公共接口及设备命令前后记录带时间戳的事件，可导出为Chrome trace JSON，0表示关闭（探针不占用任何开销） */
+#define YC_TRACE_ON 0
+
+/* 跟踪环形缓冲的事件数（取2的幂），满后覆盖最旧的事件 */
+#define YC_TRACE_BUF_NUM 4096
+
+/* 延迟直方图：按接口类别、设备命令及FAT空簇查找统计对数分桶的延迟分布，可查询p50/p99/p999，0表示关闭 */
+#define YC_HIST_ON 0
+
+/* 延迟直方图：每个2的幂区间细分的桶数为2^YC_HIST_SUB_BITS，相对误差不超过其倒数 */
+#define YC_HIST_SUB_BITS 3
+
 /* 开启调试功能 */
 #define PRINT_DEBUG_ON 0
 #endif
\ No newline at end of file